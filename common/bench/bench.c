@@ -0,0 +1,87 @@
+// file:        bench.c
+// description: implementation of the microbenchmark harness
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// results of every kernel end here, so the work can't be optimized away
+static volatile uint64_t sink;
+
+// project name, revision and name filter of every result
+static const char *bench_project = "";
+static const char *bench_rev = "";
+static const char *bench_filter = NULL;
+static long bench_time = 0;
+
+static uint64_t bench_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// keep a kernel result alive
+void bench_sink(uint64_t value) { sink += value; }
+
+// set the fields shared by all the results, argv[1] filters by name
+// BENCH_REV in the environment tags the results, e.g. with a commit
+void bench_init(const char *project, int argc, char **argv) {
+  bench_project = project;
+  bench_filter = argc > 1 ? argv[1] : NULL;
+  bench_time = (long)time(NULL);
+
+  const char *rev = getenv("BENCH_REV");
+  if (rev != NULL) {
+    bench_rev = rev;
+  }
+}
+
+// time a kernel and print the result as a json line
+void run_bench(const char *name, uint64_t param, size_t bytes_per_op,
+               BenchFn fn, void *ctx) {
+  if (bench_filter != NULL && strstr(name, bench_filter) == NULL) {
+    return;
+  }
+
+  // warm up and find the iterations that fill a run
+  uint64_t iters = 1;
+  uint64_t elapsed;
+  while (1) {
+    uint64_t start = bench_now_ns();
+    fn(ctx, iters);
+    elapsed = bench_now_ns() - start;
+    if (elapsed >= BENCH_RUN_NS / 4 || iters >= (1ULL << 40)) {
+      break;
+    }
+    iters *= 2;
+  }
+  if (elapsed > 0 && elapsed < BENCH_RUN_NS) {
+    iters = iters * BENCH_RUN_NS / elapsed;
+  }
+
+  uint64_t runs[BENCH_RUNS];
+  for (int i = 0; i < BENCH_RUNS; i++) {
+    uint64_t start = bench_now_ns();
+    fn(ctx, iters);
+    runs[i] = bench_now_ns() - start;
+  }
+  qsort(runs, BENCH_RUNS, sizeof(runs[0]), compare_u64);
+
+  double best = (double)runs[0] / iters;
+  double median = (double)runs[BENCH_RUNS / 2] / iters;
+  double mb_per_s = bytes_per_op > 0 ? bytes_per_op * 1e3 / best : 0;
+
+  printf("{\"project\":\"%s\",\"rev\":\"%s\",\"time\":%ld,\"bench\":\"%s\","
+         "\"param\":%lu,\"iters\":%lu,\"ns_per_op\":%.1f,"
+         "\"ns_per_op_median\":%.1f,\"mb_per_s\":%.1f}\n",
+         bench_project, bench_rev, bench_time, name, (unsigned long)param,
+         (unsigned long)iters, best, median, mb_per_s);
+  fflush(stdout);
+}
@@ -0,0 +1,21 @@
+// file:        bench.h
+// description: definitions of the microbenchmark harness
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// each run lasts about this long, the best and median runs are reported
+#define BENCH_RUN_NS 50000000ULL
+#define BENCH_RUNS 5
+
+// runs the measured kernel iters times
+typedef void (*BenchFn)(void *ctx, uint64_t iters);
+
+void bench_init(const char *project, int argc, char **argv);
+void run_bench(const char *name, uint64_t param, size_t bytes_per_op,
+               BenchFn fn, void *ctx);
+void bench_sink(uint64_t value);
+
+#endif
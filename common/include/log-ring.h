@@ -0,0 +1,46 @@
+// file:        log-ring.h
+// description: definitions for the log rings shared by the projects, a log
+// call copies its arguments to a ring of its thread and a drain thread
+// formats and writes them
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// events of each thread ring, e.g. make LOG_RING_EVENTS=1024
+#ifndef LOG_RING_EVENTS
+#define LOG_RING_EVENTS 128
+#endif
+
+// argument words of an event
+#define LOG_EVENT_WORDS 16
+
+// string bytes of an event, longer strings are cut, e.g.
+// make LOG_EVENT_TEXT=4096
+#ifndef LOG_EVENT_TEXT
+#define LOG_EVENT_TEXT 512
+#endif
+
+// time between drains
+#define LOG_DRAIN_NS 5000000
+
+// a log call, its format and raw arguments
+typedef struct {
+  uint64_t time_ns;
+  const char *level;
+  const char *fmt;
+  uint32_t count;
+  uint32_t text_used;
+  int truncated;
+  uint64_t words[LOG_EVENT_WORDS];
+  char text[LOG_EVENT_TEXT];
+} LogEvent;
+
+// log ring functions, the level name and the format must be string literals
+void log_ring_write(const char *level, const char *fmt, va_list *args);
+void log_ring_set_file(FILE *file);
+void log_ring_flush(void);
+
+#endif
@@ -0,0 +1,13 @@
+// file:        replace-file.h
+// description: definitions for files replaced in one step
+#ifndef REPLACE_FILE_H
+#define REPLACE_FILE_H
+
+#include <stdio.h>
+
+// writes the contents of a file
+typedef void (*FileWriter)(FILE *file, void *data);
+
+int replace_file(const char *path, FileWriter writer, void *data);
+
+#endif
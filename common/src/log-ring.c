@@ -0,0 +1,501 @@
+// file:        log-ring.c
+// description: implementation of the log rings shared by the projects
+#include "log-ring.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+
+// events are built in place in the ring of the logging thread and written
+// later by the drain thread, so a log call costs a copy instead of a stdio
+// write
+// an event keeps the format and the raw arguments, strings are copied into
+// it and cut to fit, a cut event is written with a marker
+// a full ring drops the event, the drops and the cuts are reported by the
+// drain thread
+
+// ring of a logging thread
+// only the owner moves the head and only the drain thread moves the tail
+typedef struct LogRing {
+  LogEvent events[LOG_RING_EVENTS];
+  _Atomic uint64_t head;
+  _Atomic uint64_t tail;
+  atomic_int closed;
+  struct LogRing *next;
+} LogRing;
+
+// a conversion of a format string, -2 means a width or precision argument
+typedef struct {
+  const char *next;
+  char flags[8];
+  int width;
+  int precision;
+  int length;
+  char conv;
+} LogSpec;
+
+// length modifiers
+enum { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_Z, LEN_J, LEN_T, LEN_LD };
+
+static FILE *log_file = NULL;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static __thread LogRing *thread_ring = NULL;
+
+// the rings list and the output are guarded by the lock
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static LogRing *rings = NULL;
+
+static pthread_t drain;
+static atomic_int drain_running;
+static atomic_int drain_stop;
+static _Atomic uint64_t dropped;
+static uint64_t dropped_reported = 0;
+static _Atomic uint64_t truncated;
+static uint64_t truncated_reported = 0;
+
+// log calls between their drain check and their publish, the final flush
+// waits for them
+static atomic_int writers;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// parse the conversion right after a '%'
+// returns -1 for unsupported conversions
+static int parse_spec(const char *p, LogSpec *s) {
+  size_t flags = 0;
+  while (*p != '\0' && strchr("-+ #0", *p) != NULL) {
+    if (flags < sizeof(s->flags) - 1) {
+      s->flags[flags++] = *p;
+    }
+    p++;
+  }
+  s->flags[flags] = '\0';
+
+  s->width = -1;
+  if (*p == '*') {
+    s->width = -2;
+    p++;
+  } else if (isdigit((unsigned char)*p)) {
+    s->width = (int)strtol(p, (char **)&p, 10);
+  }
+
+  s->precision = -1;
+  if (*p == '.') {
+    p++;
+    if (*p == '*') {
+      s->precision = -2;
+      p++;
+    } else {
+      s->precision = (int)strtol(p, (char **)&p, 10);
+    }
+  }
+
+  s->length = LEN_NONE;
+  if (p[0] == 'h' && p[1] == 'h') {
+    s->length = LEN_HH;
+    p += 2;
+  } else if (p[0] == 'l' && p[1] == 'l') {
+    s->length = LEN_LL;
+    p += 2;
+  } else if (*p != '\0' && strchr("hlzjtL", *p) != NULL) {
+    const char *mods = "hlzjtL";
+    const int lengths[] = {LEN_H, LEN_L, LEN_Z, LEN_J, LEN_T, LEN_LD};
+    s->length = lengths[strchr(mods, *p) - mods];
+    p++;
+  }
+
+  s->conv = *p;
+  s->next = p + 1;
+  return *p != '\0' && strchr("diouxXcsfFeEgGaAp%", *p) != NULL ? 0 : -1;
+}
+
+static int64_t read_signed(va_list *args, int length) {
+  switch (length) {
+  case LEN_HH:
+    return (signed char)va_arg(*args, int);
+  case LEN_H:
+    return (short)va_arg(*args, int);
+  case LEN_L:
+    return va_arg(*args, long);
+  case LEN_LL:
+    return va_arg(*args, long long);
+  case LEN_Z:
+    return va_arg(*args, ssize_t);
+  case LEN_J:
+    return va_arg(*args, intmax_t);
+  case LEN_T:
+    return va_arg(*args, ptrdiff_t);
+  default:
+    return va_arg(*args, int);
+  }
+}
+
+static uint64_t read_unsigned(va_list *args, int length) {
+  switch (length) {
+  case LEN_HH:
+    return (unsigned char)va_arg(*args, unsigned int);
+  case LEN_H:
+    return (unsigned short)va_arg(*args, unsigned int);
+  case LEN_L:
+    return va_arg(*args, unsigned long);
+  case LEN_LL:
+    return va_arg(*args, unsigned long long);
+  case LEN_Z:
+    return va_arg(*args, size_t);
+  case LEN_J:
+    return va_arg(*args, uintmax_t);
+  case LEN_T:
+    return (uint64_t)va_arg(*args, ptrdiff_t);
+  default:
+    return va_arg(*args, unsigned int);
+  }
+}
+
+// copy a string argument into the event, cut to the room left
+static void put_string(LogEvent *ev, const char *str, size_t len) {
+  if (len > LOG_EVENT_TEXT - ev->text_used) {
+    len = LOG_EVENT_TEXT - ev->text_used;
+    ev->truncated = 1;
+  }
+  memcpy(ev->text + ev->text_used, str, len);
+  ev->words[ev->count++] = len;
+  ev->words[ev->count++] = ev->text_used;
+  ev->text_used += len;
+}
+
+// copy the arguments of a log call into an event without formatting them
+static void build_event(LogEvent *ev, const char *level, const char *fmt,
+                        va_list *args) {
+  ev->time_ns = now_ns();
+  ev->level = level;
+  ev->fmt = fmt;
+  ev->count = 0;
+  ev->text_used = 0;
+  ev->truncated = 0;
+
+  for (const char *p = strchr(fmt, '%'); p != NULL; p = strchr(p, '%')) {
+    LogSpec s;
+    if (parse_spec(p + 1, &s) != 0) {
+      break;
+    }
+    p = s.next;
+    if (s.conv == '%') {
+      continue;
+    }
+
+    // width, precision and up to two value words
+    if (ev->count + 4 > LOG_EVENT_WORDS) {
+      ev->truncated = 1;
+      break;
+    }
+    if (s.width == -2) {
+      ev->words[ev->count++] = (uint64_t)(int64_t)va_arg(*args, int);
+    }
+    int precision = s.precision;
+    if (s.precision == -2) {
+      precision = va_arg(*args, int);
+      ev->words[ev->count++] = (uint64_t)(int64_t)precision;
+    }
+
+    switch (s.conv) {
+    case 'd':
+    case 'i':
+      ev->words[ev->count++] = (uint64_t)read_signed(args, s.length);
+      break;
+    case 'c':
+      ev->words[ev->count++] = (uint64_t)va_arg(*args, int);
+      break;
+    case 'p':
+      ev->words[ev->count++] = (uint64_t)(uintptr_t)va_arg(*args, void *);
+      break;
+    case 's': {
+      const char *str = va_arg(*args, const char *);
+      if (str == NULL) {
+        str = "(null)";
+      }
+      size_t len = precision >= 0 ? strnlen(str, precision) : strlen(str);
+      put_string(ev, str, len);
+      break;
+    }
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      ev->words[ev->count++] = read_unsigned(args, s.length);
+      break;
+    default: {
+      double value = s.length == LEN_LD ? (double)va_arg(*args, long double)
+                                        : va_arg(*args, double);
+      memcpy(&ev->words[ev->count++], &value, sizeof(value));
+    }
+    }
+  }
+}
+
+// write an event like printf would have done it, the lock must be held
+static void write_event(FILE *out, const LogEvent *ev) {
+  // the line ends here, after the marker of a cut event
+  const char *end = ev->fmt + strlen(ev->fmt);
+  if (end > ev->fmt && end[-1] == '\n') {
+    end--;
+  }
+
+  uint32_t word = 0;
+  const char *p = ev->fmt;
+  fprintf(out, "%s: ", ev->level);
+
+  while (p < end) {
+    const char *pct = memchr(p, '%', end - p);
+    fwrite(p, 1, (pct != NULL ? pct : end) - p, out);
+    if (pct == NULL) {
+      break;
+    }
+
+    LogSpec s;
+    if (parse_spec(pct + 1, &s) != 0) {
+      fwrite(pct, 1, end - pct, out);
+      break;
+    }
+    p = s.next;
+    if (s.conv == '%') {
+      fputc('%', out);
+      continue;
+    }
+
+    // arguments that didn't fit the event
+    if (word == ev->count) {
+      break;
+    }
+
+    // rebuild the conversion with the stored width and precision
+    char spec[48];
+    int len = snprintf(spec, sizeof(spec), "%%%s", s.flags);
+    int width = s.width == -2 ? (int)ev->words[word++] : s.width;
+    if (width >= 0) {
+      len += snprintf(spec + len, sizeof(spec) - len, "%d", width);
+    }
+    int precision = s.precision == -2 ? (int)ev->words[word++] : s.precision;
+    if (precision >= 0 && s.conv != 's') {
+      len += snprintf(spec + len, sizeof(spec) - len, ".%d", precision);
+    }
+    uint64_t value = ev->words[word++];
+
+    switch (s.conv) {
+    case 'd':
+    case 'i':
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      snprintf(spec + len, sizeof(spec) - len, "ll%c", s.conv);
+      fprintf(out, spec, (long long)value);
+      break;
+    case 'c':
+      snprintf(spec + len, sizeof(spec) - len, "c");
+      fprintf(out, spec, (int)value);
+      break;
+    case 'p':
+      snprintf(spec + len, sizeof(spec) - len, "p");
+      fprintf(out, spec, (void *)(uintptr_t)value);
+      break;
+    case 's': {
+      // the precision was applied when the string was copied
+      const char *str = ev->text + ev->words[word++];
+      snprintf(spec + len, sizeof(spec) - len, ".*s");
+      fprintf(out, spec, (int)value, str);
+      break;
+    }
+    default: {
+      double real;
+      memcpy(&real, &value, sizeof(real));
+      snprintf(spec + len, sizeof(spec) - len, "%c", s.conv);
+      fprintf(out, spec, real);
+    }
+    }
+  }
+
+  if (ev->truncated) {
+    atomic_fetch_add(&truncated, 1);
+    fputs(" [truncated]", out);
+  }
+  fputc('\n', out);
+}
+
+// write every pending event, the oldest first across the threads
+static void drain_rings(void) {
+  FILE *out;
+
+  pthread_mutex_lock(&rings_lock);
+  out = log_file != NULL ? log_file : stderr;
+  while (1) {
+    LogRing *oldest = NULL;
+    uint64_t oldest_ns = 0;
+
+    for (LogRing *ring = rings; ring != NULL; ring = ring->next) {
+      uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+      uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+      if (head == tail) {
+        continue;
+      }
+
+      uint64_t time_ns = ring->events[tail % LOG_RING_EVENTS].time_ns;
+      if (oldest == NULL || time_ns < oldest_ns) {
+        oldest = ring;
+        oldest_ns = time_ns;
+      }
+    }
+
+    if (oldest == NULL) {
+      break;
+    }
+
+    uint64_t tail = atomic_load_explicit(&oldest->tail, memory_order_relaxed);
+    write_event(out, &oldest->events[tail % LOG_RING_EVENTS]);
+    atomic_store_explicit(&oldest->tail, tail + 1, memory_order_release);
+  }
+
+  // rings of finished threads go away once empty
+  LogRing **link = &rings;
+  while (*link != NULL) {
+    LogRing *ring = *link;
+    if (atomic_load(&ring->closed) &&
+        atomic_load(&ring->head) == atomic_load(&ring->tail)) {
+      *link = ring->next;
+      free(ring);
+    } else {
+      link = &ring->next;
+    }
+  }
+
+  uint64_t drops = atomic_load(&dropped);
+  if (drops != dropped_reported) {
+    fprintf(out, "WARNING: %" PRIu64 " log records dropped\n",
+            drops - dropped_reported);
+    dropped_reported = drops;
+  }
+  uint64_t cuts = atomic_load(&truncated);
+  if (cuts != truncated_reported) {
+    fprintf(out, "WARNING: %" PRIu64 " log records truncated\n",
+            cuts - truncated_reported);
+    truncated_reported = cuts;
+  }
+  fflush(out);
+  pthread_mutex_unlock(&rings_lock);
+}
+
+static void *drain_thread(void *data) {
+  (void)data;
+  struct timespec period = {0, LOG_DRAIN_NS};
+  while (!atomic_load(&drain_stop)) {
+    drain_rings();
+    nanosleep(&period, NULL);
+  }
+  return NULL;
+}
+
+// mark the ring of a finished thread, the drain thread frees it
+static void close_ring(void *data) {
+  LogRing *ring = (LogRing *)data;
+  atomic_store(&ring->closed, 1);
+}
+
+static void log_init(void) {
+  pthread_key_create(&ring_key, close_ring);
+  if (pthread_create(&drain, NULL, drain_thread, NULL) == 0) {
+    atomic_store(&drain_running, 1);
+    atexit(log_ring_flush);
+  }
+}
+
+// ring of this thread, created on its first log
+static LogRing *get_ring(void) {
+  if (thread_ring != NULL) {
+    return thread_ring;
+  }
+
+  LogRing *ring = malloc(sizeof(LogRing));
+  if (ring == NULL) {
+    return NULL;
+  }
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->closed, 0);
+
+  pthread_mutex_lock(&rings_lock);
+  ring->next = rings;
+  rings = ring;
+  pthread_mutex_unlock(&rings_lock);
+
+  pthread_setspecific(ring_key, ring);
+  thread_ring = ring;
+  return ring;
+}
+
+// stop the drain thread and write the pending events
+// events logged afterwards are written right away, calls that saw the drain
+// thread running are waited so their events are in the last drain
+void log_ring_flush(void) {
+  pthread_once(&log_once, log_init);
+  if (atomic_exchange(&drain_running, 0)) {
+    atomic_store(&drain_stop, 1);
+    pthread_join(drain, NULL);
+  }
+  while (atomic_load(&writers) > 0) {
+    sched_yield();
+  }
+  drain_rings();
+}
+
+// record a log call in the ring of this thread
+void log_ring_write(const char *level, const char *fmt, va_list *args) {
+  pthread_once(&log_once, log_init);
+
+  // without the drain thread the event is written by the caller
+  atomic_fetch_add(&writers, 1);
+  if (!atomic_load(&drain_running)) {
+    atomic_fetch_sub(&writers, 1);
+    LogEvent ev;
+    build_event(&ev, level, fmt, args);
+    pthread_mutex_lock(&rings_lock);
+    FILE *out = log_file != NULL ? log_file : stderr;
+    write_event(out, &ev);
+    fflush(out);
+    pthread_mutex_unlock(&rings_lock);
+    return;
+  }
+
+  // the event is built in its slot, a full ring drops it
+  LogRing *ring = get_ring();
+  uint64_t head = 0;
+  if (ring != NULL) {
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  }
+  if (ring == NULL ||
+      head - atomic_load_explicit(&ring->tail, memory_order_acquire) ==
+          LOG_RING_EVENTS) {
+    atomic_fetch_add(&dropped, 1);
+  } else {
+    build_event(&ring->events[head % LOG_RING_EVENTS], level, fmt, args);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+  }
+  atomic_fetch_sub(&writers, 1);
+}
+
+// write to a file instead of stderr, NULL goes back to stderr
+void log_ring_set_file(FILE *file) {
+  pthread_mutex_lock(&rings_lock);
+  log_file = file;
+  pthread_mutex_unlock(&rings_lock);
+}
@@ -0,0 +1,23 @@
+// file:        replace-file.c
+// description: implementation of files replaced in one step
+#include "replace-file.h"
+
+// write a temp file and rename it over the path, so readers never see a
+// partial file
+// returns -1 if the file couldn't be written or replaced
+int replace_file(const char *path, FileWriter writer, void *data) {
+  char tmp_path[512];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+  FILE *file = fopen(tmp_path, "w");
+  if (file == NULL) {
+    return -1;
+  }
+  writer(file, data);
+
+  if (fclose(file) != 0 || rename(tmp_path, path) != 0) {
+    remove(tmp_path);
+    return -1;
+  }
+  return 0;
+}
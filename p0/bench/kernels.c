@@ -0,0 +1,148 @@
+#include "bench.h"
+#include "defs.h"
+#include "messages.h"
+#include "tokens.h"
+#include "validate.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// SAS count of the group messages
+static const int group_sizes[] = {1, 16, 256};
+
+typedef struct {
+  int n;
+  char **sas_list;
+  char *req;
+  size_t req_cap;
+  char *res;
+  size_t res_size;
+  char *gas;
+  size_t gas_cap;
+} GroupCtx;
+
+static void bench_encode_gtr(void *arg, uint64_t iters) {
+  GroupCtx *ctx = (GroupCtx *)arg;
+  uint64_t size = 0;
+  for (uint64_t i = 0; i < iters; i++) {
+    size += encode_gtr_request(ctx->req, ctx->req_cap, ctx->sas_list, ctx->n);
+  }
+  bench_sink(size);
+}
+
+static void bench_decode_gtr(void *arg, uint64_t iters) {
+  GroupCtx *ctx = (GroupCtx *)arg;
+  uint64_t size = 0;
+  for (uint64_t i = 0; i < iters; i++) {
+    size += decode_gtr_response(ctx->res, ctx->res_size, ctx->gas,
+                                ctx->gas_cap);
+  }
+  bench_sink(size);
+}
+
+static void bench_encode_gtv(void *arg, uint64_t iters) {
+  GroupCtx *ctx = (GroupCtx *)arg;
+  uint64_t size = 0;
+  for (uint64_t i = 0; i < iters; i++) {
+    size += encode_gtv_request(ctx->req, ctx->req_cap, ctx->gas);
+  }
+  bench_sink(size);
+}
+
+static void bench_make_token(void *arg, uint64_t iters) {
+  GroupCtx *ctx = (GroupCtx *)arg;
+  char token[TOKEN_BYTE_SIZE];
+  for (uint64_t i = 0; i < iters; i++) {
+    make_token(ctx->req, GTR_REQUEST_BASE_SIZE + ctx->n * SAS_BYTE_SIZE,
+               token);
+  }
+  bench_sink(token[0]);
+}
+
+static void bench_valid_token(void *arg, uint64_t iters) {
+  GroupCtx *ctx = (GroupCtx *)arg;
+  const char *token = ctx->res + ctx->res_size - TOKEN_BYTE_SIZE;
+  uint64_t valid = 0;
+  for (uint64_t i = 0; i < iters; i++) {
+    valid += valid_token(token, TOKEN_BYTE_SIZE);
+  }
+  bench_sink(valid);
+}
+
+static void bench_wire_sas_error(void *arg, uint64_t iters) {
+  GroupCtx *ctx = (GroupCtx *)arg;
+  uint64_t errors = 0;
+  for (uint64_t i = 0; i < iters; i++) {
+    const char *sas = ctx->req + GTR_REQUEST_BASE_SIZE;
+    for (int j = 0; j < ctx->n; j++, sas += SAS_BYTE_SIZE) {
+      errors += wire_sas_error(sas) != NULL;
+    }
+  }
+  bench_sink(errors);
+}
+
+// SAS list of distinct ids and a gtr response with its group token
+static void init_group(GroupCtx *ctx, int n) {
+  ctx->n = n;
+  ctx->sas_list = malloc(n * sizeof(char *));
+  for (int i = 0; i < n; i++) {
+    char id[ID_BYTE_SIZE + 1];
+    snprintf(id, sizeof(id), "bench%07d", i);
+
+    char token[TOKEN_BYTE_SIZE];
+    make_token(id, strlen(id), token);
+
+    ctx->sas_list[i] = malloc(SAS_STR_SIZE);
+    snprintf(ctx->sas_list[i], SAS_STR_SIZE, "%s:%d:%.*s", id, i * 7919,
+             TOKEN_BYTE_SIZE, token);
+  }
+
+  ctx->req_cap = GTV_REQUEST_BASE_SIZE + (size_t)n * SAS_BYTE_SIZE;
+  ctx->req = malloc(ctx->req_cap);
+  int req_size = encode_gtr_request(ctx->req, ctx->req_cap, ctx->sas_list, n);
+
+  ctx->res_size = req_size + TOKEN_BYTE_SIZE;
+  ctx->res = malloc(ctx->res_size);
+  memcpy(ctx->res, ctx->req, req_size);
+  uint16_t _type = htons(GTR_RESPONSE_TYPE);
+  memcpy(ctx->res, &_type, sizeof(_type));
+  make_token(ctx->req, req_size, ctx->res + req_size);
+
+  ctx->gas_cap = GAS_STR_SIZE(n);
+  ctx->gas = malloc(ctx->gas_cap);
+  decode_gtr_response(ctx->res, ctx->res_size, ctx->gas, ctx->gas_cap);
+}
+
+static void free_group(GroupCtx *ctx) {
+  for (int i = 0; i < ctx->n; i++) {
+    free(ctx->sas_list[i]);
+  }
+  free(ctx->sas_list);
+  free(ctx->req);
+  free(ctx->res);
+  free(ctx->gas);
+}
+
+int main(int argc, char **argv) {
+  bench_init("p0", argc, argv);
+
+  for (size_t i = 0; i < sizeof(group_sizes) / sizeof(group_sizes[0]); i++) {
+    GroupCtx ctx;
+    init_group(&ctx, group_sizes[i]);
+    size_t wire_size = ctx.n * SAS_BYTE_SIZE;
+    size_t gas_size = strlen(ctx.gas);
+
+    run_bench("encode_gtr_request", ctx.n, wire_size, bench_encode_gtr, &ctx);
+    run_bench("decode_gtr_response", ctx.n, gas_size, bench_decode_gtr, &ctx);
+    run_bench("encode_gtv_request", ctx.n, gas_size, bench_encode_gtv, &ctx);
+    run_bench("make_token", ctx.n, wire_size, bench_make_token, &ctx);
+    run_bench("wire_sas_error", ctx.n, wire_size, bench_wire_sas_error, &ctx);
+    if (i == 0) {
+      run_bench("valid_token", 1, TOKEN_BYTE_SIZE, bench_valid_token, &ctx);
+    }
+    free_group(&ctx);
+  }
+
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef BULK_H
+#define BULK_H
+
+#include "cache.h"
+#include "defs.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// requests kept in flight at the same time
+#define BULK_WINDOW 256
+
+// job states
+typedef enum {
+  JOB_PENDING,
+  JOB_IN_FLIGHT,
+  JOB_DONE,
+  JOB_FAILED,
+} JobStatus;
+
+// a single itr or itv request of a bulk run
+typedef struct {
+  int line;
+  int type;
+  char request[ITV_REQUEST_SIZE];
+  size_t request_size;
+  int attempts;
+  uint64_t sent_ms;
+  uint64_t deadline_ms;
+  JobStatus status;
+  int cached;
+  char result[SAS_STR_SIZE];
+} BulkJob;
+
+// called once for each job when it is done or failed
+typedef void (*BulkCallback)(BulkJob *job, size_t idx, void *ctx);
+
+int make_itr_job(BulkJob *job, const char *id, uint32_t nonce);
+int make_itv_job(BulkJob *job, const char *sas);
+int run_bulk(int fd, BulkJob *jobs, size_t n, size_t window,
+             BulkCallback on_done, void *ctx);
+int bulk_operation(int fd, FILE *input, FILE *output, Cache *cache);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "defs.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+// cache file identification
+#define CACHE_MAGIC "P0CACHE3"
+#define CACHE_SLOTS 65536
+
+// slots searched for a key, starting at its hash
+#define CACHE_PROBES 16
+
+// kinds of cached tokens
+#define CACHE_SAS 1
+#define CACHE_GAS 2
+
+// id and nonce of a SAS or a 128 bit hash of the SAS list of a GAS
+#define CACHE_KEY_SIZE (ID_BYTE_SIZE + NONCE_BYTE_SIZE)
+
+// cache file header
+// the fastest address of the last server list is kept along the tokens
+typedef struct {
+  char magic[8];
+  uint32_t slots;
+  uint32_t count;
+  uint32_t servers_key;
+  struct sockaddr_storage preferred;
+} CacheHeader;
+
+// a cached token
+typedef struct {
+  uint32_t used;
+  uint32_t kind;
+  char key[CACHE_KEY_SIZE];
+  char token[TOKEN_BYTE_SIZE];
+} CacheSlot;
+
+// memory mapped cache file
+// flock keeps processes apart, the mutex keeps the threads of a daemon apart
+typedef struct {
+  int fd;
+  pthread_mutex_t lock;
+  size_t map_size;
+  CacheHeader *header;
+  CacheSlot *slots;
+} Cache;
+
+int cache_open(Cache *c, const char *path);
+void cache_close(Cache *c);
+int cache_clear(Cache *c);
+int cache_lookup_sas(Cache *c, const char *id, uint32_t nonce, char *sas);
+int cache_store_sas(Cache *c, const char *sas);
+int cache_check_sas(Cache *c, const char *sas);
+int cache_remove_sas(Cache *c, const char *sas);
+int cache_lookup_gas(Cache *c, char **sas_list, int n, char *gas,
+                     size_t gas_cap);
+int cache_store_gas(Cache *c, const char *gas);
+int cache_check_gas(Cache *c, const char *gas);
+int cache_remove_gas(Cache *c, const char *gas);
+int cache_get_preferred(Cache *c, const char *servers, const char *port,
+                        struct sockaddr_storage *addr);
+void cache_set_preferred(Cache *c, const char *servers, const char *port,
+                         const struct sockaddr_storage *addr);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include "cache.h"
+#include "network.h"
+#include "parser.h"
+
+char *run_command(Endpoints *ep, Params *p, Cache *cache);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "cache.h"
+#include "network.h"
+#include <stdio.h>
+#include <sys/socket.h>
+
+// udp sockets shared by the daemon clients
+#define DAEMON_POOL_SIZE 16
+
+// pending local connections
+#define DAEMON_BACKLOG 64
+
+int daemon_operation(struct sockaddr_storage *servers, int n,
+                     const char *addr_str, const char *port_str,
+                     const char *path, Cache *cache);
+int daemon_request(const char *path, int argc, char **argv, FILE *output);
+
+#endif
@@ -23,7 +23,31 @@
 #define SAS_NUM_BYTE_SIZE 2
 #define SAS_BYTE_SIZE 80
 
+// individual message sizes
+#define ITR_REQUEST_SIZE (TYPE_BYTE_SIZE + ID_BYTE_SIZE + NONCE_BYTE_SIZE)
+#define ITR_RESPONSE_SIZE (ITR_REQUEST_SIZE + TOKEN_BYTE_SIZE)
+#define ITV_REQUEST_SIZE (ITR_REQUEST_SIZE + TOKEN_BYTE_SIZE)
+#define ITV_RESPONSE_SIZE (ITV_REQUEST_SIZE + STATUS_BYTE_SIZE)
+
+// group message sizes without the SAS list
+#define GTR_REQUEST_BASE_SIZE (TYPE_BYTE_SIZE + SAS_NUM_BYTE_SIZE)
+#define GTV_REQUEST_BASE_SIZE (GTR_REQUEST_BASE_SIZE + TOKEN_BYTE_SIZE)
+
+// max number of SAS that fits in a UDP datagram
+#define MAX_DATAGRAM_SIZE 65507
+#define MAX_GROUP_SIZE                                                         \
+  ((MAX_DATAGRAM_SIZE - GTV_REQUEST_BASE_SIZE - STATUS_BYTE_SIZE) /            \
+   SAS_BYTE_SIZE)
+
+// printable SAS <id>:<nonce>:<token> with the null char
+#define SAS_STR_SIZE (ID_BYTE_SIZE + 1 + 10 + 1 + TOKEN_BYTE_SIZE + 1)
+
+// printable GAS of n SAS, each SAS is followed by a + and the token by the
+// null char
+#define GAS_STR_SIZE(n) ((size_t)(n) * SAS_STR_SIZE + TOKEN_BYTE_SIZE + 1)
+
 // response types
+#define ERROR_RESPONSE_TYPE 256
 #define ITR_REQUEST_TYPE 1
 #define ITR_RESPONSE_TYPE 2
 #define ITV_REQUEST_TYPE 3
@@ -0,0 +1,10 @@
+#ifndef GROUP_H
+#define GROUP_H
+
+#include "cache.h"
+#include "network.h"
+
+char *grp_operation(Endpoints *ep, char **ids, int *nonces, int n, int verify,
+                    Cache *cache);
+
+#endif
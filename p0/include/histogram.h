@@ -0,0 +1,29 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// log-linear buckets: each power of two range is split in 2^SUB_BITS
+// buckets, so any recorded value is off by less than 1/2^SUB_BITS
+#define HIST_SUB_BITS 7
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_RANGES (64 - HIST_SUB_BITS + 1)
+#define HIST_BUCKETS (HIST_RANGES * HIST_SUB_COUNT)
+
+// latency histogram in microseconds
+typedef struct {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;
+  uint64_t min;
+  uint64_t max;
+  uint64_t sum;
+} Histogram;
+
+void hist_init(Histogram *h);
+void hist_record(Histogram *h, uint64_t value);
+void hist_merge(Histogram *dst, const Histogram *src);
+uint64_t hist_percentile(const Histogram *h, double p);
+void hist_print(const Histogram *h, const char *name, FILE *out);
+
+#endif
@@ -1,12 +1,27 @@
 #ifndef MESSAGES_H
 #define MESSAGES_H
 
+#include "network.h"
 #include <stdint.h>
 #include <stdlib.h>
 
-char *itr_operation(int fd, const char *id, uint32_t nonce);
-int itv_operation(int fd, const char *sas);
-char *gtr_operation(int fd, char **sas_list, int n);
-int gtv_operation(int fd, char *gas);
+char *get_error_message(unsigned int error_code);
+int send_receive(Endpoints *ep, char *req, size_t req_size, char *res,
+                 size_t res_cap, size_t *res_size);
+int encode_sas(char *dst, const char *sas, size_t len);
+size_t decode_sas(const char *src, char *dst);
+size_t encode_itr_request(char *req, const char *id, uint32_t nonce);
+int encode_itv_request(char *req, const char *sas);
+int decode_itr_response(const char *res, size_t res_size, char *sas);
+int decode_itv_response(const char *res, size_t res_size);
+int encode_gtr_request(char *req, size_t req_cap, char **sas_list, int n);
+int encode_gtv_request(char *req, size_t req_cap, const char *gas);
+int decode_gtr_response(const char *res, size_t res_size, char *gas,
+                        size_t gas_cap);
+int decode_gtv_response(const char *res, size_t res_size);
+char *itr_operation(Endpoints *ep, const char *id, uint32_t nonce);
+int itv_operation(Endpoints *ep, const char *sas);
+char *gtr_operation(Endpoints *ep, char **sas_list, int n);
+int gtv_operation(Endpoints *ep, const char *gas);
 
 #endif
@@ -3,6 +3,28 @@
 
 #include <sys/socket.h>
 
+// max server addresses of a single service
+#define MAX_ENDPOINTS 4
+
+// time the preferred address has to answer before the next one is tried
+#define RACE_DELAY_MS 250
+
+// connected udp sockets to the addresses of the same server
+// requests go to the preferred one first, the others join in if it is slow
+// answered is set once the server answers on any of them
+typedef struct {
+  int fds[MAX_ENDPOINTS];
+  struct sockaddr_storage addrs[MAX_ENDPOINTS];
+  int count;
+  int preferred;
+  int answered;
+} Endpoints;
+
 int parse_addr(const char *addr_str, const char *port_str,
                struct sockaddr_storage *storage);
+int parse_endpoints(const char *list, const char *port_str,
+                    struct sockaddr_storage *addrs, int max);
+int connect_endpoints(Endpoints *ep, struct sockaddr_storage *addrs, int n);
+int find_endpoint(const Endpoints *ep, const struct sockaddr_storage *addr);
+void close_endpoints(Endpoints *ep);
 #endif
@@ -1,6 +1,8 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stdint.h>
+
 // command line arguments
 typedef struct {
   char *addr;
@@ -10,12 +12,49 @@ typedef struct {
   char *gas;
   char *sas;
   char **sas_list;
+  char **id_list;
+  int *nonce_list;
+  int verify;
+  char *input_file;
+  char *cache_file;
+  char *daemon_path;
+  int cmd_argc;
+  char **cmd_argv;
   int nonce;
   int N;
 } Params;
 
+// stand-in server arguments
+typedef struct {
+  uint16_t port;
+  int threads;
+  uint64_t key;
+  int debug_mode;
+} ServerParams;
+
+// load generator defaults
+#define DEFAULT_LOAD_SOCKETS 64
+#define DEFAULT_LOAD_SECONDS 5
+#define DEFAULT_LOAD_GROUP 4
+#define MAX_LOAD_SOCKETS 1024
+
+// load generator arguments
+typedef struct {
+  char *addr;
+  char *port;
+  double rate;
+  int sockets;
+  double duration;
+  int mix[4];
+  int group_size;
+  int debug_mode;
+} LoadParams;
+
 // parse the command line arguments
 Params parse_args(int argc, char **argv);
+const char *parse_command(int argc, char **argv, Params *p);
+ServerParams parse_server_args(int argc, char **argv);
+LoadParams parse_load_args(int argc, char **argv);
 void clean_params(Params *p);
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef RTT_H
+#define RTT_H
+
+#include <stdint.h>
+
+// retransmission timeout bounds
+#define RTO_INITIAL_MS 1000
+#define RTO_MIN_MS 100
+#define RTO_MAX_MS 4000
+
+// max time a single command can take, retransmissions included
+#define COMMAND_DEADLINE_MS 8000
+
+// smoothed round trip time estimator
+typedef struct {
+  int srtt_ms;
+  int rttvar_ms;
+  int rto_ms;
+  int has_sample;
+  uint32_t seed;
+} RttEstimator;
+
+void rtt_init(RttEstimator *est);
+void rtt_sample(RttEstimator *est, uint64_t rtt_ms);
+int rtt_timeout(RttEstimator *est, int attempt);
+
+#endif
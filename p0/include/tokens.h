@@ -0,0 +1,18 @@
+#ifndef TOKENS_H
+#define TOKENS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// default number of server workers
+#define DEFAULT_SERVER_THREADS 4
+#define MAX_SERVER_THREADS 256
+
+// default key of the stand-in server tokens
+#define DEFAULT_TOKEN_KEY 0x6e6574776f726b73ULL
+
+void set_token_key(uint64_t key);
+void make_token(const char *data, size_t len, char *token);
+size_t handle_request(const char *req, size_t req_size, char *res);
+
+#endif
@@ -1,7 +1,9 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "log-ring.h"
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 
 // simple logger
@@ -12,12 +14,30 @@ typedef enum {
   LOG_ERROR,
 } LogLevel;
 
-#define LOG_MSG(level, fmt, ...) log_message(level, fmt, ##__VA_ARGS__)
+// levels below the threshold are compiled out, e.g. make LOG_MIN_LEVEL=LOG_ERROR
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_DEBUG
+#endif
+
+extern LogLevel current_log_level;
+
+// the format must be a string literal, it is read after the call returns
+#define LOG_MSG(level, fmt, ...)                                               \
+  do {                                                                         \
+    if ((level) >= LOG_MIN_LEVEL && (level) >= current_log_level) {            \
+      log_message(level, fmt, ##__VA_ARGS__);                                  \
+    }                                                                          \
+  } while (0)
 
 void usage(const char *program);
+void server_usage(const char *program);
+void load_usage(const char *program);
 void log_exit(const char *msg);
 void set_log_level(LogLevel level);
 void set_log_file(FILE *file);
 void log_message(LogLevel level, const char *fmt, ...);
+void log_flush(void);
+uint64_t now_ms(void);
+uint64_t now_us(void);
 
 #endif
@@ -0,0 +1,10 @@
+#ifndef VALIDATE_H
+#define VALIDATE_H
+
+#include <stddef.h>
+
+int valid_id(const char *id, size_t len);
+int valid_token(const char *token, size_t len);
+const char *wire_sas_error(const char *wire_sas);
+
+#endif
@@ -0,0 +1,167 @@
+#define _GNU_SOURCE
+#include "defs.h"
+#include "parser.h"
+#include "tokens.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// datagrams read and answered by a single system call
+#define BATCH_SIZE 32
+
+// server worker arguments
+typedef struct {
+  int id;
+  uint16_t port;
+} Worker;
+
+// dual stack udp socket, every worker binds its own on the same port
+static int init_worker_socket(uint16_t port) {
+  int fd = socket(AF_INET6, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  int off = 0;
+  int on = 1;
+  if (setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)) < 0 ||
+      setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  struct sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_any;
+  addr.sin6_port = htons(port);
+
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// read a batch of requests and answer all of them at once
+static void *worker_thread(void *data) {
+  Worker *w = (Worker *)data;
+
+  int fd = init_worker_socket(w->port);
+  if (fd < 0) {
+    log_exit("Worker socket failure");
+  }
+
+  char *req_bufs = malloc((size_t)BATCH_SIZE * MAX_DATAGRAM_SIZE);
+  char *res_bufs = malloc((size_t)BATCH_SIZE * MAX_DATAGRAM_SIZE);
+  if (req_bufs == NULL || res_bufs == NULL) {
+    log_exit("Worker buffers allocation failure");
+  }
+
+  struct mmsghdr reqs[BATCH_SIZE];
+  struct mmsghdr res[BATCH_SIZE];
+  struct iovec req_iov[BATCH_SIZE];
+  struct iovec res_iov[BATCH_SIZE];
+  struct sockaddr_storage peers[BATCH_SIZE];
+
+  LOG_MSG(LOG_INFO, "worker_thread(): worker %d ready\n", w->id);
+
+  while (1) {
+    // reset the request headers, the kernel overwrites the lengths
+    memset(reqs, 0, sizeof(reqs));
+    for (int i = 0; i < BATCH_SIZE; i++) {
+      req_iov[i].iov_base = req_bufs + (size_t)i * MAX_DATAGRAM_SIZE;
+      req_iov[i].iov_len = MAX_DATAGRAM_SIZE;
+      reqs[i].msg_hdr.msg_iov = &req_iov[i];
+      reqs[i].msg_hdr.msg_iovlen = 1;
+      reqs[i].msg_hdr.msg_name = &peers[i];
+      reqs[i].msg_hdr.msg_namelen = sizeof(peers[i]);
+    }
+
+    // block for the first datagram and take whatever else is queued
+    int count = recvmmsg(fd, reqs, BATCH_SIZE, MSG_WAITFORONE, NULL);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_MSG(LOG_ERROR, "worker_thread(): receive failure\n");
+      break;
+    }
+
+    // answer each request to its own peer
+    memset(res, 0, sizeof(res));
+    for (int i = 0; i < count; i++) {
+      char *out = res_bufs + (size_t)i * MAX_DATAGRAM_SIZE;
+      res_iov[i].iov_base = out;
+      res_iov[i].iov_len = handle_request(req_iov[i].iov_base, reqs[i].msg_len,
+                                          out);
+      res[i].msg_hdr.msg_iov = &res_iov[i];
+      res[i].msg_hdr.msg_iovlen = 1;
+      res[i].msg_hdr.msg_name = &peers[i];
+      res[i].msg_hdr.msg_namelen = reqs[i].msg_hdr.msg_namelen;
+    }
+
+    // a failed datagram is skipped, its client retransmits
+    for (int sent = 0; sent < count;) {
+      int n = sendmmsg(fd, res + sent, count - sent, 0);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        LOG_MSG(LOG_WARNING, "worker_thread(): send failure\n");
+        n = 1;
+      }
+      sent += n;
+    }
+
+    LOG_MSG(LOG_DEBUG, "worker_thread(): worker %d answered %d requests\n",
+            w->id, count);
+  }
+
+  free(req_bufs);
+  free(res_bufs);
+  close(fd);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  // parse command line arguments
+  ServerParams p = parse_server_args(argc, argv);
+
+  // set log level
+  if (p.debug_mode > 0) {
+    set_log_level(LOG_DEBUG);
+  }
+
+  set_token_key(p.key);
+
+  // workers share the port, the kernel spreads the clients among them
+  pthread_t *threads = malloc(p.threads * sizeof(pthread_t));
+  Worker *workers = malloc(p.threads * sizeof(Worker));
+  if (threads == NULL || workers == NULL) {
+    log_exit("Workers allocation failure");
+  }
+
+  for (int i = 0; i < p.threads; i++) {
+    workers[i].id = i;
+    workers[i].port = p.port;
+    pthread_create(&threads[i], NULL, worker_thread, &workers[i]);
+  }
+
+  printf("listening on port %u with %d workers\n", p.port, p.threads);
+  fflush(stdout);
+
+  for (int i = 0; i < p.threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  free(threads);
+  free(workers);
+  return 0;
+}
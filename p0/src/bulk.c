@@ -0,0 +1,376 @@
+#include "bulk.h"
+#include "messages.h"
+#include "rtt.h"
+#include "utils.h"
+#include "validate.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+
+// max line size of a bulk input
+#define MAX_LINE 256
+
+// init a job with an individual token request
+int make_itr_job(BulkJob *job, const char *id, uint32_t nonce) {
+  memset(job, 0, sizeof(*job));
+  job->type = ITR_REQUEST_TYPE;
+  job->request_size = encode_itr_request(job->request, id, nonce);
+  job->status = JOB_PENDING;
+  return 0;
+}
+
+// init a job with an individual token validation
+// returns -1 if the SAS can't be parsed
+int make_itv_job(BulkJob *job, const char *sas) {
+  memset(job, 0, sizeof(*job));
+  job->type = ITV_REQUEST_TYPE;
+  job->status = JOB_PENDING;
+
+  int req_size = encode_itv_request(job->request, sas);
+  if (req_size < 0) {
+    return -1;
+  }
+
+  job->request_size = req_size;
+  return 0;
+}
+
+// finish a job and notify the caller
+static void finish_job(BulkJob *jobs, size_t idx, JobStatus status,
+                       BulkCallback on_done, void *ctx) {
+  jobs[idx].status = status;
+  if (on_done != NULL) {
+    on_done(&jobs[idx], idx, ctx);
+  }
+}
+
+// check if a response answers the job request
+static int job_matches(BulkJob *job, const char *res, ssize_t res_size) {
+  // expected response type
+  uint16_t _type = htons(job->type + 1);
+  size_t expected_size =
+      job->type == ITR_REQUEST_TYPE ? ITR_RESPONSE_SIZE : ITV_RESPONSE_SIZE;
+
+  return res_size == (ssize_t)expected_size &&
+         memcmp(res, &_type, sizeof(_type)) == 0 &&
+         memcmp(res + TYPE_BYTE_SIZE, job->request + TYPE_BYTE_SIZE,
+                job->request_size - TYPE_BYTE_SIZE) == 0;
+}
+
+// convert a response to the job result
+static JobStatus decode_job_response(BulkJob *job, const char *res,
+                                     size_t res_size) {
+  if (job->type == ITR_REQUEST_TYPE) {
+    if (decode_itr_response(res, res_size, job->result) != 0) {
+      return JOB_FAILED;
+    }
+    return JOB_DONE;
+  }
+
+  int invalid = decode_itv_response(res, res_size);
+  if (invalid < 0) {
+    return JOB_FAILED;
+  }
+
+  snprintf(job->result, sizeof(job->result), "%d", invalid);
+  return JOB_DONE;
+}
+
+// send all the jobs keeping up to window requests in flight on one socket
+// responses are matched to requests by type and the echoed request
+// retransmission timeouts follow the measured round trip time
+// an error with several jobs in flight makes the run go one job at a time
+// returns the number of failed jobs
+int run_bulk(int fd, BulkJob *jobs, size_t n, size_t window,
+             BulkCallback on_done, void *ctx) {
+  LOG_MSG(LOG_INFO, "run_bulk(): init with %ld jobs\n", n);
+
+  size_t *in_flight = malloc(window * sizeof(size_t));
+  if (in_flight == NULL) {
+    LOG_MSG(LOG_ERROR, "run_bulk(): in flight list allocation failure\n");
+    return -1;
+  }
+
+  RttEstimator est;
+  rtt_init(&est);
+
+  size_t in_flight_count = 0;
+  size_t next = 0;
+  size_t finished = 0;
+  int failures = 0;
+  int serial = 0;
+
+  // jobs finished before being sent, e.g. parsing errors or cached results
+  for (size_t i = 0; i < n; i++) {
+    if (jobs[i].status == JOB_FAILED || jobs[i].status == JOB_DONE) {
+      failures += jobs[i].status == JOB_FAILED;
+      finish_job(jobs, i, jobs[i].status, on_done, ctx);
+      finished++;
+    }
+  }
+
+  while (finished < n) {
+    uint64_t now = now_ms();
+
+    // fill the window with new requests, one at a time while an error
+    // can't be told apart
+    size_t limit = serial ? 1 : window;
+    while (in_flight_count < limit && next < n) {
+      BulkJob *job = &jobs[next];
+      if (job->status != JOB_PENDING) {
+        next++;
+        continue;
+      }
+
+      // a failed send is retried on the job timeout
+      if (send(fd, job->request, job->request_size, 0) < 0) {
+        LOG_MSG(LOG_WARNING, "run_bulk(): send failure, retry later\n");
+      }
+
+      job->status = JOB_IN_FLIGHT;
+      job->attempts++;
+      job->sent_ms = now;
+      job->deadline_ms = now + rtt_timeout(&est, job->attempts);
+      in_flight[in_flight_count++] = next++;
+    }
+
+    // wait for a response until the oldest request times out
+    int timeout = RTO_MAX_MS;
+    for (size_t i = 0; i < in_flight_count; i++) {
+      uint64_t deadline = jobs[in_flight[i]].deadline_ms;
+      int remaining = deadline > now ? (int)(deadline - now) : 0;
+      if (remaining < timeout) {
+        timeout = remaining;
+      }
+    }
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    poll(&pfd, 1, timeout);
+
+    // read every available response
+    char res[ITV_RESPONSE_SIZE + 1];
+    ssize_t res_size;
+    while ((res_size = recv(fd, res, sizeof(res), MSG_DONTWAIT)) > 0) {
+      // errors don't carry the request, they answer the only job in flight
+      // or the jobs are retried one at a time to find the failed one
+      if (res_size == RESPONSE_ERROR_LENGHT) {
+        if (in_flight_count != 1) {
+          LOG_MSG(LOG_WARNING, "run_bulk(): unmatched error response\n");
+          serial = in_flight_count > 1;
+          continue;
+        }
+
+        uint16_t error_code;
+        memcpy(&error_code, res + TYPE_BYTE_SIZE, sizeof(error_code));
+        size_t idx = in_flight[--in_flight_count];
+        snprintf(jobs[idx].result, sizeof(jobs[idx].result), "%s",
+                 get_error_message(ntohs(error_code)));
+        finish_job(jobs, idx, JOB_FAILED, on_done, ctx);
+        finished++;
+        failures++;
+        serial = 0;
+        continue;
+      }
+
+      // complete every in flight job with this request
+      int matched = 0;
+      for (size_t i = 0; i < in_flight_count;) {
+        size_t idx = in_flight[i];
+        if (!job_matches(&jobs[idx], res, res_size)) {
+          i++;
+          continue;
+        }
+
+        // a retransmitted request makes the round trip ambiguous
+        if (jobs[idx].attempts == 1) {
+          rtt_sample(&est, now_ms() - jobs[idx].sent_ms);
+        }
+
+        JobStatus status = decode_job_response(&jobs[idx], res, res_size);
+        finish_job(jobs, idx, status, on_done, ctx);
+        finished++;
+        failures += status == JOB_FAILED;
+        matched = 1;
+
+        // remove from the in flight list
+        in_flight[i] = in_flight[--in_flight_count];
+      }
+
+      if (!matched) {
+        LOG_MSG(LOG_INFO, "run_bulk(): late or duplicated response\n");
+      }
+    }
+
+    // retransmit or give up the timed out requests
+    now = now_ms();
+    for (size_t i = 0; i < in_flight_count;) {
+      size_t idx = in_flight[i];
+      BulkJob *job = &jobs[idx];
+      if (now < job->deadline_ms) {
+        i++;
+        continue;
+      }
+
+      if (job->attempts >= MAX_ATTEMPTS) {
+        snprintf(job->result, sizeof(job->result),
+                 "Error: No response from server");
+        finish_job(jobs, idx, JOB_FAILED, on_done, ctx);
+        finished++;
+        failures++;
+        in_flight[i] = in_flight[--in_flight_count];
+        continue;
+      }
+
+      // the job goes back to the queue to be sent alone
+      if (serial) {
+        job->status = JOB_PENDING;
+        next = idx < next ? idx : next;
+        in_flight[i] = in_flight[--in_flight_count];
+        continue;
+      }
+
+      LOG_MSG(LOG_INFO, "run_bulk(): retransmit job %ld\n", idx);
+      send(fd, job->request, job->request_size, 0);
+      job->attempts++;
+      job->sent_ms = now;
+      job->deadline_ms = now + rtt_timeout(&est, job->attempts);
+      i++;
+    }
+  }
+
+  free(in_flight);
+  LOG_MSG(LOG_INFO, "run_bulk(): exit with %d failures\n", failures);
+  return failures;
+}
+
+// parse a bulk input line, itr <id> <nonce> or itv <SAS>
+// malformed ids and tokens are rejected here instead of by the server
+// jobs answered by the cache are done before being sent
+// returns the reason the line is rejected or NULL
+static const char *parse_bulk_line(const char *line, BulkJob *job,
+                                   Cache *cache) {
+  char cmd[4];
+  char arg[MAX_LINE];
+  int nonce;
+
+  if (sscanf(line, "%3s %255s %d", cmd, arg, &nonce) == 3 &&
+      strcmp(cmd, "itr") == 0) {
+    size_t id_len = strlen(arg);
+    if (id_len > ID_BYTE_SIZE || !valid_id(arg, id_len)) {
+      return "Invalid id";
+    }
+    make_itr_job(job, arg, nonce);
+    if (cache != NULL && cache_lookup_sas(cache, arg, nonce, job->result) == 0) {
+      job->status = JOB_DONE;
+      job->cached = 1;
+    }
+    return NULL;
+  }
+
+  if (sscanf(line, "%3s %255s", cmd, arg) == 2 && strcmp(cmd, "itv") == 0) {
+    if (make_itv_job(job, arg) != 0) {
+      return "Invalid SAS";
+    }
+    const char *error = wire_sas_error(job->request + TYPE_BYTE_SIZE);
+    if (error != NULL) {
+      return error;
+    }
+    if (cache != NULL && cache_check_sas(cache, arg) == 0) {
+      snprintf(job->result, sizeof(job->result), "0 (cached)");
+      job->status = JOB_DONE;
+      job->cached = 1;
+    }
+    return NULL;
+  }
+
+  return "Invalid command";
+}
+
+// output state of a bulk run, results are printed in input order
+typedef struct {
+  BulkJob *jobs;
+  size_t n;
+  size_t next_print;
+  FILE *output;
+} BulkOutput;
+
+// print all the finished jobs at the head of the input
+static void print_finished(BulkJob *job, size_t idx, void *ctx) {
+  (void)job;
+  (void)idx;
+  BulkOutput *out = (BulkOutput *)ctx;
+
+  while (out->next_print < out->n &&
+         (out->jobs[out->next_print].status == JOB_DONE ||
+          out->jobs[out->next_print].status == JOB_FAILED)) {
+    fprintf(out->output, "%s\n", out->jobs[out->next_print].result);
+    out->next_print++;
+  }
+}
+
+// read itr and itv jobs from the input, one per line, and run them together
+// issued SAS are stored in the cache, if any
+// returns the number of failed jobs
+int bulk_operation(int fd, FILE *input, FILE *output, Cache *cache) {
+  LOG_MSG(LOG_INFO, "bulk_operation(): init\n");
+
+  size_t n = 0;
+  size_t capacity = BULK_WINDOW;
+  BulkJob *jobs = malloc(capacity * sizeof(BulkJob));
+  if (jobs == NULL) {
+    LOG_MSG(LOG_ERROR, "bulk_operation(): jobs allocation failure\n");
+    return -1;
+  }
+
+  // read jobs
+  char line[MAX_LINE];
+  int line_number = 0;
+  while (fgets(line, sizeof(line), input) != NULL) {
+    line_number++;
+
+    // skip empty lines and comments
+    char *start = line + strspn(line, " \t\r\n");
+    if (*start == '\0' || *start == '#') {
+      continue;
+    }
+
+    if (n == capacity) {
+      capacity *= 2;
+      BulkJob *tmp = realloc(jobs, capacity * sizeof(BulkJob));
+      if (tmp == NULL) {
+        LOG_MSG(LOG_ERROR, "bulk_operation(): jobs allocation failure\n");
+        free(jobs);
+        return -1;
+      }
+      jobs = tmp;
+    }
+
+    BulkJob *job = &jobs[n++];
+    memset(job, 0, sizeof(*job));
+    const char *error = parse_bulk_line(start, job, cache);
+    if (error != NULL) {
+      job->status = JOB_FAILED;
+      snprintf(job->result, sizeof(job->result), "Error: %s on line %d", error,
+               line_number);
+    }
+    job->line = line_number;
+  }
+
+  BulkOutput out = {jobs, n, 0, output};
+  int failures = run_bulk(fd, jobs, n, BULK_WINDOW, print_finished, &out);
+
+  if (cache != NULL) {
+    for (size_t i = 0; i < n; i++) {
+      if (jobs[i].type == ITR_REQUEST_TYPE && jobs[i].status == JOB_DONE &&
+          !jobs[i].cached) {
+        cache_store_sas(cache, jobs[i].result);
+      }
+    }
+  }
+
+  free(jobs);
+  LOG_MSG(LOG_INFO, "bulk_operation(): exit\n");
+  return failures;
+}
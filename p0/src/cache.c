@@ -0,0 +1,402 @@
+#include "cache.h"
+#include "messages.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// lock the cache for this thread and process
+static void cache_lock(Cache *c, int op) {
+  pthread_mutex_lock(&c->lock);
+  flock(c->fd, op);
+}
+
+static void cache_unlock(Cache *c) {
+  flock(c->fd, LOCK_UN);
+  pthread_mutex_unlock(&c->lock);
+}
+
+// open or create the cache file and map it
+// returns -1 if the file can't be used, the caller goes without cache
+int cache_open(Cache *c, const char *path) {
+  c->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (c->fd < 0) {
+    LOG_MSG(LOG_WARNING, "cache_open(): can't open %s\n", path);
+    return -1;
+  }
+
+  c->map_size = sizeof(CacheHeader) + (size_t)CACHE_SLOTS * sizeof(CacheSlot);
+
+  // a new file is sized once, unused slots stay sparse on disk
+  flock(c->fd, LOCK_EX);
+  struct stat st;
+  if (fstat(c->fd, &st) != 0 ||
+      (st.st_size == 0 && ftruncate(c->fd, c->map_size) != 0) ||
+      (st.st_size != 0 && (size_t)st.st_size != c->map_size)) {
+    LOG_MSG(LOG_WARNING, "cache_open(): invalid cache file %s\n", path);
+    flock(c->fd, LOCK_UN);
+    close(c->fd);
+    return -1;
+  }
+
+  void *map =
+      mmap(NULL, c->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+  if (map == MAP_FAILED) {
+    LOG_MSG(LOG_WARNING, "cache_open(): mmap failure\n");
+    flock(c->fd, LOCK_UN);
+    close(c->fd);
+    return -1;
+  }
+  c->header = (CacheHeader *)map;
+  pthread_mutex_init(&c->lock, NULL);
+  c->slots = (CacheSlot *)((char *)map + sizeof(CacheHeader));
+
+  if (st.st_size == 0) {
+    memcpy(c->header->magic, CACHE_MAGIC, sizeof(c->header->magic));
+    c->header->slots = CACHE_SLOTS;
+    c->header->count = 0;
+    c->header->servers_key = 0;
+    memset(&c->header->preferred, 0, sizeof(c->header->preferred));
+  }
+
+  int valid = memcmp(c->header->magic, CACHE_MAGIC,
+                     sizeof(c->header->magic)) == 0 &&
+              c->header->slots == CACHE_SLOTS;
+  flock(c->fd, LOCK_UN);
+
+  if (!valid) {
+    LOG_MSG(LOG_WARNING, "cache_open(): invalid cache file %s\n", path);
+    cache_close(c);
+    return -1;
+  }
+  return 0;
+}
+
+void cache_close(Cache *c) {
+  pthread_mutex_destroy(&c->lock);
+  munmap(c->header, c->map_size);
+  close(c->fd);
+}
+
+// drop every cached token
+// the slots are cut from the file, so it goes back to being sparse, if it
+// can't be cut they are zeroed
+// returns -1 if the file was cut but can't be extended again, the slots
+// are then beyond its end and must not be touched
+int cache_clear(Cache *c) {
+  int ret = 0;
+  cache_lock(c, LOCK_EX);
+  if (ftruncate(c->fd, sizeof(CacheHeader)) != 0) {
+    memset(c->slots, 0, (size_t)CACHE_SLOTS * sizeof(CacheSlot));
+  } else if (ftruncate(c->fd, c->map_size) != 0) {
+    LOG_MSG(LOG_ERROR, "cache_clear(): can't extend the cache file\n");
+    ret = -1;
+  }
+  c->header->count = 0;
+  cache_unlock(c);
+  return ret;
+}
+
+// 64 bit FNV-1a with a final avalanche
+static uint64_t hash_bytes(uint64_t h, const char *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)data[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static uint64_t fmix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// first slot of a key
+static size_t home_slot(uint32_t kind, const char *key) {
+  uint64_t h = hash_bytes(0xcbf29ce484222325ULL ^ kind, key, CACHE_KEY_SIZE);
+  return fmix64(h) % CACHE_SLOTS;
+}
+
+// find the slot of a key, the lock must be held
+// keys live anywhere in their probe window, removing one leaves no holes
+static CacheSlot *find_slot(Cache *c, uint32_t kind, const char *key) {
+  size_t home = home_slot(kind, key);
+  for (size_t i = 0; i < CACHE_PROBES; i++) {
+    CacheSlot *s = &c->slots[(home + i) % CACHE_SLOTS];
+    if (s->used && s->kind == kind &&
+        memcmp(s->key, key, CACHE_KEY_SIZE) == 0) {
+      return s;
+    }
+  }
+  return NULL;
+}
+
+// get the cached token of a key, returns -1 if it isn't cached
+static int get_token(Cache *c, uint32_t kind, const char *key, char *token) {
+  cache_lock(c, LOCK_SH);
+  CacheSlot *s = find_slot(c, kind, key);
+  if (s != NULL) {
+    memcpy(token, s->token, TOKEN_BYTE_SIZE);
+  }
+  cache_unlock(c);
+  return s != NULL ? 0 : -1;
+}
+
+// cache the token of a key
+// a full probe window evicts the entry at the key home slot
+static void put_token(Cache *c, uint32_t kind, const char *key,
+                      const char *token) {
+  cache_lock(c, LOCK_EX);
+  CacheSlot *s = find_slot(c, kind, key);
+
+  size_t home = home_slot(kind, key);
+  for (size_t i = 0; s == NULL && i < CACHE_PROBES; i++) {
+    CacheSlot *free_slot = &c->slots[(home + i) % CACHE_SLOTS];
+    if (!free_slot->used) {
+      s = free_slot;
+      c->header->count++;
+    }
+  }
+  if (s == NULL) {
+    s = &c->slots[home];
+  }
+
+  s->kind = kind;
+  memcpy(s->key, key, CACHE_KEY_SIZE);
+  memcpy(s->token, token, TOKEN_BYTE_SIZE);
+  s->used = 1;
+  cache_unlock(c);
+}
+
+// remove a key, returns -1 if it wasn't cached
+static int remove_token(Cache *c, uint32_t kind, const char *key) {
+  cache_lock(c, LOCK_EX);
+  CacheSlot *s = find_slot(c, kind, key);
+  if (s != NULL) {
+    s->used = 0;
+    c->header->count--;
+  }
+  cache_unlock(c);
+  return s != NULL ? 0 : -1;
+}
+
+// get an issued SAS of an id and nonce, returns -1 if it isn't cached
+int cache_lookup_sas(Cache *c, const char *id, uint32_t nonce, char *sas) {
+  char wire[SAS_BYTE_SIZE];
+  memset(wire, ' ', ID_BYTE_SIZE);
+  memcpy(wire, id, strnlen(id, ID_BYTE_SIZE));
+  uint32_t _nonce = htonl(nonce);
+  memcpy(wire + ID_BYTE_SIZE, &_nonce, sizeof(_nonce));
+
+  if (get_token(c, CACHE_SAS, wire, wire + CACHE_KEY_SIZE) != 0) {
+    return -1;
+  }
+
+  sas[decode_sas(wire, sas)] = '\0';
+  return 0;
+}
+
+// cache an issued SAS, returns -1 if it can't be parsed
+int cache_store_sas(Cache *c, const char *sas) {
+  char wire[SAS_BYTE_SIZE];
+  if (encode_sas(wire, sas, strlen(sas)) != 0) {
+    return -1;
+  }
+
+  put_token(c, CACHE_SAS, wire, wire + CACHE_KEY_SIZE);
+  return 0;
+}
+
+// check a SAS against the issued ones
+// returns 0 if it was issued, -1 if it must be validated by the server
+int cache_check_sas(Cache *c, const char *sas) {
+  char wire[SAS_BYTE_SIZE];
+  char token[TOKEN_BYTE_SIZE];
+  if (encode_sas(wire, sas, strlen(sas)) != 0 ||
+      get_token(c, CACHE_SAS, wire, token) != 0) {
+    return -1;
+  }
+  return memcmp(token, wire + CACHE_KEY_SIZE, TOKEN_BYTE_SIZE) == 0 ? 0 : -1;
+}
+
+// remove a SAS, only its id and nonce are used
+int cache_remove_sas(Cache *c, const char *sas) {
+  char wire[SAS_BYTE_SIZE];
+  char token[TOKEN_BYTE_SIZE];
+
+  // a bare <id>:<nonce> is accepted too
+  size_t len = strlen(sas);
+  if (encode_sas(wire, sas, len) != 0) {
+    char full[SAS_STR_SIZE];
+    memset(token, '0', sizeof(token));
+    if (len + 1 + TOKEN_BYTE_SIZE >= sizeof(full)) {
+      return -1;
+    }
+    memcpy(full, sas, len);
+    full[len] = ':';
+    memcpy(full + len + 1, token, TOKEN_BYTE_SIZE);
+    if (encode_sas(wire, full, len + 1 + TOKEN_BYTE_SIZE) != 0) {
+      return -1;
+    }
+  }
+  return remove_token(c, CACHE_SAS, wire);
+}
+
+// 128 bit key of a SAS list, made of two independent hashes
+static void gas_key_init(uint64_t *h) {
+  h[0] = 0xcbf29ce484222325ULL;
+  h[1] = 0x84222325cbf29ce4ULL;
+}
+
+static void gas_key_add(uint64_t *h, const char *wire_sas) {
+  h[0] = hash_bytes(h[0], wire_sas, SAS_BYTE_SIZE);
+  h[1] = hash_bytes(h[1] ^ 0x9e3779b97f4a7c15ULL, wire_sas, SAS_BYTE_SIZE);
+}
+
+static void gas_key_final(uint64_t *h, char *key) {
+  memset(key, 0, CACHE_KEY_SIZE);
+  uint64_t a = fmix64(h[0]);
+  uint64_t b = fmix64(h[1]);
+  memcpy(key, &a, sizeof(a));
+  memcpy(key + sizeof(a), &b, sizeof(b));
+}
+
+// split a GAS into the key of its SAS list and its token
+static int parse_gas(const char *gas, char *key, const char **token) {
+  uint64_t h[2];
+  gas_key_init(h);
+
+  char wire[SAS_BYTE_SIZE];
+  int n = 0;
+  const char *p = gas;
+  const char *plus;
+  while ((plus = strchr(p, '+')) != NULL) {
+    if (encode_sas(wire, p, plus - p) != 0) {
+      return -1;
+    }
+    gas_key_add(h, wire);
+    n++;
+    p = plus + 1;
+  }
+
+  if (n == 0 || strlen(p) != TOKEN_BYTE_SIZE) {
+    return -1;
+  }
+  gas_key_final(h, key);
+  *token = p;
+  return 0;
+}
+
+// get the issued GAS of a SAS list, returns -1 if it isn't cached
+int cache_lookup_gas(Cache *c, char **sas_list, int n, char *gas,
+                     size_t gas_cap) {
+  if (n <= 0 || gas_cap < GAS_STR_SIZE(n)) {
+    return -1;
+  }
+
+  uint64_t h[2];
+  gas_key_init(h);
+  char wire[SAS_BYTE_SIZE];
+  for (int i = 0; i < n; i++) {
+    if (encode_sas(wire, sas_list[i], strlen(sas_list[i])) != 0) {
+      return -1;
+    }
+    gas_key_add(h, wire);
+  }
+
+  char key[CACHE_KEY_SIZE];
+  char token[TOKEN_BYTE_SIZE];
+  gas_key_final(h, key);
+  if (get_token(c, CACHE_GAS, key, token) != 0) {
+    return -1;
+  }
+
+  // the GAS is rebuilt from the parsed SAS, as the server would
+  char *out = gas;
+  for (int i = 0; i < n; i++) {
+    encode_sas(wire, sas_list[i], strlen(sas_list[i]));
+    out += decode_sas(wire, out);
+    *out++ = '+';
+  }
+  memcpy(out, token, TOKEN_BYTE_SIZE);
+  out[TOKEN_BYTE_SIZE] = '\0';
+  return 0;
+}
+
+// cache an issued GAS, returns -1 if it can't be parsed
+int cache_store_gas(Cache *c, const char *gas) {
+  char key[CACHE_KEY_SIZE];
+  const char *token;
+  if (parse_gas(gas, key, &token) != 0) {
+    return -1;
+  }
+
+  put_token(c, CACHE_GAS, key, token);
+  return 0;
+}
+
+// check a GAS against the issued ones
+// returns 0 if it was issued, -1 if it must be validated by the server
+int cache_check_gas(Cache *c, const char *gas) {
+  char key[CACHE_KEY_SIZE];
+  char token[TOKEN_BYTE_SIZE];
+  const char *gas_token;
+  if (parse_gas(gas, key, &gas_token) != 0 ||
+      get_token(c, CACHE_GAS, key, token) != 0) {
+    return -1;
+  }
+  return memcmp(token, gas_token, TOKEN_BYTE_SIZE) == 0 ? 0 : -1;
+}
+
+// remove a GAS, returns -1 if it wasn't cached
+int cache_remove_gas(Cache *c, const char *gas) {
+  char key[CACHE_KEY_SIZE];
+  const char *token;
+  if (parse_gas(gas, key, &token) != 0) {
+    return -1;
+  }
+  return remove_token(c, CACHE_GAS, key);
+}
+
+// key of a server list, 0 means no list
+static uint32_t servers_key(const char *servers, const char *port) {
+  uint64_t h = hash_bytes(0xcbf29ce484222325ULL, servers, strlen(servers));
+  h = hash_bytes(h, port, strlen(port));
+  uint32_t key = (uint32_t)fmix64(h);
+  return key != 0 ? key : 1;
+}
+
+// get the address that answered first the last time this list was used
+// returns -1 if the list is not the cached one
+int cache_get_preferred(Cache *c, const char *servers, const char *port,
+                        struct sockaddr_storage *addr) {
+  uint32_t key = servers_key(servers, port);
+
+  cache_lock(c, LOCK_SH);
+  int found = c->header->servers_key == key;
+  if (found) {
+    *addr = c->header->preferred;
+  }
+  cache_unlock(c);
+  return found ? 0 : -1;
+}
+
+// keep the address that answered, the index of an address changes when
+// another one of the list can't be connected
+void cache_set_preferred(Cache *c, const char *servers, const char *port,
+                         const struct sockaddr_storage *addr) {
+  uint32_t key = servers_key(servers, port);
+
+  cache_lock(c, LOCK_EX);
+  c->header->servers_key = key;
+  c->header->preferred = *addr;
+  cache_unlock(c);
+}
@@ -0,0 +1,95 @@
+#include "commands.h"
+#include "group.h"
+#include "messages.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// validation result as printed by the client
+static char *validation_str(int invalid, int cached) {
+  char str[16];
+  snprintf(str, sizeof(str), "%d%s", invalid, cached ? " (cached)" : "");
+  return strdup(str);
+}
+
+// run a single token command, consulting the cache before the network
+// returns the printable result or NULL without a server response
+char *run_command(Endpoints *ep, Params *p, Cache *cache) {
+  // individual token request
+  if (strcmp(p->cmd, "itr") == 0) {
+    char sas[SAS_STR_SIZE];
+    if (cache != NULL && cache_lookup_sas(cache, p->id, p->nonce, sas) == 0) {
+      LOG_MSG(LOG_INFO, "run_command(): cached SAS\n");
+      return strdup(sas);
+    }
+
+    char *response = itr_operation(ep, p->id, p->nonce);
+    if (cache != NULL && response != NULL) {
+      cache_store_sas(cache, response);
+    }
+    return response;
+  }
+
+  // individual token validation
+  if (strcmp(p->cmd, "itv") == 0) {
+    if (cache != NULL && cache_check_sas(cache, p->sas) == 0) {
+      return validation_str(0, 1);
+    }
+    return validation_str(itv_operation(ep, p->sas), 0);
+  }
+
+  // group token request
+  if (strcmp(p->cmd, "gtr") == 0) {
+    char *gas = malloc(GAS_STR_SIZE(p->N));
+    if (cache != NULL && gas != NULL &&
+        cache_lookup_gas(cache, p->sas_list, p->N, gas, GAS_STR_SIZE(p->N)) ==
+            0) {
+      LOG_MSG(LOG_INFO, "run_command(): cached GAS\n");
+      return gas;
+    }
+    free(gas);
+
+    char *response = gtr_operation(ep, p->sas_list, p->N);
+    if (cache != NULL && response != NULL) {
+      cache_store_gas(cache, response);
+    }
+    return response;
+  }
+
+  // group token built from ids and nonces
+  if (strcmp(p->cmd, "grp") == 0) {
+    return grp_operation(ep, p->id_list, p->nonce_list, p->N, p->verify,
+                         cache);
+  }
+
+  // group token validation
+  if (strcmp(p->cmd, "gtv") == 0) {
+    if (cache != NULL && cache_check_gas(cache, p->gas) == 0) {
+      return validation_str(0, 1);
+    }
+    return validation_str(gtv_operation(ep, p->gas), 0);
+  }
+
+  // cache invalidation doesn't talk to the server
+  if (strcmp(p->cmd, "invalidate") == 0) {
+    if (cache == NULL) {
+      return strdup("Error: No cache file");
+    }
+
+    int removed = 0;
+    if (strcmp(p->sas, "all") == 0) {
+      if (cache_clear(cache) != 0) {
+        return strdup("Error: Cache file failure");
+      }
+      removed = 1;
+    } else if (strchr(p->sas, '+') != NULL) {
+      removed = cache_remove_gas(cache, p->sas) == 0;
+    } else {
+      removed = cache_remove_sas(cache, p->sas) == 0;
+    }
+    return strdup(removed ? "invalidated" : "not cached");
+  }
+
+  return strdup("Error: Invalid command");
+}
@@ -0,0 +1,285 @@
+#include "daemon.h"
+#include "commands.h"
+#include "parser.h"
+#include "utils.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// max arguments of a command line
+#define MAX_LINE_ARGS (2 * MAX_GROUP_SIZE + 3)
+
+// connected udp sockets, each endpoints set runs a single command at a time
+// the address that answered first is shared by all the sets
+typedef struct {
+  Endpoints slots[DAEMON_POOL_SIZE];
+  Endpoints *free[DAEMON_POOL_SIZE];
+  int free_count;
+  int preferred;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} SocketPool;
+
+// a local client connection
+// the server list and port are the cache key of the preferred address
+typedef struct {
+  int fd;
+  SocketPool *pool;
+  Cache *cache;
+  const char *addr_str;
+  const char *port_str;
+} Connection;
+
+static volatile sig_atomic_t stop_daemon = 0;
+
+static void handle_stop(int sig) {
+  (void)sig;
+  stop_daemon = 1;
+}
+
+// wait for free udp sockets
+static Endpoints *pool_get(SocketPool *pool) {
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->free_count == 0) {
+    pthread_cond_wait(&pool->cond, &pool->mutex);
+  }
+  Endpoints *ep = pool->free[--pool->free_count];
+  ep->preferred = pool->preferred;
+  ep->answered = 0;
+  pthread_mutex_unlock(&pool->mutex);
+  return ep;
+}
+
+static void pool_put(SocketPool *pool, Endpoints *ep) {
+  pthread_mutex_lock(&pool->mutex);
+  pool->preferred = ep->preferred;
+  pool->free[pool->free_count++] = ep;
+  pthread_cond_signal(&pool->cond);
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+// run a command line and write its result line
+static void serve_line(Connection *conn, char *line, char **args, FILE *out) {
+  int argc = 0;
+  char *save = NULL;
+  for (char *tok = strtok_r(line, " \t\r\n", &save);
+       tok != NULL && argc < MAX_LINE_ARGS;
+       tok = strtok_r(NULL, " \t\r\n", &save)) {
+    args[argc++] = tok;
+  }
+  if (argc == 0) {
+    return;
+  }
+
+  Params p;
+  p.addr = NULL;
+  p.port = NULL;
+  p.cache_file = NULL;
+  p.daemon_path = NULL;
+  p.cmd_argc = argc;
+  p.cmd_argv = args;
+
+  const char *error = parse_command(argc, args, &p);
+  if (error != NULL) {
+    fprintf(out, "Error: %s\n", error);
+    clean_params(&p);
+    return;
+  }
+
+  if (strcmp(p.cmd, "bulk") == 0 || strcmp(p.cmd, "daemon") == 0) {
+    fprintf(out, "Error: Command not supported by the daemon\n");
+    clean_params(&p);
+    return;
+  }
+
+  Endpoints *ep = pool_get(conn->pool);
+  char *result = run_command(ep, &p, conn->cache);
+  if (ep->answered && conn->cache != NULL) {
+    cache_set_preferred(conn->cache, conn->addr_str, conn->port_str,
+                        &ep->addrs[ep->preferred]);
+  }
+  pool_put(conn->pool, ep);
+
+  fprintf(out, "%s\n", result != NULL ? result : "Error: No response from server");
+  free(result);
+  clean_params(&p);
+}
+
+// serve the command lines of a local client until it disconnects
+static void *connection_thread(void *data) {
+  Connection *conn = (Connection *)data;
+
+  FILE *in = fdopen(conn->fd, "r");
+  int out_fd = dup(conn->fd);
+  FILE *out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+  char **args = malloc(MAX_LINE_ARGS * sizeof(char *));
+
+  if (in == NULL || out == NULL || args == NULL) {
+    LOG_MSG(LOG_ERROR, "connection_thread(): connection setup failure\n");
+  } else {
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, in) > 0) {
+      serve_line(conn, line, args, out);
+      fflush(out);
+    }
+    free(line);
+  }
+
+  if (out != NULL) {
+    fclose(out);
+  } else if (out_fd >= 0) {
+    close(out_fd);
+  }
+  if (in != NULL) {
+    fclose(in);
+  } else {
+    close(conn->fd);
+  }
+  free(args);
+  free(conn);
+  return NULL;
+}
+
+// listen on a unix socket, run the local clients commands concurrently
+// the udp sockets, the server addresses and the round trip state stay open
+int daemon_operation(struct sockaddr_storage *servers, int n,
+                     const char *addr_str, const char *port_str,
+                     const char *path, Cache *cache) {
+  LOG_MSG(LOG_INFO, "daemon_operation(): init\n");
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    LOG_MSG(LOG_ERROR, "daemon_operation(): socket path too long\n");
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  // udp sockets pool
+  SocketPool pool;
+  pool.free_count = 0;
+  pool.preferred = 0;
+  pthread_mutex_init(&pool.mutex, NULL);
+  pthread_cond_init(&pool.cond, NULL);
+  for (int i = 0; i < DAEMON_POOL_SIZE; i++) {
+    if (connect_endpoints(&pool.slots[i], servers, n) < 0) {
+      log_exit("Server connection failure");
+    }
+    pool.free[pool.free_count++] = &pool.slots[i];
+  }
+
+  // the address that answered first the last time goes first
+  struct sockaddr_storage preferred;
+  if (cache != NULL &&
+      cache_get_preferred(cache, addr_str, port_str, &preferred) == 0) {
+    int idx = find_endpoint(&pool.slots[0], &preferred);
+    pool.preferred = idx >= 0 ? idx : pool.preferred;
+  }
+
+  // local socket, a stale one from a previous run is replaced
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    log_exit("Socket creation failure");
+  }
+  unlink(path);
+  if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, DAEMON_BACKLOG) != 0) {
+    log_exit("Daemon socket failure");
+  }
+
+  // interrupt accept to stop, a gone client must not kill the daemon
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  LOG_MSG(LOG_INFO, "daemon_operation(): listening on %s\n", path);
+
+  while (!stop_daemon) {
+    int conn_fd = accept(listen_fd, NULL, NULL);
+    if (conn_fd < 0) {
+      if (errno != EINTR) {
+        LOG_MSG(LOG_ERROR, "daemon_operation(): accept failure\n");
+      }
+      continue;
+    }
+
+    Connection *conn = malloc(sizeof(Connection));
+    if (conn == NULL) {
+      close(conn_fd);
+      continue;
+    }
+    conn->fd = conn_fd;
+    conn->pool = &pool;
+    conn->cache = cache;
+    conn->addr_str = addr_str;
+    conn->port_str = port_str;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, connection_thread, conn) != 0) {
+      LOG_MSG(LOG_ERROR, "daemon_operation(): thread creation failure\n");
+      close(conn_fd);
+      free(conn);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+
+  // running connections end with the process
+  close(listen_fd);
+  unlink(path);
+  LOG_MSG(LOG_INFO, "daemon_operation(): exit\n");
+  return 0;
+}
+
+// send a command line to a running daemon and print its result
+// returns -1 if the daemon can't be reached or the result is an error
+int daemon_request(const char *path, int argc, char **argv, FILE *output) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    return -1;
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    LOG_MSG(LOG_ERROR, "daemon_request(): daemon connection failure\n");
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+
+  FILE *conn = fdopen(fd, "r+");
+  if (conn == NULL) {
+    close(fd);
+    return -1;
+  }
+
+  for (int i = 0; i < argc; i++) {
+    fprintf(conn, "%s%s", argv[i], i + 1 < argc ? " " : "\n");
+  }
+  fflush(conn);
+
+  char *line = NULL;
+  size_t cap = 0;
+  int result = -1;
+  if (getline(&line, &cap, conn) > 0) {
+    fputs(line, output);
+    result = strncmp(line, "Error", 5) == 0 ? -1 : 0;
+  }
+
+  free(line);
+  fclose(conn);
+  return result;
+}
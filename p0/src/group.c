@@ -0,0 +1,143 @@
+#include "group.h"
+#include "bulk.h"
+#include "messages.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <string.h>
+
+// gtr request being filled by the itr responses
+typedef struct {
+  char *request;
+  Cache *cache;
+} GroupAssembly;
+
+// copy an issued SAS to its slot of the gtr request as soon as it arrives
+static void fill_slot(BulkJob *job, size_t idx, void *ctx) {
+  GroupAssembly *group = (GroupAssembly *)ctx;
+  if (job->status != JOB_DONE) {
+    return;
+  }
+
+  char *slot = group->request + GTR_REQUEST_BASE_SIZE + idx * SAS_BYTE_SIZE;
+  if (encode_sas(slot, job->result, strlen(job->result)) != 0) {
+    job->status = JOB_FAILED;
+    return;
+  }
+
+  if (group->cache != NULL && !job->cached) {
+    cache_store_sas(group->cache, job->result);
+  }
+}
+
+// build a group token from ids and nonces
+// the itr requests run concurrently and fill the gtr request, that is sent
+// once all of them are done, the gtr response is then verified with gtv
+// returns the GAS, an error message or NULL without a server response
+char *grp_operation(Endpoints *ep, char **ids, int *nonces, int n, int verify,
+                    Cache *cache) {
+  LOG_MSG(LOG_INFO, "grp_operation(): init\n");
+
+  if (n <= 0 || n > MAX_GROUP_SIZE) {
+    LOG_MSG(LOG_ERROR, "grp_operation(): invalid group size %d\n", n);
+    return NULL;
+  }
+
+  // the gtr response with another type is the gtv request
+  // request and response structures share a single buffer
+  size_t req_size = GTR_REQUEST_BASE_SIZE + (size_t)n * SAS_BYTE_SIZE;
+  size_t res_cap = req_size + TOKEN_BYTE_SIZE + STATUS_BYTE_SIZE;
+  char *buffer = malloc(req_size + 2 * res_cap);
+  BulkJob *jobs = malloc(n * sizeof(BulkJob));
+  if (buffer == NULL || jobs == NULL) {
+    LOG_MSG(LOG_ERROR, "grp_operation(): allocation failure\n");
+    free(buffer);
+    free(jobs);
+    return NULL;
+  }
+  char *request = buffer;
+  char *response = buffer + req_size;
+  char *status = response + res_cap;
+
+  uint16_t _type = htons(GTR_REQUEST_TYPE);
+  uint16_t _n = htons(n);
+  memcpy(request, &_type, sizeof(_type));
+  memcpy(request + TYPE_BYTE_SIZE, &_n, sizeof(_n));
+
+  // cached SAS are done before the requests are sent
+  for (int i = 0; i < n; i++) {
+    make_itr_job(&jobs[i], ids[i], nonces[i]);
+    if (cache != NULL &&
+        cache_lookup_sas(cache, ids[i], nonces[i], jobs[i].result) == 0) {
+      jobs[i].status = JOB_DONE;
+      jobs[i].cached = 1;
+    }
+  }
+
+  // itr fan out, up to a bulk window in flight at once
+  GroupAssembly group = {request, cache};
+  size_t window = n < BULK_WINDOW ? (size_t)n : BULK_WINDOW;
+  run_bulk(ep->fds[ep->preferred], jobs, n, window, fill_slot, &group);
+  for (int i = 0; i < n; i++) {
+    if (jobs[i].status != JOB_DONE) {
+      // the reason of the failure, e.g. the server error, without its prefix
+      const char *reason = jobs[i].result[0] != '\0' ? jobs[i].result
+                                                     : "Invalid response";
+      if (strncmp(reason, "Error: ", 7) == 0) {
+        reason += 7;
+      }
+
+      char message[64 + SAS_STR_SIZE];
+      snprintf(message, sizeof(message), "Error: No SAS for %.*s:%d: %s",
+               ID_BYTE_SIZE, ids[i], nonces[i], reason);
+      LOG_MSG(LOG_ERROR, "grp_operation(): exit without SAS %d\n", i);
+      free(jobs);
+      free(buffer);
+      return strdup(message);
+    }
+  }
+  free(jobs);
+
+  // group token request
+  size_t res_size = 0;
+  int result =
+      send_receive(ep, request, req_size, response, res_cap, &res_size);
+  if (result != 0) {
+    LOG_MSG(LOG_ERROR, "grp_operation(): gtr failure\n");
+    free(buffer);
+    return result > 0 ? strdup(get_error_message(result)) : NULL;
+  }
+
+  char *gas = malloc(GAS_STR_SIZE(n));
+  if (gas == NULL ||
+      decode_gtr_response(response, res_size, gas, GAS_STR_SIZE(n)) < 0) {
+    LOG_MSG(LOG_ERROR, "grp_operation(): invalid gtr response\n");
+    free(gas);
+    free(buffer);
+    return NULL;
+  }
+
+  // group token validation of the fresh GAS
+  if (verify) {
+    _type = htons(GTV_REQUEST_TYPE);
+    memcpy(response, &_type, sizeof(_type));
+
+    size_t gtv_size = req_size + TOKEN_BYTE_SIZE;
+    result = send_receive(ep, response, gtv_size, status, res_cap, &res_size);
+    if (result != 0 || decode_gtv_response(status, res_size) != 0) {
+      LOG_MSG(LOG_ERROR, "grp_operation(): GAS not verified\n");
+      free(gas);
+      free(buffer);
+      return result > 0 ? strdup(get_error_message(result))
+                        : strdup("Error: Group token not verified");
+    }
+  }
+
+  if (cache != NULL) {
+    cache_store_gas(cache, gas);
+  }
+
+  free(buffer);
+  LOG_MSG(LOG_INFO, "grp_operation(): exit with message\n");
+  return gas;
+}
@@ -0,0 +1,96 @@
+#include "histogram.h"
+#include <inttypes.h>
+#include <string.h>
+
+void hist_init(Histogram *h) {
+  memset(h, 0, sizeof(*h));
+  h->min = UINT64_MAX;
+}
+
+// bucket of a value, values below 2^SUB_BITS have a bucket of their own
+static int bucket_index(uint64_t value) {
+  if (value < HIST_SUB_COUNT) {
+    return (int)value;
+  }
+
+  int msb = 63 - __builtin_clzll(value);
+  int range = msb - HIST_SUB_BITS + 1;
+  int sub = (int)(value >> (msb - HIST_SUB_BITS)) - HIST_SUB_COUNT;
+  return range * HIST_SUB_COUNT + sub;
+}
+
+// highest value that falls in a bucket
+static uint64_t bucket_value(int idx) {
+  int range = idx / HIST_SUB_COUNT;
+  uint64_t sub = idx % HIST_SUB_COUNT;
+  if (range == 0) {
+    return sub;
+  }
+
+  int shift = range - 1;
+  return (((sub + HIST_SUB_COUNT) << shift) + ((1ULL << shift) - 1));
+}
+
+void hist_record(Histogram *h, uint64_t value) {
+  h->counts[bucket_index(value)]++;
+  h->total++;
+  h->sum += value;
+  if (value < h->min) {
+    h->min = value;
+  }
+  if (value > h->max) {
+    h->max = value;
+  }
+}
+
+void hist_merge(Histogram *dst, const Histogram *src) {
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    dst->counts[i] += src->counts[i];
+  }
+  dst->total += src->total;
+  dst->sum += src->sum;
+  if (src->min < dst->min) {
+    dst->min = src->min;
+  }
+  if (src->max > dst->max) {
+    dst->max = src->max;
+  }
+}
+
+// value below which p percent of the records are
+uint64_t hist_percentile(const Histogram *h, double p) {
+  if (h->total == 0) {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)(p / 100.0 * h->total + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      uint64_t value = bucket_value(i);
+      return value > h->max ? h->max : value;
+    }
+  }
+  return h->max;
+}
+
+// one line summary of the histogram
+void hist_print(const Histogram *h, const char *name, FILE *out) {
+  if (h->total == 0) {
+    fprintf(out, "%-5s count=0\n", name);
+    return;
+  }
+
+  fprintf(out,
+          "%-5s count=%" PRIu64 " min=%" PRIu64 " p50=%" PRIu64
+          " p99=%" PRIu64 " p999=%" PRIu64 " max=%" PRIu64
+          " mean=%.1f (us)\n",
+          name, h->total, h->min, hist_percentile(h, 50.0),
+          hist_percentile(h, 99.0), hist_percentile(h, 99.9), h->max,
+          (double)h->sum / h->total);
+}
@@ -0,0 +1,386 @@
+#define _GNU_SOURCE
+#include "defs.h"
+#include "histogram.h"
+#include "messages.h"
+#include "network.h"
+#include "parser.h"
+#include "rtt.h"
+#include "utils.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// commands of the load mix
+#define CMD_COUNT 4
+static const char *cmd_names[CMD_COUNT] = {"itr", "itv", "gtr", "gtv"};
+
+// open loop requests waiting for a free socket
+#define BACKLOG_SIZE (1 << 16)
+
+// prebuilt request of each command
+typedef struct {
+  char *data;
+  size_t size;
+  size_t res_size;
+} Template;
+
+// a socket of the pool, it has at most one request in flight
+typedef struct {
+  int fd;
+  int busy;
+  int cmd;
+  int attempts;
+  uint64_t intended_us;
+  uint64_t sent_us;
+  uint64_t deadline_us;
+  char *req;
+  size_t req_size;
+} Slot;
+
+// results of a command
+typedef struct {
+  Histogram hist;
+  uint64_t sent;
+  uint64_t errors;
+  uint64_t lost;
+  uint64_t retransmits;
+} CmdStats;
+
+// connected udp socket to the server
+static int connect_socket(struct sockaddr_storage *storage) {
+  int fd = socket(storage->ss_family, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    log_exit("Socket creation failure");
+  }
+  if (connect(fd, (struct sockaddr *)storage, sizeof(*storage)) != 0) {
+    log_exit("Server connection failure");
+  }
+  return fd;
+}
+
+// build a valid request of each command with a few blocking exchanges
+// the SAS list comes from itr requests and the GAS from a gtr request
+static void build_templates(Endpoints *ep, int group_size, Template *t) {
+  size_t list_size = (size_t)group_size * SAS_BYTE_SIZE;
+
+  // itr, the nonce is changed on every request
+  t[0].data = malloc(ITR_REQUEST_SIZE);
+  t[0].size = encode_itr_request(t[0].data, "load", 0);
+  t[0].res_size = ITR_RESPONSE_SIZE;
+
+  // gtr request with group_size valid SAS
+  t[2].size = GTR_REQUEST_BASE_SIZE + list_size;
+  t[2].data = malloc(t[2].size);
+  t[2].res_size = t[2].size + TOKEN_BYTE_SIZE;
+  uint16_t _type = htons(GTR_REQUEST_TYPE);
+  uint16_t _n = htons(group_size);
+  memcpy(t[2].data, &_type, sizeof(_type));
+  memcpy(t[2].data + TYPE_BYTE_SIZE, &_n, sizeof(_n));
+
+  for (int i = 0; i < group_size; i++) {
+    char *sas = itr_operation(ep, "load", i + 1);
+    char req[ITV_REQUEST_SIZE];
+    if (sas == NULL || encode_itv_request(req, sas) < 0) {
+      log_exit("Load setup failure, no valid SAS");
+    }
+
+    // the first one is also the itv request
+    if (i == 0) {
+      t[1].data = malloc(ITV_REQUEST_SIZE);
+      memcpy(t[1].data, req, ITV_REQUEST_SIZE);
+      t[1].size = ITV_REQUEST_SIZE;
+      t[1].res_size = ITV_RESPONSE_SIZE;
+    }
+
+    memcpy(t[2].data + GTR_REQUEST_BASE_SIZE + i * SAS_BYTE_SIZE,
+           req + TYPE_BYTE_SIZE, SAS_BYTE_SIZE);
+    free(sas);
+  }
+
+  // a gtr response is a gtv request with another type
+  t[3].size = GTV_REQUEST_BASE_SIZE + list_size;
+  t[3].data = malloc(t[3].size);
+  t[3].res_size = t[3].size + STATUS_BYTE_SIZE;
+  size_t res_size = 0;
+  if (send_receive(ep, t[2].data, t[2].size, t[3].data, t[3].size,
+                   &res_size) != 0 ||
+      res_size != t[3].size) {
+    log_exit("Load setup failure, no valid GAS");
+  }
+  _type = htons(GTV_REQUEST_TYPE);
+  memcpy(t[3].data, &_type, sizeof(_type));
+}
+
+// pick a command following the mix weights
+static int pick_command(const int *mix, int total, uint32_t *seed) {
+  *seed ^= *seed << 13;
+  *seed ^= *seed >> 17;
+  *seed ^= *seed << 5;
+
+  int r = (int)(*seed % (uint32_t)total);
+  for (int i = 0; i < CMD_COUNT; i++) {
+    if (r < mix[i]) {
+      return i;
+    }
+    r -= mix[i];
+  }
+  return CMD_COUNT - 1;
+}
+
+// check the response type, id and nonce against the slot request
+static int response_matches(Slot *s, const char *res) {
+  uint16_t _type;
+  memcpy(&_type, s->req, sizeof(_type));
+  _type = htons(ntohs(_type) + 1);
+
+  return memcmp(res, &_type, sizeof(_type)) == 0 &&
+         memcmp(res + TYPE_BYTE_SIZE, s->req + TYPE_BYTE_SIZE,
+                ID_BYTE_SIZE + NONCE_BYTE_SIZE) == 0;
+}
+
+// send a new request on a free slot
+static void start_request(Slot *s, int cmd, Template *t, uint32_t nonce,
+                          uint64_t intended_us, RttEstimator *est,
+                          CmdStats *stats) {
+  s->busy = 1;
+  s->cmd = cmd;
+  s->attempts = 1;
+  s->intended_us = intended_us;
+  s->req_size = t[cmd].size;
+  memcpy(s->req, t[cmd].data, t[cmd].size);
+
+  // unique itr requests, the server can't answer from a cache
+  if (cmd == 0) {
+    uint32_t _nonce = htonl(nonce);
+    memcpy(s->req + TYPE_BYTE_SIZE + ID_BYTE_SIZE, &_nonce, sizeof(_nonce));
+  }
+
+  s->sent_us = now_us();
+  s->deadline_us = s->sent_us + (uint64_t)rtt_timeout(est, 1) * 1000;
+  send(s->fd, s->req, s->req_size, 0);
+  stats[cmd].sent++;
+}
+
+int main(int argc, char **argv) {
+  // parse command line arguments
+  LoadParams p = parse_load_args(argc, argv);
+  if (p.debug_mode > 0) {
+    set_log_level(LOG_DEBUG);
+  }
+
+  struct sockaddr_storage storage;
+  if (parse_addr(p.addr, p.port, &storage) != 0) {
+    log_exit("Addr parsing failure");
+  }
+
+  // requests of each command
+  Template templates[CMD_COUNT];
+  Endpoints setup = {.fds = {connect_socket(&storage)}, .count = 1};
+  build_templates(&setup, p.group_size, templates);
+  close_endpoints(&setup);
+
+  size_t max_req = templates[3].size;
+  size_t max_res = templates[3].res_size;
+
+  // socket pool, responses are matched to requests by socket
+  Slot *slots = calloc(p.sockets, sizeof(Slot));
+  struct pollfd *pfds = calloc(p.sockets, sizeof(struct pollfd));
+  uint64_t *backlog = malloc(BACKLOG_SIZE * sizeof(uint64_t));
+  CmdStats *stats = calloc(CMD_COUNT, sizeof(CmdStats));
+  char *res = malloc(max_res + 1);
+  if (slots == NULL || pfds == NULL || backlog == NULL || stats == NULL ||
+      res == NULL) {
+    log_exit("Load allocation failure");
+  }
+
+  for (int i = 0; i < p.sockets; i++) {
+    slots[i].fd = connect_socket(&storage);
+    slots[i].req = malloc(max_req);
+    if (slots[i].req == NULL) {
+      log_exit("Load allocation failure");
+    }
+    pfds[i].fd = slots[i].fd;
+    pfds[i].events = POLLIN;
+  }
+  for (int i = 0; i < CMD_COUNT; i++) {
+    hist_init(&stats[i].hist);
+  }
+
+  int mix_total = p.mix[0] + p.mix[1] + p.mix[2] + p.mix[3];
+  uint32_t seed = (uint32_t)time(NULL) | 1;
+  uint32_t nonce = 0;
+  RttEstimator est;
+  rtt_init(&est);
+
+  // open loop schedule, latencies count from the intended send time
+  // so a slow server can't hide its queueing delay
+  uint64_t interval_ns = p.rate > 0 ? (uint64_t)(1e9 / p.rate) : 0;
+  uint64_t start = now_us();
+  uint64_t end = start + (uint64_t)(p.duration * 1e6);
+  uint64_t next_ns = start * 1000;
+  size_t backlog_head = 0;
+  size_t backlog_count = 0;
+  uint64_t overflow = 0;
+
+  LOG_MSG(LOG_INFO, "main(): %s loop load for %.1f s\n",
+          p.rate > 0 ? "open" : "closed", p.duration);
+
+  uint64_t now = start;
+  while (now < end) {
+    // schedule the open loop requests due by now
+    if (interval_ns > 0) {
+      while (next_ns <= now * 1000) {
+        if (backlog_count == BACKLOG_SIZE) {
+          overflow++;
+        } else {
+          backlog[(backlog_head + backlog_count++) % BACKLOG_SIZE] =
+              next_ns / 1000;
+        }
+        next_ns += interval_ns;
+      }
+    }
+
+    // start requests on the free sockets
+    for (int i = 0; i < p.sockets; i++) {
+      if (slots[i].busy) {
+        continue;
+      }
+
+      uint64_t intended = now;
+      if (interval_ns > 0) {
+        if (backlog_count == 0) {
+          break;
+        }
+        intended = backlog[backlog_head];
+        backlog_head = (backlog_head + 1) % BACKLOG_SIZE;
+        backlog_count--;
+      }
+
+      int cmd = pick_command(p.mix, mix_total, &seed);
+      start_request(&slots[i], cmd, templates, ++nonce, intended, &est, stats);
+    }
+
+    // wait until the next request is due or a retransmission timeout
+    uint64_t wake = end;
+    if (interval_ns > 0 && next_ns / 1000 < wake) {
+      wake = next_ns / 1000;
+    }
+    for (int i = 0; i < p.sockets; i++) {
+      if (slots[i].busy && slots[i].deadline_us < wake) {
+        wake = slots[i].deadline_us;
+      }
+    }
+
+    now = now_us();
+    struct timespec ts = {0, 0};
+    if (wake > now) {
+      ts.tv_sec = (wake - now) / 1000000;
+      ts.tv_nsec = ((wake - now) % 1000000) * 1000;
+    }
+    int ready = ppoll(pfds, p.sockets, &ts, NULL);
+    if (ready < 0 && errno != EINTR) {
+      log_exit("Poll failure");
+    }
+
+    now = now_us();
+    for (int i = 0; i < p.sockets; i++) {
+      Slot *s = &slots[i];
+
+      // responses
+      if (pfds[i].revents & (POLLIN | POLLERR)) {
+        ssize_t n = recv(s->fd, res, max_res + 1, MSG_DONTWAIT);
+        if (n <= 0 || !s->busy) {
+          continue;
+        }
+
+        // late duplicates of a previous request are dropped
+        CmdStats *cs = &stats[s->cmd];
+        if (n == RESPONSE_ERROR_LENGHT) {
+          cs->errors++;
+        } else if ((size_t)n != templates[s->cmd].res_size ||
+                   !response_matches(s, res)) {
+          continue;
+        } else {
+          hist_record(&cs->hist, now - s->intended_us);
+        }
+
+        // a retransmitted request makes the round trip ambiguous
+        if (s->attempts == 1) {
+          rtt_sample(&est, (now - s->sent_us) / 1000);
+        }
+        s->busy = 0;
+        continue;
+      }
+
+      // timeouts
+      if (s->busy && now >= s->deadline_us) {
+        if (s->attempts >= MAX_ATTEMPTS) {
+          stats[s->cmd].lost++;
+          s->busy = 0;
+          continue;
+        }
+
+        s->attempts++;
+        stats[s->cmd].retransmits++;
+        s->deadline_us = now + (uint64_t)rtt_timeout(&est, s->attempts) * 1000;
+        send(s->fd, s->req, s->req_size, 0);
+      }
+    }
+  }
+
+  // report
+  double elapsed = (now_us() - start) / 1e6;
+  Histogram all;
+  hist_init(&all);
+  uint64_t sent = 0, done = 0, errors = 0, lost = 0, retransmits = 0;
+
+  printf("mode=%s sockets=%d duration=%.2fs", p.rate > 0 ? "open" : "closed",
+         p.sockets, elapsed);
+  if (p.rate > 0) {
+    printf(" target=%.0f/s", p.rate);
+  }
+  printf("\n");
+
+  for (int i = 0; i < CMD_COUNT; i++) {
+    CmdStats *cs = &stats[i];
+    if (cs->sent == 0) {
+      continue;
+    }
+    hist_print(&cs->hist, cmd_names[i], stdout);
+    printf("      sent=%" PRIu64 " errors=%" PRIu64 " lost=%" PRIu64
+           " retransmits=%" PRIu64 "\n",
+           cs->sent, cs->errors, cs->lost, cs->retransmits);
+
+    hist_merge(&all, &cs->hist);
+    sent += cs->sent;
+    done += cs->hist.total;
+    errors += cs->errors;
+    lost += cs->lost;
+    retransmits += cs->retransmits;
+  }
+
+  hist_print(&all, "all", stdout);
+  printf("throughput=%.0f/s sent=%" PRIu64 " errors=%" PRIu64 " lost=%" PRIu64
+         " retransmits=%" PRIu64 " backlog_overflow=%" PRIu64 "\n",
+         done / elapsed, sent, errors, lost, retransmits, overflow);
+
+  for (int i = 0; i < p.sockets; i++) {
+    close(slots[i].fd);
+    free(slots[i].req);
+  }
+  for (int i = 0; i < CMD_COUNT; i++) {
+    free(templates[i].data);
+  }
+  free(slots);
+  free(pfds);
+  free(backlog);
+  free(stats);
+  free(res);
+  return 0;
+}
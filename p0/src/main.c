@@ -1,3 +1,7 @@
+#include "bulk.h"
+#include "cache.h"
+#include "commands.h"
+#include "daemon.h"
 #include "messages.h"
 #include "network.h"
 #include "parser.h"
@@ -10,76 +14,113 @@ int main(int argc, char **argv) {
   // parse command line arguments
   Params p = parse_args(argc, argv);
 
-  // get the proper server addr
-  struct sockaddr_storage storage;
-  if (parse_addr(p.addr, p.port, &storage) != 0) {
-    log_exit("Addr parsing failure");
+  // commands sent to a running daemon
+  if (p.addr == NULL) {
+    int result = daemon_request(p.daemon_path, p.cmd_argc, p.cmd_argv, stdout);
+    clean_params(&p);
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
   }
-  struct sockaddr *server_addr = (struct sockaddr *)&storage;
 
-  // create udp socket
-  int sock_fd = socket(storage.ss_family, SOCK_DGRAM, 0);
-  if (sock_fd < 0) {
-    log_exit("Socket creation failure");
+  // optional token cache, consulted before the network
+  Cache cache;
+  Cache *c = NULL;
+  if (p.cache_file != NULL && cache_open(&cache, p.cache_file) == 0) {
+    c = &cache;
   }
 
-  // set socket timeout
-  struct timeval timeout;
-  timeout.tv_sec = 2;
-  timeout.tv_usec = 0;
-
-  if (setsockopt(sock_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) <
-      0) {
-    log_exit("Set socket timeout failure");
+  // cache invalidation doesn't talk to the server
+  if (strcmp(p.cmd, "invalidate") == 0) {
+    if (c == NULL) {
+      log_exit("Cache file failure");
+    }
+
+    char *result = run_command(NULL, &p, c);
+    printf("%s\n", result);
+    free(result);
+    cache_close(c);
+    clean_params(&p);
+    return 0;
   }
 
-  // connect to the server
-  if (connect(sock_fd, server_addr, sizeof(storage)) != 0) {
-    log_exit("Server connection failure");
+  // get the proper server addrs, a comma separated list of the same server
+  struct sockaddr_storage servers[MAX_ENDPOINTS];
+  int n = parse_endpoints(p.addr, p.port, servers, MAX_ENDPOINTS);
+  if (n < 0) {
+    log_exit("Addr parsing failure");
   }
 
   // set log level
   set_log_level(LOG_DEBUG);
 
-  // performm operations
-  char *response_str = NULL;
-  int response_int = -1;
-
-  // individual token request
-  if (strcmp(p.cmd, "itr") == 0) {
-    response_str = itr_operation(sock_fd, p.id, p.nonce);
+  // long lived client serving local commands
+  if (strcmp(p.cmd, "daemon") == 0) {
+    int result =
+        daemon_operation(servers, n, p.addr, p.port, p.daemon_path, c);
+    if (c != NULL) {
+      cache_close(c);
+    }
+    clean_params(&p);
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
   }
 
-  // individual token validation
-  else if (strcmp(p.cmd, "itv") == 0) {
-    response_int = itv_operation(sock_fd, p.sas);
+  // create and connect an udp socket to each server addr
+  Endpoints ep;
+  if (connect_endpoints(&ep, servers, n) < 0) {
+    log_exit("Server connection failure");
   }
 
-  // group token request
-  else if (strcmp(p.cmd, "gtr") == 0) {
-    response_str = gtr_operation(sock_fd, p.sas_list, p.N);
+  // the address that answered first the last time goes first
+  struct sockaddr_storage preferred;
+  if (c != NULL && cache_get_preferred(c, p.addr, p.port, &preferred) == 0) {
+    int idx = find_endpoint(&ep, &preferred);
+    ep.preferred = idx >= 0 ? idx : ep.preferred;
   }
 
-  // group token validation
-  else {
-    response_int = gtv_operation(sock_fd, p.gas);
+  // many individual requests at once, results are printed as they finish
+  if (strcmp(p.cmd, "bulk") == 0) {
+    FILE *input = stdin;
+    if (p.input_file != NULL) {
+      input = fopen(p.input_file, "r");
+      if (input == NULL) {
+        log_exit("Input file failure");
+      }
+    }
+
+    int failures = bulk_operation(ep.fds[ep.preferred], input, stdout, c);
+    if (input != stdin) {
+      fclose(input);
+    }
+
+    if (c != NULL) {
+      cache_close(c);
+    }
+    clean_params(&p);
+    close_endpoints(&ep);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
   }
 
+  // performm a single operation
+  char *response_str = run_command(&ep, &p, c);
+
   // print the response
   if (response_str) {
     printf("%s\n", response_str);
     free(response_str);
-  } else if (response_int >= 0) {
-    printf("%d\n", response_int);
   } else {
     log_exit("Internal server error");
   }
 
   // free all dinamically alocated memory
+  if (c != NULL) {
+    if (ep.answered) {
+      cache_set_preferred(c, p.addr, p.port, &ep.addrs[ep.preferred]);
+    }
+    cache_close(c);
+  }
   clean_params(&p);
 
-  // close socket
-  close(sock_fd);
+  // close sockets
+  close_endpoints(&ep);
 
   return 0;
 }
@@ -1,25 +1,20 @@
 #include "defs.h"
+#include "network.h"
+#include "rtt.h"
 #include "utils.h"
 #include <arpa/inet.h>
 #include <ctype.h>
+#include <errno.h>
 #include <messages.h>
+#include <poll.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
 
-// aux function to remove empty chars from a string
-static void trim_str(char *str, size_t len) {
-  char *end = str + len - 1;
-  while (end > str && isspace((unsigned char)*end)) {
-    end--;
-  }
-
-  *(end + 1) = '\0';
-}
-
 // aux function to get the correspondent error message
-static char *get_error_message(unsigned int error_code) {
+char *get_error_message(unsigned int error_code) {
   switch (error_code) {
   case INVALID_MESSAGE_CODE:
     return "Error: Request sent with an unknown type";
@@ -42,33 +37,212 @@ static char *get_error_message(unsigned int error_code) {
   }
 }
 
+// round trip estimation shared by all the commands of this client
+// daemon threads run commands concurrently, so it has a lock
+static RttEstimator estimator;
+static int estimator_ready = 0;
+static pthread_mutex_t estimator_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// check if a response answers the request, responses echo the request
+// bytes after the type, errors can't be matched and are left to the caller
+static int response_matches(const char *req, size_t req_size,
+                            const char *res, ssize_t res_size) {
+  if ((size_t)res_size < req_size) {
+    return 0;
+  }
+
+  uint16_t _type;
+  memcpy(&_type, req, sizeof(_type));
+  _type = htons(ntohs(_type) + 1);
+  return memcmp(res, &_type, sizeof(_type)) == 0 &&
+         memcmp(res + TYPE_BYTE_SIZE, req + TYPE_BYTE_SIZE,
+                req_size - TYPE_BYTE_SIZE) == 0;
+}
+
+// check if a response is a server error
+static int is_error_response(const char *res, ssize_t res_size) {
+  uint16_t _type;
+  memcpy(&_type, res, sizeof(_type));
+  return res_size == RESPONSE_ERROR_LENGHT &&
+         ntohs(_type) == ERROR_RESPONSE_TYPE;
+}
+
+// drop the datagrams left on a socket by previous requests
+static void drain_socket(int fd) {
+  char byte;
+  while (recv(fd, &byte, sizeof(byte), MSG_DONTWAIT) >= 0) {
+  }
+}
+
+// wait for the response of a request on the first count endpoints
+// late responses of previous requests on the sockets are dropped, errors
+// are only taken from the sockets the request was sent on
+// returns the response size and the endpoint that got it or -1
+static ssize_t wait_response(Endpoints *ep, int count, const char *req,
+                             size_t req_size, char *res, size_t res_size,
+                             const int *sent_count, int timeout_ms,
+                             int *from) {
+  uint64_t deadline = now_ms() + timeout_ms;
+
+  struct pollfd pfds[MAX_ENDPOINTS];
+  int idxs[MAX_ENDPOINTS];
+  for (int i = 0; i < count; i++) {
+    idxs[i] = (ep->preferred + i) % ep->count;
+    pfds[i].fd = ep->fds[idxs[i]];
+    pfds[i].events = POLLIN;
+  }
+
+  while (1) {
+    uint64_t now = now_ms();
+    if (now >= deadline) {
+      return -1;
+    }
+
+    int ready = poll(pfds, count, (int)(deadline - now));
+    if (ready < 0 && errno != EINTR) {
+      return -1;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+
+    for (int i = 0; i < count; i++) {
+      if (pfds[i].revents == 0) {
+        continue;
+      }
+
+      ssize_t bytes_count = recv(pfds[i].fd, res, res_size, MSG_DONTWAIT);
+      if (bytes_count > 0) {
+        int error = is_error_response(res, bytes_count);
+        if ((error && sent_count[idxs[i]] > 0) ||
+            (!error && response_matches(req, req_size, res, bytes_count))) {
+          *from = idxs[i];
+          return bytes_count;
+        }
+        LOG_MSG(LOG_INFO, "wait_response(): unmatched response dropped\n");
+        continue;
+      }
+
+      // an unreachable server is reported as a socket error, keep waiting
+      LOG_MSG(LOG_WARNING, "wait_response(): receive failure\n");
+    }
+  }
+}
+
 // try to send request and receive response
-static int send_receive(int fd, char *req, size_t req_size, char *res,
-                        size_t res_size) {
+// the timeout of each attempt follows the measured round trip time
+// with many server addresses each attempt is a race: the preferred address
+// goes first and the next one joins every RACE_DELAY_MS without a response,
+// the first address to answer becomes the preferred one
+// the response takes up to res_cap bytes and its size goes to res_size
+// returns 0 on success, the server error code or -1 without response
+int send_receive(Endpoints *ep, char *req, size_t req_size, char *res,
+                 size_t res_cap, size_t *res_size) {
   LOG_MSG(LOG_INFO, "send_receive(): init\n");
+  pthread_mutex_lock(&estimator_lock);
+  if (!estimator_ready) {
+    rtt_init(&estimator);
+    estimator_ready = 1;
+  }
+  pthread_mutex_unlock(&estimator_lock);
+
   //  attempts to send request and receive reponse
   int max_attempts = MAX_ATTEMPTS;
   int total_attempts = 0;
   ssize_t bytes_count;
+  uint64_t deadline = now_ms() + COMMAND_DEADLINE_MS;
+  uint64_t sent_at[MAX_ENDPOINTS];
+  int sent_count[MAX_ENDPOINTS] = {0};
+
+  // pooled sockets may hold answers to earlier requests
+  for (int i = 0; i < ep->count; i++) {
+    drain_socket(ep->fds[i]);
+  }
 
   while (total_attempts < max_attempts) {
+    uint64_t now = now_ms();
+    if (now >= deadline) {
+      break;
+    }
+
     total_attempts++;
     LOG_MSG(LOG_INFO, "send_receive(): attempt %d\n", total_attempts);
 
-    // try to send the request
-    bytes_count = send(fd, req, req_size, 0);
-    if (bytes_count != (ssize_t)req_size) {
-      LOG_MSG(LOG_ERROR, "send_receive(): message send failure\n");
-      return -1;
+    // never wait past the command deadline
+    pthread_mutex_lock(&estimator_lock);
+    int timeout = rtt_timeout(&estimator, total_attempts);
+    pthread_mutex_unlock(&estimator_lock);
+    if (now + timeout > deadline) {
+      timeout = (int)(deadline - now);
     }
-    LOG_MSG(LOG_INFO, "send_receive(): %ld bytes sent successfully\n",
-            bytes_count);
+    uint64_t attempt_end = now + timeout;
+
+    int started = 0;
+    int sent_ok = 0;
+    uint64_t next_start = now;
+
+    while (1) {
+      now = now_ms();
+
+      // try to send the request to the next address
+      if (started < ep->count && now >= next_start) {
+        int idx = (ep->preferred + started) % ep->count;
+        started++;
+
+        bytes_count = send(ep->fds[idx], req, req_size, 0);
+        if (bytes_count != (ssize_t)req_size) {
+          LOG_MSG(LOG_WARNING, "send_receive(): send failure on address %d\n",
+                  idx);
+          continue;
+        }
+        LOG_MSG(LOG_INFO, "send_receive(): %ld bytes sent to address %d\n",
+                bytes_count, idx);
+
+        sent_ok++;
+        sent_at[idx] = now;
+        sent_count[idx]++;
+        next_start = now + RACE_DELAY_MS;
+        continue;
+      }
+
+      // no address can be reached
+      if (sent_ok == 0) {
+        LOG_MSG(LOG_ERROR, "send_receive(): message send failure\n");
+        return -1;
+      }
 
-    // try to receive the response
-    bytes_count = recv(fd, res, res_size, 0);
+      if (now >= attempt_end) {
+        break;
+      }
+
+      // wait until the response or the next address joins the race
+      uint64_t wake = attempt_end;
+      if (started < ep->count && next_start < wake) {
+        wake = next_start;
+      }
+
+      int from = 0;
+      bytes_count = wait_response(ep, started, req, req_size, res, res_cap,
+                                  sent_count, (int)(wake - now), &from);
+      if (bytes_count <= 0) {
+        continue;
+      }
+
+      ep->answered = 1;
+
+      // a retransmitted request makes the round trip ambiguous
+      if (sent_count[from] == 1) {
+        pthread_mutex_lock(&estimator_lock);
+        rtt_sample(&estimator, now_ms() - sent_at[from]);
+        pthread_mutex_unlock(&estimator_lock);
+      }
+
+      if (from != ep->preferred) {
+        LOG_MSG(LOG_INFO, "send_receive(): address %d is now preferred\n",
+                from);
+        ep->preferred = from;
+      }
 
-    // if any byte is received
-    if (bytes_count > 0) {
       // error bytes
       if (bytes_count == RESPONSE_ERROR_LENGHT) {
         LOG_MSG(LOG_ERROR, "send_receive(): got response error\n");
@@ -78,52 +252,288 @@ static int send_receive(int fd, char *req, size_t req_size, char *res,
         memcpy(&error_code, res + byte_offset, sizeof(error_code));
         return ntohs(error_code);
       }
+
       // got response
-      else {
-        LOG_MSG(LOG_INFO, "send_receive(): %ld bytes received successfully\n",
-                bytes_count);
-        return 0;
-      }
+      LOG_MSG(LOG_INFO, "send_receive(): %ld bytes received successfully\n",
+              bytes_count);
+      *res_size = bytes_count;
+      return 0;
     }
-    LOG_MSG(LOG_WARNING, "send_receive(): no response yet, retry...\n");
+    LOG_MSG(LOG_WARNING, "send_receive(): no response after %d ms, retry...\n",
+            timeout);
   }
   // no response from server
   LOG_MSG(LOG_ERROR, "send_receive(): no response from server\n");
   return -1;
 }
 
-// individual token request operation
-char *itr_operation(int fd, const char *id, uint32_t nonce) {
-  LOG_MSG(LOG_INFO, "itr_operation(): init\n");
-  // request structure
-  size_t req_size = TYPE_BYTE_SIZE + ID_BYTE_SIZE + NONCE_BYTE_SIZE;
-  char request[req_size];
-
-  // init bytes
-  memset(request, 0, req_size);
+// build an individual token request, returns its size
+size_t encode_itr_request(char *req, const char *id, uint32_t nonce) {
   size_t byte_offset = 0;
 
   // set type
   uint16_t _type = htons(ITR_REQUEST_TYPE);
-  memcpy(request, &_type, sizeof(_type));
+  memcpy(req, &_type, sizeof(_type));
   byte_offset += sizeof(_type);
 
   // set id
-  memset(request + byte_offset, ' ', ID_BYTE_SIZE);
-  memcpy(request + byte_offset, id, strlen(id));
+  memset(req + byte_offset, ' ', ID_BYTE_SIZE);
+  memcpy(req + byte_offset, id, strnlen(id, ID_BYTE_SIZE));
   byte_offset += ID_BYTE_SIZE;
 
   // set nonce
   uint32_t _nonce = htonl(nonce);
-  memcpy(request + byte_offset, &_nonce, sizeof(_nonce));
+  memcpy(req + byte_offset, &_nonce, sizeof(_nonce));
+  byte_offset += sizeof(_nonce);
+
+  return byte_offset;
+}
+
+// parse a <id>:<nonce>:<token> SAS of len chars into its wire bytes
+// returns -1 if it is malformed
+int encode_sas(char *dst, const char *sas, size_t len) {
+  const char *end = sas + len;
+
+  // id, padded with spaces
+  const char *colon = memchr(sas, ':', len);
+  size_t id_len = colon != NULL ? (size_t)(colon - sas) : 0;
+  if (id_len == 0 || id_len > ID_BYTE_SIZE) {
+    return -1;
+  }
+  memset(dst, ' ', ID_BYTE_SIZE);
+  memcpy(dst, sas, id_len);
+
+  // nonce
+  const char *p = colon + 1;
+  uint64_t nonce = 0;
+  const char *digits = p;
+  while (p < end && *p >= '0' && *p <= '9') {
+    nonce = nonce * 10 + (*p - '0');
+    if (nonce > UINT32_MAX) {
+      return -1;
+    }
+    p++;
+  }
+  if (p == digits || p >= end || *p != ':') {
+    return -1;
+  }
+  uint32_t _nonce = htonl((uint32_t)nonce);
+  memcpy(dst + ID_BYTE_SIZE, &_nonce, sizeof(_nonce));
+  p++;
+
+  // token
+  if ((size_t)(end - p) != TOKEN_BYTE_SIZE) {
+    return -1;
+  }
+  memcpy(dst + ID_BYTE_SIZE + NONCE_BYTE_SIZE, p, TOKEN_BYTE_SIZE);
+  return 0;
+}
+
+// write the printable form of a SAS in wire bytes, without the null char
+// returns its length, at most SAS_STR_SIZE - 1
+size_t decode_sas(const char *src, char *dst) {
+  char *out = dst;
+
+  // id without the padding
+  size_t id_len = ID_BYTE_SIZE;
+  while (id_len > 0 && isspace((unsigned char)src[id_len - 1])) {
+    id_len--;
+  }
+  memcpy(out, src, id_len);
+  out += id_len;
+  *out++ = ':';
+
+  // nonce digits are written backwards first
+  uint32_t _nonce;
+  memcpy(&_nonce, src + ID_BYTE_SIZE, sizeof(_nonce));
+  uint32_t nonce = ntohl(_nonce);
+  char digits[10];
+  int count = 0;
+  do {
+    digits[count++] = '0' + nonce % 10;
+    nonce /= 10;
+  } while (nonce > 0);
+  while (count > 0) {
+    *out++ = digits[--count];
+  }
+  *out++ = ':';
+
+  memcpy(out, src + ID_BYTE_SIZE + NONCE_BYTE_SIZE, TOKEN_BYTE_SIZE);
+  out += TOKEN_BYTE_SIZE;
+  return out - dst;
+}
+
+// build an individual token validation request for a SAS string
+// returns its size or -1 if the SAS can't be parsed
+int encode_itv_request(char *req, const char *sas) {
+  uint16_t _type = htons(ITV_REQUEST_TYPE);
+  memcpy(req, &_type, sizeof(_type));
+
+  if (encode_sas(req + TYPE_BYTE_SIZE, sas, strlen(sas)) != 0) {
+    return -1;
+  }
+  return ITV_REQUEST_SIZE;
+}
+
+// convert an individual token response to a SAS string
+// returns -1 if the response has an unexpected type or size
+int decode_itr_response(const char *res, size_t res_size, char *sas) {
+  uint16_t _type;
+  memcpy(&_type, res, sizeof(_type));
+  if (res_size != ITR_RESPONSE_SIZE || ntohs(_type) != ITR_RESPONSE_TYPE) {
+    return -1;
+  }
+
+  size_t len = decode_sas(res + TYPE_BYTE_SIZE, sas);
+  sas[len] = '\0';
+  return 0;
+}
+
+// build a group token request from a SAS list
+// returns its size or -1 if a SAS can't be parsed or it doesn't fit req_cap
+int encode_gtr_request(char *req, size_t req_cap, char **sas_list, int n) {
+  size_t req_size = GTR_REQUEST_BASE_SIZE + (size_t)n * SAS_BYTE_SIZE;
+  if (n <= 0 || n > MAX_GROUP_SIZE || req_size > req_cap) {
+    return -1;
+  }
+
+  uint16_t _type = htons(GTR_REQUEST_TYPE);
+  uint16_t _n = htons(n);
+  memcpy(req, &_type, sizeof(_type));
+  memcpy(req + TYPE_BYTE_SIZE, &_n, sizeof(_n));
+
+  char *sas = req + GTR_REQUEST_BASE_SIZE;
+  for (int i = 0; i < n; i++, sas += SAS_BYTE_SIZE) {
+    if (encode_sas(sas, sas_list[i], strlen(sas_list[i])) != 0) {
+      LOG_MSG(LOG_ERROR, "encode_gtr_request(): failed to parse SAS %d\n", i);
+      return -1;
+    }
+  }
+  return req_size;
+}
+
+// build a group token validation request from a GAS in a single pass
+// returns its size or -1 if the GAS can't be parsed or it doesn't fit req_cap
+int encode_gtv_request(char *req, size_t req_cap, const char *gas) {
+  uint16_t _type = htons(GTV_REQUEST_TYPE);
+  memcpy(req, &_type, sizeof(_type));
+
+  // every + ends a SAS, the group token comes after the last one
+  size_t byte_offset = GTR_REQUEST_BASE_SIZE;
+  int n = 0;
+  const char *p = gas;
+  const char *plus;
+
+  while ((plus = strchr(p, '+')) != NULL) {
+    if (n == MAX_GROUP_SIZE || byte_offset + SAS_BYTE_SIZE > req_cap ||
+        encode_sas(req + byte_offset, p, plus - p) != 0) {
+      LOG_MSG(LOG_ERROR, "encode_gtv_request(): failed to parse SAS %d\n", n);
+      return -1;
+    }
+    byte_offset += SAS_BYTE_SIZE;
+    n++;
+    p = plus + 1;
+  }
+
+  if (n == 0 || strlen(p) != TOKEN_BYTE_SIZE ||
+      byte_offset + TOKEN_BYTE_SIZE > req_cap) {
+    LOG_MSG(LOG_ERROR, "encode_gtv_request(): invalid GAS token\n");
+    return -1;
+  }
+  memcpy(req + byte_offset, p, TOKEN_BYTE_SIZE);
+  byte_offset += TOKEN_BYTE_SIZE;
+
+  uint16_t _n = htons(n);
+  memcpy(req + TYPE_BYTE_SIZE, &_n, sizeof(_n));
+  return byte_offset;
+}
+
+// number of SAS of a group message, returns -1 if res_size doesn't match
+static int group_count(const char *res, size_t res_size, size_t base_size) {
+  if (res_size < base_size) {
+    return -1;
+  }
+
+  uint16_t _n;
+  memcpy(&_n, res + TYPE_BYTE_SIZE, sizeof(_n));
+  int n = ntohs(_n);
+  if (res_size != base_size + (size_t)n * SAS_BYTE_SIZE) {
+    return -1;
+  }
+  return n;
+}
+
+// convert a group token response to a GAS string
+// gas must hold GAS_STR_SIZE(n) chars, returns its length or -1
+int decode_gtr_response(const char *res, size_t res_size, char *gas,
+                        size_t gas_cap) {
+  uint16_t _type;
+  memcpy(&_type, res, sizeof(_type));
+  int n = group_count(res, res_size, GTV_REQUEST_BASE_SIZE);
+  if (ntohs(_type) != GTR_RESPONSE_TYPE || n <= 0 ||
+      gas_cap < GAS_STR_SIZE(n)) {
+    return -1;
+  }
+
+  char *out = gas;
+  const char *sas = res + GTR_REQUEST_BASE_SIZE;
+  for (int i = 0; i < n; i++, sas += SAS_BYTE_SIZE) {
+    out += decode_sas(sas, out);
+    *out++ = '+';
+  }
+
+  memcpy(out, sas, TOKEN_BYTE_SIZE);
+  out += TOKEN_BYTE_SIZE;
+  *out = '\0';
+  return out - gas;
+}
+
+// get the status of a group token validation response
+// returns 0 if the GAS is valid, 1 if invalid and -1 for unexpected responses
+int decode_gtv_response(const char *res, size_t res_size) {
+  uint16_t _type;
+  memcpy(&_type, res, sizeof(_type));
+  if (ntohs(_type) != GTV_RESPONSE_TYPE ||
+      group_count(res, res_size, GTV_REQUEST_BASE_SIZE + STATUS_BYTE_SIZE) <=
+          0) {
+    return -1;
+  }
+
+  uint8_t invalid;
+  memcpy(&invalid, res + res_size - STATUS_BYTE_SIZE, sizeof(invalid));
+  return invalid > 0 ? 1 : 0;
+}
+
+// get the status of an individual token validation response
+// returns 0 if the SAS is valid, 1 if invalid and -1 for unexpected responses
+int decode_itv_response(const char *res, size_t res_size) {
+  uint16_t _type;
+  memcpy(&_type, res, sizeof(_type));
+  if (res_size != ITV_RESPONSE_SIZE || ntohs(_type) != ITV_RESPONSE_TYPE) {
+    return -1;
+  }
+
+  uint8_t invalid;
+  memcpy(&invalid, res + ITV_REQUEST_SIZE, sizeof(invalid));
+  return invalid > 0 ? 1 : 0;
+}
+
+// individual token request operation
+char *itr_operation(Endpoints *ep, const char *id, uint32_t nonce) {
+  LOG_MSG(LOG_INFO, "itr_operation(): init\n");
+
+  // request structure
+  char request[ITR_REQUEST_SIZE];
+  size_t req_size = encode_itr_request(request, id, nonce);
 
   // response structure
-  size_t res_size = req_size + TOKEN_BYTE_SIZE;
-  char response[res_size];
-  memset(response, 0, res_size);
+  char response[ITR_RESPONSE_SIZE];
+  memset(response, 0, sizeof(response));
 
   // try to send request and receive response
-  int result = send_receive(fd, request, req_size, response, res_size);
+  size_t res_size = 0;
+  int result = send_receive(ep, request, req_size, response, sizeof(response),
+                            &res_size);
 
   // failure
   if (result < 0) {
@@ -133,47 +543,21 @@ char *itr_operation(int fd, const char *id, uint32_t nonce) {
 
   // response error
   if (result > 0) {
-    char *msg = NULL;
-
-    if (asprintf(&msg, "%s", get_error_message(result)) < 0) {
-      LOG_MSG(LOG_ERROR, "itr_operation(): reponse conversion failed\n");
-      return NULL;
-    }
-
     LOG_MSG(LOG_ERROR, "itr_operation(): exit with error message\n");
-    return msg;
+    return strdup(get_error_message(result));
   }
 
   // got response
-  memcpy(&_type, response, sizeof(_type));
-  _type = ntohs(_type);
-
-  // check valid type
-  if (_type != ITR_RESPONSE_TYPE) {
-    LOG_MSG(LOG_ERROR, "itr_operation(): invalid response type\n");
+  char *msg = malloc(SAS_STR_SIZE);
+  if (msg == NULL) {
+    LOG_MSG(LOG_ERROR, "itr_operation(): reponse conversion failed\n");
     return NULL;
   }
 
-  // copy response id
-  byte_offset = sizeof(_type);
-  char _id[ID_BYTE_SIZE];
-  memcpy(_id, response + byte_offset, ID_BYTE_SIZE);
-  trim_str(_id, ID_BYTE_SIZE);
-  byte_offset += ID_BYTE_SIZE;
-
-  // copy response nonce
-  memcpy(&_nonce, response + byte_offset, sizeof(_nonce));
-  _nonce = ntohl(_nonce);
-  byte_offset += sizeof(_nonce);
-
-  // copy response token
-  char _token[TOKEN_BYTE_SIZE + 1];
-  memcpy(_token, response + byte_offset, TOKEN_BYTE_SIZE);
-  _token[TOKEN_BYTE_SIZE] = '\0';
-
-  char *msg = NULL;
-  if (asprintf(&msg, "%s:%u:%s", _id, nonce, _token) < 0) {
-    LOG_MSG(LOG_ERROR, "itr_operation(): reponse conversion failed\n");
+  // check valid type
+  if (decode_itr_response(response, res_size, msg) != 0) {
+    LOG_MSG(LOG_ERROR, "itr_operation(): invalid response type\n");
+    free(msg);
     return NULL;
   }
 
@@ -183,56 +567,25 @@ char *itr_operation(int fd, const char *id, uint32_t nonce) {
 
 // individual token validation operation
 // returns 0 if the token is valid and 1 otherwise
-int itv_operation(int fd, const char *sas) {
+int itv_operation(Endpoints *ep, const char *sas) {
   LOG_MSG(LOG_INFO, "itv_operation(): init\n");
 
   // request structure
-  size_t req_size =
-      TYPE_BYTE_SIZE + ID_BYTE_SIZE + NONCE_BYTE_SIZE + TOKEN_BYTE_SIZE;
-  char request[req_size];
-
-  // init bytes
-  memset(request, 0, req_size);
-  size_t byte_offset = 0;
-
-  // set type
-  uint16_t _type = htons(ITV_REQUEST_TYPE);
-  memcpy(request, &_type, sizeof(_type));
-  byte_offset += sizeof(_type);
-
-  // parse SAS
-  char _id[ID_BYTE_SIZE + 1];
-  uint32_t _nonce;
-  char _token[TOKEN_BYTE_SIZE + 1];
-
-  if (sscanf(sas, "%12[^:]:%u:%64s", _id, &_nonce, _token) != 3) {
+  char request[ITV_REQUEST_SIZE];
+  int req_size = encode_itv_request(request, sas);
+  if (req_size < 0) {
     LOG_MSG(LOG_ERROR, "itv_operation(): SAS parsing failure\n");
     return 1;
-  };
-
-  _id[ID_BYTE_SIZE] = '\0';
-  _nonce = htonl(_nonce);
-  _token[TOKEN_BYTE_SIZE] = '\0';
-
-  // set id
-  memset(request + byte_offset, ' ', ID_BYTE_SIZE);
-  memcpy(request + byte_offset, _id, strlen(_id));
-  byte_offset += ID_BYTE_SIZE;
-
-  // set nonce
-  memcpy(request + byte_offset, &_nonce, sizeof(_nonce));
-  byte_offset += sizeof(_nonce);
-
-  // set token
-  memcpy(request + byte_offset, _token, TOKEN_BYTE_SIZE);
+  }
 
   // response structure
-  size_t res_size = req_size + STATUS_BYTE_SIZE;
-  char response[res_size];
-  memset(response, 0, res_size);
+  char response[ITV_RESPONSE_SIZE];
+  memset(response, 0, sizeof(response));
 
   // try to send the request and receive the response
-  int result = send_receive(fd, request, req_size, response, res_size);
+  size_t res_size = 0;
+  int result = send_receive(ep, request, req_size, response, sizeof(response),
+                            &res_size);
 
   // failure
   if (result < 0) {
@@ -247,21 +600,15 @@ int itv_operation(int fd, const char *sas) {
   }
 
   // got response
-  memcpy(&_type, response, sizeof(_type));
-  _type = ntohs(_type);
+  int invalid = decode_itv_response(response, res_size);
 
   // check valid type
-  if (_type != ITV_RESPONSE_TYPE) {
+  if (invalid < 0) {
     LOG_MSG(LOG_ERROR, "itv_operation(): invalid response type\n");
     return 1;
   }
 
   // check invalid
-  byte_offset = req_size;
-  uint8_t invalid;
-
-  memcpy(&invalid, response + byte_offset, sizeof(invalid));
-
   if (invalid > 0) {
     LOG_MSG(LOG_WARNING, "itv_operation(): invalid SAS\n");
     return 1;
@@ -272,245 +619,126 @@ int itv_operation(int fd, const char *sas) {
 }
 
 // send a list of SAS and return a GAS
-char *gtr_operation(int fd, char **sas_list, int n) {
+char *gtr_operation(Endpoints *ep, char **sas_list, int n) {
   LOG_MSG(LOG_INFO, "gtr_operation(): init\n");
 
-  // request structure
-  size_t req_size = TYPE_BYTE_SIZE + SAS_NUM_BYTE_SIZE + (n * SAS_BYTE_SIZE);
-  char request[req_size];
-
-  // init bytes
-  memset(request, 0, req_size);
-  size_t byte_offset = 0;
-
-  // set type
-  uint16_t _type = htons(GTR_REQUEST_TYPE);
-  memcpy(request, &_type, sizeof(_type));
-  byte_offset += sizeof(_type);
-
-  // set n
-  uint16_t _n = htons(n);
-  memcpy(request + byte_offset, &_n, sizeof(_n));
-  byte_offset += sizeof(_n);
-
-  // parse SAS list
-  char _id[ID_BYTE_SIZE + 1];
-  uint32_t _nonce;
-  char _token[TOKEN_BYTE_SIZE + 1];
-
-  for (int i = 0; i < n; i++) {
-    // parse SAS
-    if (sscanf(sas_list[i], "%12[^:]:%u:%64s", _id, &_nonce, _token) != 3) {
-      LOG_MSG(LOG_ERROR, "gtr_operation(): failed to parse SAS %d\n", i);
-      return NULL;
-    }
-
-    _id[ID_BYTE_SIZE] = '\0';
-    _token[TOKEN_BYTE_SIZE] = '\0';
-    _nonce = htonl(_nonce);
-
-    // set id
-    memset(request + byte_offset, ' ', ID_BYTE_SIZE);
-    memcpy(request + byte_offset, _id, strlen(_id));
-    byte_offset += ID_BYTE_SIZE;
-
-    // set nonce
-    memcpy(request + byte_offset, &_nonce, sizeof(_nonce));
-    byte_offset += sizeof(_nonce);
+  if (n <= 0 || n > MAX_GROUP_SIZE) {
+    LOG_MSG(LOG_ERROR, "gtr_operation(): invalid group size %d\n", n);
+    return NULL;
+  }
 
-    // set token
-    memcpy(request + byte_offset, _token, TOKEN_BYTE_SIZE);
-    byte_offset += TOKEN_BYTE_SIZE;
+  // request and response structures share a single buffer
+  size_t req_cap = GTR_REQUEST_BASE_SIZE + (size_t)n * SAS_BYTE_SIZE;
+  size_t res_cap = req_cap + TOKEN_BYTE_SIZE;
+  char *buffer = malloc(req_cap + res_cap);
+  if (buffer == NULL) {
+    LOG_MSG(LOG_ERROR, "gtr_operation(): buffer allocation failure\n");
+    return NULL;
   }
+  char *request = buffer;
+  char *response = buffer + req_cap;
 
-  // response structure
-  size_t res_size = req_size + TOKEN_BYTE_SIZE;
-  char response[res_size];
+  int req_size = encode_gtr_request(request, req_cap, sas_list, n);
+  if (req_size < 0) {
+    free(buffer);
+    return NULL;
+  }
 
   // try to send te request and receive the response
-  int result = send_receive(fd, request, req_size, response, res_size);
+  size_t res_size = 0;
+  int result =
+      send_receive(ep, request, req_size, response, res_cap, &res_size);
 
   // failure
   if (result < 0) {
     LOG_MSG(LOG_ERROR, "gtr_operation(): exit without response\n");
+    free(buffer);
     return NULL;
   }
 
   // error
   if (result > 0) {
-    char *msg = NULL;
-
-    if (asprintf(&msg, "%s", get_error_message(result)) < 0) {
-      LOG_MSG(LOG_ERROR, "gtr_operation(): reponse conversion failed\n");
-      return NULL;
-    }
     LOG_MSG(LOG_ERROR, "gtr_operation(): exit with error message\n");
-
-    return msg;
+    free(buffer);
+    return strdup(get_error_message(result));
   }
 
   // got response
-  memcpy(&_type, response, sizeof(_type));
-  _type = ntohs(_type);
-
-  // check valid type
-  if (_type != GTR_RESPONSE_TYPE) {
-    LOG_MSG(LOG_ERROR, "gtr_operation(): invalid response type\n");
+  char *message = malloc(GAS_STR_SIZE(n));
+  if (message == NULL ||
+      decode_gtr_response(response, res_size, message, GAS_STR_SIZE(n)) < 0) {
+    LOG_MSG(LOG_ERROR, "gtr_operation(): invalid response\n");
+    free(message);
+    free(buffer);
     return NULL;
   }
 
-  byte_offset = TYPE_BYTE_SIZE + SAS_NUM_BYTE_SIZE;
-
-  // allocate all SAS size including ":" and "+"
-  char *message = calloc((res_size - byte_offset) + (n * 3), sizeof(char));
-  char *tmp = NULL;
-
-  // copy the response SAS list and build the GAS
-  for (int i = 0; i < n; i++) {
-    // copy id
-    memcpy(_id, response + byte_offset, ID_BYTE_SIZE);
-    trim_str(_id, ID_BYTE_SIZE);
-    byte_offset += ID_BYTE_SIZE;
-    _id[ID_BYTE_SIZE] = '\0';
-
-    // copy nonce
-    memcpy(&_nonce, response + byte_offset, sizeof(_nonce));
-    byte_offset += sizeof(_nonce);
-    _nonce = ntohl(_nonce);
-
-    // copy token
-    memcpy(_token, response + byte_offset, TOKEN_BYTE_SIZE);
-    byte_offset += TOKEN_BYTE_SIZE;
-    _token[TOKEN_BYTE_SIZE] = '\0';
-
-    // parse SAS
-    if (asprintf(&tmp, "%s:%u:%s", _id, _nonce, _token) < 0) {
-      LOG_MSG(LOG_ERROR, "gtr_operation(): SAS %d conversion failed\n", i);
-      return NULL;
-    }
-
-    // concatenate with previous SAS
-    strcat(message, tmp);
-    strcat(message, "+");
-  }
-
-  free(tmp);
-
-  // concatenate the token at the end
-  memcpy(_token, response + byte_offset, TOKEN_BYTE_SIZE);
-  _token[TOKEN_BYTE_SIZE] = '\0';
-  strcat(message, _token);
-
+  free(buffer);
   LOG_MSG(LOG_INFO, "gtr_operation(): exit with message\n");
   return message;
 }
 
 // group token valitation
 // return 0 if the GAS is valid and 1 otherwise
-int gtv_operation(int fd, char *gas) {
+int gtv_operation(Endpoints *ep, const char *gas) {
   LOG_MSG(LOG_INFO, "gtv_operation(): init\n");
 
   // count the number of SAS in a GAS
   int count = 0;
-
-  for (int i = 0; gas[i] != '\0'; i++) {
-    if (gas[i] == '+')
-      count++;
+  for (const char *p = strchr(gas, '+'); p != NULL; p = strchr(p + 1, '+')) {
+    count++;
   }
 
-  // request structure
-  size_t req_size = TYPE_BYTE_SIZE + SAS_NUM_BYTE_SIZE +
-                    (count * SAS_BYTE_SIZE) + TOKEN_BYTE_SIZE;
-  char request[req_size];
-
-  // init bytes
-  memset(request, 0, req_size);
-  size_t byte_offset = 0;
-
-  // set type
-  int16_t _type = htons(GTV_REQUEST_TYPE);
-  memcpy(request, &_type, sizeof(_type));
-  byte_offset += sizeof(_type);
-
-  // set n
-  int16_t _n = htons(count);
-  memcpy(request + byte_offset, &_n, sizeof(_n));
-  byte_offset += sizeof(_n);
-
-  // parse GAS
-  char _id[ID_BYTE_SIZE + 1];
-  int32_t _nonce;
-  char _token[TOKEN_BYTE_SIZE + 1];
-
-  char *tmp = strtok(gas, "+");
-
-  // copy SAS list to buffer
-  for (int i = 0; i < count; i++) {
-    // parse SAS
-    if (sscanf(tmp, "%12[^:]:%u:%64s", _id, &_nonce, _token) != 3) {
-      LOG_MSG(LOG_ERROR, "gtv_operation(): failed to parse SAS %d\n", i);
-      return 1;
-    }
-
-    _id[ID_BYTE_SIZE] = '\0';
-    _nonce = htonl(_nonce);
-    _token[TOKEN_BYTE_SIZE] = '\0';
-
-    // set id
-    memset(request + byte_offset, ' ', ID_BYTE_SIZE);
-    memcpy(request + byte_offset, _id, strlen(_id));
-    byte_offset += ID_BYTE_SIZE;
-
-    // set nonce
-    memcpy(request + byte_offset, &_nonce, sizeof(_nonce));
-    byte_offset += sizeof(_nonce);
-
-    // set token
-    memcpy(request + byte_offset, _token, TOKEN_BYTE_SIZE);
-    byte_offset += TOKEN_BYTE_SIZE;
-
-    tmp = strtok(NULL, "+");
+  if (count <= 0 || count > MAX_GROUP_SIZE) {
+    LOG_MSG(LOG_ERROR, "gtv_operation(): invalid group size %d\n", count);
+    return 1;
   }
 
-  // set the last token
-  strncpy(_token, tmp, TOKEN_BYTE_SIZE);
-  _token[TOKEN_BYTE_SIZE] = '\0';
-  memcpy(request + byte_offset, _token, TOKEN_BYTE_SIZE);
+  // request and response structures share a single buffer
+  size_t req_cap = GTV_REQUEST_BASE_SIZE + (size_t)count * SAS_BYTE_SIZE;
+  size_t res_cap = req_cap + STATUS_BYTE_SIZE;
+  char *buffer = malloc(req_cap + res_cap);
+  if (buffer == NULL) {
+    LOG_MSG(LOG_ERROR, "gtv_operation(): buffer allocation failure\n");
+    return 1;
+  }
+  char *request = buffer;
+  char *response = buffer + req_cap;
 
-  // response structure
-  size_t res_size = req_size + STATUS_BYTE_SIZE;
-  char response[res_size];
+  int req_size = encode_gtv_request(request, req_cap, gas);
+  if (req_size < 0) {
+    free(buffer);
+    return 1;
+  }
 
   // try  to send the request and receive the response
-  int result = send_receive(fd, request, req_size, response, res_size);
+  size_t res_size = 0;
+  int result =
+      send_receive(ep, request, req_size, response, res_cap, &res_size);
 
   // failure
   if (result < 0) {
     LOG_MSG(LOG_ERROR, "gtv_operation(): exit without response\n");
+    free(buffer);
     return 1;
   }
 
   if (result > 0) {
     LOG_MSG(LOG_ERROR, "gtv_operation(): %s\n", get_error_message(result));
+    free(buffer);
     return 1;
   }
 
   // got response
-  memcpy(&_type, response, sizeof(_type));
-  _type = ntohs(_type);
+  int invalid = decode_gtv_response(response, res_size);
+  free(buffer);
 
-  // check valid type
-  if (_type != GTV_RESPONSE_TYPE) {
-    LOG_MSG(LOG_ERROR, "gtv_operation(): invalid response type\n");
+  if (invalid < 0) {
+    LOG_MSG(LOG_ERROR, "gtv_operation(): invalid response\n");
     return 1;
   }
 
-  byte_offset = TYPE_BYTE_SIZE + SAS_NUM_BYTE_SIZE + (count * SAS_BYTE_SIZE) +
-                TOKEN_BYTE_SIZE;
-  int8_t valid;
-  memcpy(&valid, response + byte_offset, sizeof(valid));
-
-  if (valid > 0) {
+  if (invalid > 0) {
     LOG_MSG(LOG_WARNING, "gtv_operation(): invalid GAS\n");
     return 1;
   }
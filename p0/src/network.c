@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 // try to convert the addr and port strings to a valid addr structure
 int parse_addr(const char *addr_str, const char *port_str,
@@ -43,3 +44,95 @@ int parse_addr(const char *addr_str, const char *port_str,
   }
   return -1;
 }
+
+// parse a comma separated list of server addresses
+// returns the number of addresses or -1 if any of them is invalid
+int parse_endpoints(const char *list, const char *port_str,
+                    struct sockaddr_storage *addrs, int max) {
+  if (list == NULL) {
+    return -1;
+  }
+
+  int n = 0;
+  const char *p = list;
+  while (1) {
+    const char *comma = strchr(p, ',');
+    size_t len = comma != NULL ? (size_t)(comma - p) : strlen(p);
+
+    char addr_str[INET6_ADDRSTRLEN];
+    if (n == max || len == 0 || len >= sizeof(addr_str)) {
+      return -1;
+    }
+    memcpy(addr_str, p, len);
+    addr_str[len] = '\0';
+
+    memset(&addrs[n], 0, sizeof(addrs[n]));
+    if (parse_addr(addr_str, port_str, &addrs[n]) != 0) {
+      return -1;
+    }
+    n++;
+
+    if (comma == NULL) {
+      return n;
+    }
+    p = comma + 1;
+  }
+}
+
+// connect a udp socket to each address, unusable ones are skipped
+// returns the number of connected addresses or -1 if there is none
+int connect_endpoints(Endpoints *ep, struct sockaddr_storage *addrs, int n) {
+  ep->count = 0;
+  ep->preferred = 0;
+  ep->answered = 0;
+
+  for (int i = 0; i < n && ep->count < MAX_ENDPOINTS; i++) {
+    int fd = socket(addrs[i].ss_family, SOCK_DGRAM, 0);
+    if (fd < 0) {
+      continue;
+    }
+    if (connect(fd, (struct sockaddr *)&addrs[i], sizeof(addrs[i])) != 0) {
+      close(fd);
+      continue;
+    }
+    ep->addrs[ep->count] = addrs[i];
+    ep->fds[ep->count++] = fd;
+  }
+
+  return ep->count > 0 ? ep->count : -1;
+}
+
+// index of the connected address with the same ip and port
+// returns -1 if the address isn't connected
+int find_endpoint(const Endpoints *ep, const struct sockaddr_storage *addr) {
+  for (int i = 0; i < ep->count; i++) {
+    const struct sockaddr_storage *a = &ep->addrs[i];
+    if (a->ss_family != addr->ss_family) {
+      continue;
+    }
+
+    if (a->ss_family == AF_INET) {
+      const struct sockaddr_in *x = (const struct sockaddr_in *)a;
+      const struct sockaddr_in *y = (const struct sockaddr_in *)addr;
+      if (x->sin_port == y->sin_port &&
+          x->sin_addr.s_addr == y->sin_addr.s_addr) {
+        return i;
+      }
+    } else if (a->ss_family == AF_INET6) {
+      const struct sockaddr_in6 *x = (const struct sockaddr_in6 *)a;
+      const struct sockaddr_in6 *y = (const struct sockaddr_in6 *)addr;
+      if (x->sin6_port == y->sin6_port &&
+          memcmp(&x->sin6_addr, &y->sin6_addr, sizeof(x->sin6_addr)) == 0) {
+        return i;
+      }
+    }
+  }
+  return -1;
+}
+
+void close_endpoints(Endpoints *ep) {
+  for (int i = 0; i < ep->count; i++) {
+    close(ep->fds[i]);
+  }
+  ep->count = 0;
+}
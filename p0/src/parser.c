@@ -1,81 +1,324 @@
+#include "defs.h"
 #include "parser.h"
+#include "tokens.h"
 #include "utils.h"
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-Params parse_args(int argc, char **argv) {
-  // min expected arguments
-  if (argc < 4) {
-    usage(argv[0]);
-  }
-
-  // get params
-  Params p;
-  p.addr = argv[1];
-  p.port = argv[2];
-  p.cmd = argv[3];
-  p.nonce = 0;
-  p.N = 0;
-  p.id = NULL;
-  p.sas = NULL;
-  p.gas = NULL;
-  p.sas_list = NULL;
+// parse a command and its arguments, argv[0] is the command
+// returns NULL or an error message, the caller decides if it is fatal
+const char *parse_command(int argc, char **argv, Params *p) {
+  p->cmd = argv[0];
+  p->nonce = 0;
+  p->N = 0;
+  p->id = NULL;
+  p->sas = NULL;
+  p->gas = NULL;
+  p->sas_list = NULL;
+  p->id_list = NULL;
+  p->nonce_list = NULL;
+  p->verify = 0;
+  p->input_file = NULL;
 
   // individual token request
-  if (strcmp(p.cmd, "itr") == 0) {
-    if (argc < 6) {
-      log_exit("Bad itr usage");
+  if (strcmp(p->cmd, "itr") == 0) {
+    if (argc < 3) {
+      return "Bad itr usage";
     }
 
-    p.id = argv[4];
-    p.nonce = atoi(argv[5]);
+    p->id = argv[1];
+    p->nonce = atoi(argv[2]);
   }
 
   // indivitual token validation
-  else if (strcmp(p.cmd, "itv") == 0) {
-    if (argc < 5) {
-      log_exit("Bad itv usage");
+  else if (strcmp(p->cmd, "itv") == 0) {
+    if (argc < 2) {
+      return "Bad itv usage";
     }
 
-    p.sas = argv[4];
+    p->sas = argv[1];
   }
 
   // group token request
-  else if (strcmp(p.cmd, "gtr") == 0) {
-    if (argc < 5) {
-      log_exit("Bad gtr usage");
+  else if (strcmp(p->cmd, "gtr") == 0) {
+    if (argc < 2) {
+      return "Bad gtr usage";
     }
 
-    p.N = atoi(argv[4]);
+    int n = atoi(argv[1]);
+    if (n <= 0 || n > MAX_GROUP_SIZE || argc < 2 + n) {
+      return "Bad gtr usage";
+    }
 
-    if (argc < 5 + p.N) {
-      log_exit("Bad gtr usage");
+    p->sas_list = (char **)malloc(n * sizeof(char *));
+    if (p->sas_list == NULL) {
+      return "Bad gtr usage";
+    }
+    p->N = n;
+    for (int i = 2; i < 2 + n; i++) {
+      p->sas_list[i - 2] = strdup(argv[i]);
     }
+  }
 
-    p.sas_list = (char **)malloc(p.N * sizeof(char *));
-    for (int i = 5; i < 5 + p.N; i++) {
-      p.sas_list[i - 5] = strdup(argv[i]);
+  // group token from ids and nonces, optionally verified
+  else if (strcmp(p->cmd, "grp") == 0) {
+    if (argc < 2) {
+      return "Bad grp usage";
+    }
+
+    int n = atoi(argv[1]);
+    if (n <= 0 || n > MAX_GROUP_SIZE || argc < 2 + 2 * n) {
+      return "Bad grp usage";
+    }
+    p->verify = argc > 2 + 2 * n && strcmp(argv[2 + 2 * n], "verify") == 0;
+
+    // ids point to the arguments
+    p->id_list = (char **)malloc(n * sizeof(char *));
+    p->nonce_list = (int *)malloc(n * sizeof(int));
+    if (p->id_list == NULL || p->nonce_list == NULL) {
+      return "Bad grp usage";
+    }
+    p->N = n;
+    for (int i = 0; i < n; i++) {
+      p->id_list[i] = argv[2 + 2 * i];
+      p->nonce_list[i] = atoi(argv[3 + 2 * i]);
     }
   }
 
   // group token validation request
-  else if (strcmp(p.cmd, "gtv") == 0) {
-    if (argc < 5) {
-      log_exit("Bad gtv usage");
+  else if (strcmp(p->cmd, "gtv") == 0) {
+    if (argc < 2) {
+      return "Bad gtv usage";
+    }
+
+    p->gas = strdup(argv[1]);
+  }
+
+  // bulk itr and itv requests from a file or stdin
+  else if (strcmp(p->cmd, "bulk") == 0) {
+    if (argc >= 2 && strcmp(argv[1], "-") != 0) {
+      p->input_file = argv[1];
+    }
+  }
+
+  // drop cached tokens: a SAS, an <id>:<nonce>, a GAS or all
+  else if (strcmp(p->cmd, "invalidate") == 0) {
+    if (argc < 2) {
+      return "Bad invalidate usage";
+    }
+
+    p->sas = argv[1];
+  }
+
+  // serve commands on a unix socket
+  else if (strcmp(p->cmd, "daemon") == 0) {
+    if (argc < 2) {
+      return "Bad daemon usage";
     }
 
-    p.gas = strdup(argv[4]);
+    p->daemon_path = argv[1];
   }
 
   // invalid case
   else {
-    log_exit("Invalid command");
+    return "Invalid command";
+  }
+
+  return NULL;
+}
+
+Params parse_args(int argc, char **argv) {
+  const char *program = argv[0];
+
+  // options come before the positional arguments
+  static struct option options[] = {
+      {"cache", required_argument, NULL, 'c'},
+      {"daemon", required_argument, NULL, 'D'},
+      {NULL, 0, NULL, 0},
+  };
+
+  Params p;
+  p.addr = NULL;
+  p.port = NULL;
+  p.cache_file = NULL;
+  p.daemon_path = NULL;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "+c:D:", options, NULL)) != -1) {
+    if (opt == 'c') {
+      p.cache_file = optarg;
+    } else if (opt == 'D') {
+      p.daemon_path = optarg;
+    } else {
+      usage(program);
+    }
+  }
+  argc -= optind;
+  argv += optind;
+
+  // a running daemon has the server address already
+  if (p.daemon_path == NULL) {
+    if (argc < 3) {
+      usage(program);
+    }
+
+    p.addr = argv[0];
+    p.port = argv[1];
+    argc -= 2;
+    argv += 2;
+  }
+
+  // min expected arguments
+  if (argc < 1) {
+    usage(program);
+  }
+
+  p.cmd_argc = argc;
+  p.cmd_argv = argv;
+  const char *error = parse_command(argc, argv, &p);
+  if (error != NULL) {
+    log_exit(error);
+  }
+
+  return p;
+}
+
+// convert an integer in [min, max]
+// returns -1 if it isn't a number or it's out of range
+static int parse_int_range(const char *str, int min, int max) {
+  char *end;
+  errno = 0;
+  long value = strtol(str, &end, 10);
+  if (errno != 0 || end == str || *end != '\0' || value < min ||
+      value > max) {
+    return -1;
+  }
+  return (int)value;
+}
+
+// convert a non negative finite number
+// returns -1 if it isn't a number or it's out of range
+static double parse_non_negative(const char *str) {
+  char *end;
+  errno = 0;
+  double value = strtod(str, &end);
+  if (errno != 0 || end == str || *end != '\0' || !isfinite(value) ||
+      value < 0) {
+    return -1;
+  }
+  return value;
+}
+
+// convert a 64 bit key, in decimal, hex or octal
+// returns -1 if it isn't a number or it's out of range
+static int parse_key(const char *str, uint64_t *key) {
+  char *end;
+  errno = 0;
+  unsigned long long value = strtoull(str, &end, 0);
+  if (errno != 0 || end == str || *end != '\0' || str[0] == '-') {
+    return -1;
+  }
+  *key = value;
+  return 0;
+}
+
+// parse the stand-in server arguments: <port> [-t threads] [-k key] [-d]
+ServerParams parse_server_args(int argc, char **argv) {
+  if (argc < 2) {
+    server_usage(argv[0]);
+  }
+
+  ServerParams p;
+  int port = parse_int_range(argv[1], 1, UINT16_MAX);
+  if (port < 0) {
+    log_exit("Invalid port");
+  }
+
+  p.port = (uint16_t)port;
+  p.threads = DEFAULT_SERVER_THREADS;
+  p.key = DEFAULT_TOKEN_KEY;
+  p.debug_mode = 0;
+
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      p.threads = parse_int_range(argv[++i], 1, MAX_SERVER_THREADS);
+      if (p.threads < 0) {
+        log_exit("Invalid number of threads");
+      }
+    } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      if (parse_key(argv[++i], &p.key) < 0) {
+        log_exit("Invalid token key");
+      }
+    } else if (strcmp(argv[i], "-d") == 0) {
+      p.debug_mode = 1;
+    } else {
+      server_usage(argv[0]);
+    }
   }
 
   return p;
 }
 
+// parse the load generator arguments
+// rate 0 means closed loop, every socket keeps one request in flight
+LoadParams parse_load_args(int argc, char **argv) {
+  if (argc < 3) {
+    load_usage(argv[0]);
+  }
+
+  LoadParams p;
+  p.addr = argv[1];
+  p.port = argv[2];
+  p.rate = 0;
+  p.sockets = DEFAULT_LOAD_SOCKETS;
+  p.duration = DEFAULT_LOAD_SECONDS;
+  p.mix[0] = 1;
+  p.mix[1] = 1;
+  p.mix[2] = 1;
+  p.mix[3] = 1;
+  p.group_size = DEFAULT_LOAD_GROUP;
+  p.debug_mode = 0;
+
+  for (int i = 3; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      p.rate = parse_non_negative(argv[++i]);
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      p.sockets = parse_int_range(argv[++i], 1, MAX_LOAD_SOCKETS);
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      p.duration = parse_non_negative(argv[++i]);
+    } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      if (sscanf(argv[++i], "%d:%d:%d:%d", &p.mix[0], &p.mix[1], &p.mix[2],
+                 &p.mix[3]) != 4) {
+        log_exit("Invalid command mix");
+      }
+    } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+      p.group_size = parse_int_range(argv[++i], 1, MAX_GROUP_SIZE);
+    } else if (strcmp(argv[i], "-d") == 0) {
+      p.debug_mode = 1;
+    } else {
+      load_usage(argv[0]);
+    }
+  }
+
+  int total = 0;
+  for (int i = 0; i < 4; i++) {
+    if (p.mix[i] < 0) {
+      log_exit("Invalid command mix");
+    }
+    total += p.mix[i];
+  }
+
+  if (total == 0 || p.sockets <= 0 || p.duration <= 0 || p.rate < 0 ||
+      p.group_size <= 0 || p.group_size > MAX_GROUP_SIZE) {
+    log_exit("Invalid load parameters");
+  }
+  return p;
+}
+
 // free memory allocated for params
 void clean_params(Params *p) {
   if (p->gas != NULL) {
@@ -88,4 +331,12 @@ void clean_params(Params *p) {
     }
     free(p->sas_list);
   }
+
+  if (p->id_list != NULL) {
+    free(p->id_list);
+  }
+
+  if (p->nonce_list != NULL) {
+    free(p->nonce_list);
+  }
 }
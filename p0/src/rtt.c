@@ -0,0 +1,55 @@
+#include "rtt.h"
+#include <time.h>
+#include <unistd.h>
+
+// start with the initial timeout until the first sample arrives
+void rtt_init(RttEstimator *est) {
+  est->srtt_ms = 0;
+  est->rttvar_ms = 0;
+  est->rto_ms = RTO_INITIAL_MS;
+  est->has_sample = 0;
+  est->seed = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16) ^ 1;
+}
+
+// update the estimation with a new round trip sample
+// only responses to non retransmitted requests must be sampled
+void rtt_sample(RttEstimator *est, uint64_t rtt_ms) {
+  int r = rtt_ms > RTO_MAX_MS ? RTO_MAX_MS : (int)rtt_ms;
+
+  if (!est->has_sample) {
+    est->srtt_ms = r;
+    est->rttvar_ms = r / 2;
+    est->has_sample = 1;
+  } else {
+    int err = est->srtt_ms > r ? est->srtt_ms - r : r - est->srtt_ms;
+    est->rttvar_ms += (err - est->rttvar_ms) / 4;
+    est->srtt_ms += (r - est->srtt_ms) / 8;
+  }
+
+  est->rto_ms = est->srtt_ms + 4 * est->rttvar_ms;
+  if (est->rto_ms < RTO_MIN_MS) {
+    est->rto_ms = RTO_MIN_MS;
+  }
+  if (est->rto_ms > RTO_MAX_MS) {
+    est->rto_ms = RTO_MAX_MS;
+  }
+}
+
+// timeout of an attempt, doubled on each retransmission
+// a random jitter of up to 25% keeps clients from retrying in lockstep
+int rtt_timeout(RttEstimator *est, int attempt) {
+  int timeout = est->rto_ms;
+  for (int i = 1; i < attempt && timeout < RTO_MAX_MS; i++) {
+    timeout *= 2;
+  }
+  if (timeout > RTO_MAX_MS) {
+    timeout = RTO_MAX_MS;
+  }
+
+  // xorshift
+  est->seed ^= est->seed << 13;
+  est->seed ^= est->seed >> 17;
+  est->seed ^= est->seed << 5;
+
+  return timeout + (int)(est->seed % (uint32_t)(timeout / 4 + 1));
+}
@@ -0,0 +1,206 @@
+#include "tokens.h"
+#include "defs.h"
+#include <arpa/inet.h>
+#include <string.h>
+
+// key mixed into every token
+static uint64_t token_key = DEFAULT_TOKEN_KEY;
+
+void set_token_key(uint64_t key) { token_key = key; }
+
+// final avalanche of a 64 bit hash
+static uint64_t fmix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// deterministic 64 hex chars token of the data
+// four independent keyed FNV-1a lanes, each one gives 16 hex chars
+// it is not cryptographic, it only has to be stable for local tests
+void make_token(const char *data, size_t len, char *token) {
+  static const char hex[] = "0123456789abcdef";
+
+  for (int lane = 0; lane < 4; lane++) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ fmix64(token_key + lane);
+    for (size_t i = 0; i < len; i++) {
+      h ^= (unsigned char)data[i];
+      h *= 0x100000001b3ULL;
+    }
+    h = fmix64(h);
+
+    for (int i = 0; i < 16; i++) {
+      token[lane * 16 + i] = hex[(h >> (60 - 4 * i)) & 0xf];
+    }
+  }
+}
+
+// build an error response, returns its size
+static size_t error_response(char *res, uint16_t code) {
+  uint16_t _type = htons(ERROR_RESPONSE_TYPE);
+  uint16_t _code = htons(code);
+  memcpy(res, &_type, sizeof(_type));
+  memcpy(res + TYPE_BYTE_SIZE, &_code, sizeof(_code));
+  return RESPONSE_ERROR_LENGHT;
+}
+
+// check if the data is plain ascii
+static int valid_ascii(const char *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if ((unsigned char)data[i] > 127) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// check if the id and token of a SAS list are plain ascii, nonces are binary
+static int valid_sas_ascii(const char *sas_list, int n) {
+  for (int i = 0; i < n; i++, sas_list += SAS_BYTE_SIZE) {
+    if (!valid_ascii(sas_list, ID_BYTE_SIZE) ||
+        !valid_ascii(sas_list + ID_BYTE_SIZE + NONCE_BYTE_SIZE,
+                     TOKEN_BYTE_SIZE)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// check if the token of a SAS matches its id and nonce
+static int valid_sas(const char *sas) {
+  char token[TOKEN_BYTE_SIZE];
+  make_token(sas, ID_BYTE_SIZE + NONCE_BYTE_SIZE, token);
+  return memcmp(token, sas + ID_BYTE_SIZE + NONCE_BYTE_SIZE,
+                TOKEN_BYTE_SIZE) == 0;
+}
+
+// read the SAS count of a group message and check the message size
+// returns the count or -1 with the error code set
+static int group_size(const char *req, size_t req_size, size_t base_size,
+                      uint16_t *error) {
+  if (req_size < base_size) {
+    *error = INCORRECT_MESSAGE_LENGTH;
+    return -1;
+  }
+
+  uint16_t _n;
+  memcpy(&_n, req + TYPE_BYTE_SIZE, sizeof(_n));
+  int n = ntohs(_n);
+
+  if (n == 0 || n > MAX_GROUP_SIZE) {
+    *error = INVALID_PARAMETER;
+    return -1;
+  }
+  if (req_size != base_size + (size_t)n * SAS_BYTE_SIZE) {
+    *error = INCORRECT_MESSAGE_LENGTH;
+    return -1;
+  }
+  return n;
+}
+
+// answer a request of any type, returns the response size
+// res must hold up to MAX_DATAGRAM_SIZE bytes
+size_t handle_request(const char *req, size_t req_size, char *res) {
+  if (req_size < TYPE_BYTE_SIZE) {
+    return error_response(res, INVALID_MESSAGE_CODE);
+  }
+
+  uint16_t _type;
+  memcpy(&_type, req, sizeof(_type));
+  uint16_t type = ntohs(_type);
+  uint16_t response_type = htons(type + 1);
+  uint16_t error = 0;
+
+  switch (type) {
+  // individual token request
+  case ITR_REQUEST_TYPE: {
+    if (req_size != ITR_REQUEST_SIZE) {
+      return error_response(res, INCORRECT_MESSAGE_LENGTH);
+    }
+    if (!valid_ascii(req + TYPE_BYTE_SIZE, ID_BYTE_SIZE)) {
+      return error_response(res, ASCII_DECODE_ERROR);
+    }
+
+    memcpy(res, &response_type, sizeof(response_type));
+    memcpy(res + TYPE_BYTE_SIZE, req + TYPE_BYTE_SIZE,
+           ID_BYTE_SIZE + NONCE_BYTE_SIZE);
+    make_token(req + TYPE_BYTE_SIZE, ID_BYTE_SIZE + NONCE_BYTE_SIZE,
+               res + ITR_REQUEST_SIZE);
+    return ITR_RESPONSE_SIZE;
+  }
+
+  // individual token validation
+  case ITV_REQUEST_TYPE: {
+    if (req_size != ITV_REQUEST_SIZE) {
+      return error_response(res, INCORRECT_MESSAGE_LENGTH);
+    }
+    if (!valid_sas_ascii(req + TYPE_BYTE_SIZE, 1)) {
+      return error_response(res, ASCII_DECODE_ERROR);
+    }
+
+    memcpy(res, req, ITV_REQUEST_SIZE);
+    memcpy(res, &response_type, sizeof(response_type));
+    res[ITV_REQUEST_SIZE] = !valid_sas(req + TYPE_BYTE_SIZE);
+    return ITV_RESPONSE_SIZE;
+  }
+
+  // group token request, every SAS must be valid
+  case GTR_REQUEST_TYPE: {
+    int n = group_size(req, req_size, GTR_REQUEST_BASE_SIZE, &error);
+    if (n < 0) {
+      return error_response(res, error);
+    }
+
+    const char *sas_list = req + GTR_REQUEST_BASE_SIZE;
+    size_t list_size = (size_t)n * SAS_BYTE_SIZE;
+    if (!valid_sas_ascii(sas_list, n)) {
+      return error_response(res, ASCII_DECODE_ERROR);
+    }
+    for (int i = 0; i < n; i++) {
+      if (!valid_sas(sas_list + i * SAS_BYTE_SIZE)) {
+        return error_response(res, INVALID_SINGLE_TOKEN);
+      }
+    }
+
+    memcpy(res, req, req_size);
+    memcpy(res, &response_type, sizeof(response_type));
+    make_token(sas_list, list_size, res + req_size);
+    return req_size + TOKEN_BYTE_SIZE;
+  }
+
+  // group token validation, invalid SAS make the whole GAS invalid
+  case GTV_REQUEST_TYPE: {
+    int n = group_size(req, req_size, GTV_REQUEST_BASE_SIZE, &error);
+    if (n < 0) {
+      return error_response(res, error);
+    }
+
+    const char *sas_list = req + GTR_REQUEST_BASE_SIZE;
+    size_t list_size = (size_t)n * SAS_BYTE_SIZE;
+    if (!valid_sas_ascii(sas_list, n) ||
+        !valid_ascii(sas_list + list_size, TOKEN_BYTE_SIZE)) {
+      return error_response(res, ASCII_DECODE_ERROR);
+    }
+
+    int valid = 1;
+    for (int i = 0; i < n && valid; i++) {
+      valid = valid_sas(sas_list + i * SAS_BYTE_SIZE);
+    }
+
+    char token[TOKEN_BYTE_SIZE];
+    make_token(sas_list, list_size, token);
+    valid = valid && memcmp(token, sas_list + list_size, TOKEN_BYTE_SIZE) == 0;
+
+    memcpy(res, req, req_size);
+    memcpy(res, &response_type, sizeof(response_type));
+    res[req_size] = !valid;
+    return req_size + STATUS_BYTE_SIZE;
+  }
+
+  default:
+    return error_response(res, INVALID_MESSAGE_CODE);
+  }
+}
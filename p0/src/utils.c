@@ -1,8 +1,6 @@
 #include "utils.h"
 #include <stdlib.h>
-
-static LogLevel current_level = LOG_ERROR;
-static FILE *log_file = NULL;
+#include <time.h>
 
 static const char *get_level_str(LogLevel level) {
   switch (level) {
@@ -19,31 +17,57 @@ static const char *get_level_str(LogLevel level) {
   }
 }
 
-// logger setters
-void set_log_level(LogLevel level) { current_level = level; }
-void set_log_file(FILE *file) { log_file = file; }
+LogLevel current_log_level = LOG_ERROR;
+
+// stop the drain thread and write the pending events
+void log_flush(void) { log_ring_flush(); }
 
-// print the log if the current level can be shown
+// record the log if the current level can be shown
 void log_message(LogLevel level, const char *fmt, ...) {
-  if (level < current_level) {
+  // only log allowed levels
+  if (level < current_log_level) {
     return;
   }
 
-  if (!log_file) {
-    log_file = stderr;
-  }
-
   va_list args;
   va_start(args, fmt);
-  fprintf(log_file, "%s: ", get_level_str(level));
-  vfprintf(log_file, fmt, args);
+  log_ring_write(get_level_str(level), fmt, &args);
   va_end(args);
 }
 
+// logger setters
+void set_log_level(LogLevel level) { current_log_level = level; }
+void set_log_file(FILE *file) { log_ring_set_file(file); }
+
 // print the correct program usage and finish the program
 void usage(const char *program) {
-  printf("usage: %s <server IP> <server port> <command>\n", program);
+  printf("usage: %s [--cache file] <server IP> <server port> <command>\n",
+         program);
   printf("example: %s 127.0.0.1 51511 itr ifs4 1\n", program);
+  printf("bulk:    %s 127.0.0.1 51511 bulk [file]\n", program);
+  printf("group:   %s 127.0.0.1 51511 grp 2 ifs4 1 ifs4 2 [verify]\n",
+         program);
+  printf("cache:   %s --cache tokens.cache 127.0.0.1 51511 invalidate all\n",
+         program);
+  printf("racing:  %s ::1,127.0.0.1 51511 itr ifs4 1\n", program);
+  printf("daemon:  %s 127.0.0.1 51511 daemon /tmp/p0.sock\n", program);
+  printf("         %s --daemon /tmp/p0.sock itr ifs4 1\n", program);
+  exit(EXIT_FAILURE);
+}
+
+// print the stand-in server usage and finish the program
+void server_usage(const char *program) {
+  printf("usage: %s <port> [-t threads] [-k key] [-d]\n", program);
+  printf("example: %s 51511 -t 4\n", program);
+  exit(EXIT_FAILURE);
+}
+
+// print the load generator usage and finish the program
+void load_usage(const char *program) {
+  printf("usage: %s <server IP> <server port> [-r rate] [-c sockets] "
+         "[-t seconds] [-m itr:itv:gtr:gtv] [-g group size] [-d]\n",
+         program);
+  printf("example: %s 127.0.0.1 51511 -r 20000 -t 5 -m 4:4:1:1\n", program);
   exit(EXIT_FAILURE);
 }
 
@@ -52,3 +76,17 @@ void log_exit(const char *msg) {
   fprintf(stderr, "%s\n", msg);
   exit(EXIT_FAILURE);
 }
+
+// milliseconds elapsed on the monotonic clock
+uint64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// microseconds elapsed on the monotonic clock
+uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
@@ -0,0 +1,87 @@
+#include "validate.h"
+#include "defs.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// local checks of ids and tokens, so malformed ones never reach the server
+// sse2 checks 16 chars at a time, the remaining ones go through the scalar path
+
+static int printable_char(unsigned char c) { return c >= 0x20 && c <= 0x7e; }
+
+static int hex_char(unsigned char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+         (c >= 'A' && c <= 'F');
+}
+
+// check if every char is printable ascii
+int valid_id(const char *id, size_t len) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  // as signed bytes, chars above 0x7e are negative or 0x7f
+  const __m128i low = _mm_set1_epi8(0x1f);
+  const __m128i high = _mm_set1_epi8(0x7f);
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(id + i));
+    __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, low), _mm_cmplt_epi8(v, high));
+    if (_mm_movemask_epi8(ok) != 0xffff) {
+      return 0;
+    }
+  }
+#endif
+
+  for (; i < len; i++) {
+    if (!printable_char(id[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+#ifdef __SSE2__
+// check if the chars are in [lo, hi], signed compare
+static __m128i in_range(__m128i v, char lo, char hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                       _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+#endif
+
+// check if every char is an hex digit
+int valid_token(const char *token, size_t len) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  // letters are compared in lower case
+  const __m128i lower = _mm_set1_epi8(0x20);
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(token + i));
+    __m128i ok = _mm_or_si128(in_range(v, '0', '9'),
+                              in_range(_mm_or_si128(v, lower), 'a', 'f'));
+    if (_mm_movemask_epi8(ok) != 0xffff) {
+      return 0;
+    }
+  }
+#endif
+
+  for (; i < len; i++) {
+    if (!hex_char(token[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// check the id and token of a SAS in its wire format, the nonce is binary
+// returns the reason it is malformed or NULL
+const char *wire_sas_error(const char *wire_sas) {
+  if (!valid_id(wire_sas, ID_BYTE_SIZE)) {
+    return "Invalid id";
+  }
+  if (!valid_token(wire_sas + ID_BYTE_SIZE + NONCE_BYTE_SIZE,
+                   TOKEN_BYTE_SIZE)) {
+    return "Invalid token";
+  }
+  return NULL;
+}
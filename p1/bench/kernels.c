@@ -0,0 +1,94 @@
+// file:        kernels.c
+// description: microbenchmarks of the frame and hash kernels
+#include "bench.h"
+#include "defs.h"
+#include "messages.h"
+#include "network.h"
+#include <stdlib.h>
+#include <string.h>
+
+// frame data sizes, empty ack, short line, reference and negotiated frames
+static const size_t data_sizes[] = {0, 100, MAX_DATA_BYTES, MAX_PAYLOAD_BYTES};
+
+// md5 input sizes
+static const size_t md5_sizes[] = {32, MAX_DATA_BYTES, 64 * 1024};
+
+typedef struct {
+  Frame frame;
+  char data[MAX_PAYLOAD_BYTES];
+  size_t size;
+  char *str;
+} KernelCtx;
+
+static void fill_data(char *data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    data[i] = 'a' + i % 26;
+  }
+}
+
+static void bench_checksum(void *arg, uint64_t iters) {
+  KernelCtx *ctx = (KernelCtx *)arg;
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < iters; i++) {
+    sum += get_checksum(&ctx->frame, FRAME_HEADER_BYTES + ctx->size);
+  }
+  bench_sink(sum);
+}
+
+static void bench_make_frame(void *arg, uint64_t iters) {
+  KernelCtx *ctx = (KernelCtx *)arg;
+  for (uint64_t i = 0; i < iters; i++) {
+    make_frame(&ctx->frame, i & 1, NO_FLAGS, ctx->data, ctx->size, 0);
+  }
+  bench_sink(ctx->frame.checksum);
+}
+
+static void bench_check_frame(void *arg, uint64_t iters) {
+  KernelCtx *ctx = (KernelCtx *)arg;
+  uint64_t invalid = 0;
+  for (uint64_t i = 0; i < iters; i++) {
+    invalid += check_valid_frame(&ctx->frame) != 0;
+  }
+  bench_sink(invalid);
+}
+
+static void bench_md5(void *arg, uint64_t iters) {
+  KernelCtx *ctx = (KernelCtx *)arg;
+  for (uint64_t i = 0; i < iters; i++) {
+    char *hash = get_md5_str(ctx->str);
+    bench_sink(hash[0]);
+    free(hash);
+  }
+}
+
+int main(int argc, char **argv) {
+  bench_init("p1", argc, argv);
+
+  static KernelCtx ctx;
+  for (size_t i = 0; i < sizeof(data_sizes) / sizeof(data_sizes[0]); i++) {
+    ctx.size = data_sizes[i];
+    memset(&ctx.frame, 0, sizeof(ctx.frame));
+    fill_data(ctx.data, ctx.size);
+    make_frame(&ctx.frame, 0, NO_FLAGS, ctx.data, ctx.size, 0);
+
+    size_t frame_size = FRAME_HEADER_BYTES + ctx.size;
+    run_bench("get_checksum", ctx.size, frame_size, bench_checksum, &ctx);
+    run_bench("make_frame", ctx.size, frame_size, bench_make_frame, &ctx);
+
+    // the frame is rebuilt, make_frame leaves the last id behind
+    memset(&ctx.frame, 0, sizeof(ctx.frame));
+    make_frame(&ctx.frame, 0, NO_FLAGS, ctx.data, ctx.size, 0);
+    run_bench("check_valid_frame", ctx.size, frame_size, bench_check_frame,
+              &ctx);
+  }
+
+  for (size_t i = 0; i < sizeof(md5_sizes) / sizeof(md5_sizes[0]); i++) {
+    ctx.str = malloc(md5_sizes[i] + 1);
+    fill_data(ctx.str, md5_sizes[i]);
+    ctx.str[md5_sizes[i]] = '\0';
+    run_bench("get_md5_str", md5_sizes[i], md5_sizes[i], bench_md5, &ctx);
+    free(ctx.str);
+  }
+
+  return 0;
+}
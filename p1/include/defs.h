@@ -10,6 +10,9 @@
 #define SYNC_BYTES 0xDCC023C2
 #define FRAME_HEADER_BYTES 15
 #define MAX_DATA_BYTES 1000
+
+// largest data size two peers can agree on, the limit of the lenght field
+#define MAX_PAYLOAD_BYTES 65535
 #define END_CHAR_BYTE 1
 
 // frame flags
@@ -18,11 +21,30 @@
 #define RESET_FLAG 0x20
 #define NO_FLAGS 0x00
 
+// capability frame, the data is the largest payload a peer takes as a
+// 16 bit integer, the answer also has the ack flag
+#define CAPS_FLAG 0x10
+
+// a data frame with the ack flag also acks the peer frame of id 0 or 1,
+// the acked id is carried in the lowest flag bit
+#define ACK_ID_FLAG 0x01
+
 // transmission parameters
 #define MAX_ATTEMPTS 16
 #define SEND_TIMEOUT 3
 #define RECV_TIMEOUT 3
 
+// time an ack waits for a data frame to carry it, in ms
+#define ACK_DELAY_MS 5
+
+// capability proposals before the reference payload is kept
+#define CAPS_ATTEMPTS 2
+
+// receive frame errors
+#define FRAME_NOT_RECEIVED -1
+#define FRAME_INVALID -2
+#define FRAME_BAD_CHECKSUM -3
+
 #pragma pack(1)
 
 // packet frame
@@ -33,7 +55,7 @@ typedef struct {
   uint16_t lenght;
   uint16_t id;
   uint8_t flags;
-  char data[MAX_DATA_BYTES];
+  char data[MAX_PAYLOAD_BYTES];
 } Frame;
 
 #pragma pack(0)
@@ -3,6 +3,7 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include "log-ring.h"
 #include <stdarg.h>
 #include <stdio.h>
 
@@ -15,7 +16,20 @@ typedef enum {
   LOG_DISABLED,
 } LogLevel;
 
-#define LOG_MSG(level, fmt, ...) log_message(level, fmt, ##__VA_ARGS__)
+// levels below the threshold are compiled out, e.g. make LOG_MIN_LEVEL=LOG_ERROR
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_DEBUG
+#endif
+
+extern LogLevel current_log_level;
+
+// the format must be a string literal, it is read after the call returns
+#define LOG_MSG(level, fmt, ...)                                               \
+  do {                                                                         \
+    if ((level) >= LOG_MIN_LEVEL && (level) >= current_log_level) {            \
+      log_message(level, fmt, ##__VA_ARGS__);                                  \
+    }                                                                          \
+  } while (0)
 
 void log_exit(const char *msg);
 void usage_md5(const char *program);
@@ -23,5 +37,6 @@ void usage_xfer(const char *program);
 void set_log_level(LogLevel level);
 void set_log_file(FILE *file);
 void log_message(LogLevel level, const char *fmt, ...);
+void log_flush(void);
 
 #endif
@@ -10,6 +10,7 @@
 // function definitions
 void make_frame(Frame *f, uint16_t id, uint8_t flags, const char *data,
                 size_t data_size, int end_char);
+int check_valid_frame(Frame *f);
 int send_frame(int fd, Frame *f, size_t f_size);
 int receive_frame(int fd, Frame *f, size_t f_size);
 
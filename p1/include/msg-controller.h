@@ -4,8 +4,11 @@
 #define MSG_CONTROLLER_H
 
 #include "defs.h"
+#include "stats.h"
+#include "window.h"
 #include <pthread.h>
 #include <stdlib.h>
+#include <time.h>
 
 // dccnet messages controller
 typedef struct {
@@ -13,21 +16,36 @@ typedef struct {
   uint16_t current_id;
   uint16_t last_sent_id;
   uint16_t last_received_id;
-  char last_received_data[MAX_DATA_BYTES];
+  char last_received_data[MAX_PAYLOAD_BYTES + 1];
   size_t last_size_received;
   int received_end;
   int sent_end;
   int new_data_available;
+  size_t max_payload;
+  size_t payload;
+  int delayed_acks;
+  int hold_acks;
+  int ack_pending;
+  uint16_t pending_ack_id;
+  struct timespec ack_deadline;
+  int session_done;
   pthread_mutex_t mc_mutex;
+  pthread_mutex_t tx_mutex;
   pthread_cond_t mc_ack_cond;
   pthread_cond_t mc_data_cond;
+  pthread_cond_t mc_consumed_cond;
+  pthread_cond_t mc_ack_timer_cond;
+  SessionStats *stats;
+  Window window;
 } MsgController;
 
-// global controller
+// global controller and the counters of its sessions
 extern MsgController msg_controller;
+extern SessionStats session_stats;
 
 // message contoller functions
-void init_msg_controller(MsgController *mc);
+void init_msg_controller(MsgController *mc, SessionStats *stats);
+void init_session_controller(MsgController *mc, const MsgController *options);
 void set_last_received_data(MsgController *mc, const char *data,
                             size_t data_size);
 void clean_msg_controller(MsgController *mc);
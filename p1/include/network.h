@@ -12,5 +12,6 @@ int parse_addr(const char *addr_str, const char *port_str,
                struct sockaddr_storage *storage);
 uint16_t get_checksum(void *frame, size_t frame_size);
 char *get_md5_str(const char *data);
+char *get_file_md5_str(int fd);
 
 #endif
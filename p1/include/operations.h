@@ -3,7 +3,10 @@
 #ifndef OPERATIONS_H
 #define OPERATIONS_H
 
+#include "msg-controller.h"
+#include "stripe.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 // thread arguments
 typedef struct {
@@ -12,12 +15,19 @@ typedef struct {
   FILE *output;
   char *gas;
   size_t gas_size;
+  MsgController *mc;
+  Stripe *stripe;
 } ThreadArgs;
 
+// capability handshake, returns the agreed payload size
+size_t client_caps(MsgController *mc, int fd, size_t max_payload);
+size_t server_caps(MsgController *mc, int fd, size_t max_payload);
+
 // thread functions
 void *send_md5_thread(void *arg);
 void *send_xfer_thread(void *arg);
 void *receive_thread(void *arg);
+void *ack_timer_thread(void *arg);
 void *ack_xfer_thread(void *arg);
 void *print_thread(void *arg);
 
@@ -14,6 +14,11 @@ typedef struct {
   int client_side;
   int server_side;
   char *ip_version;
+  char *stats_file;
+  int delayed_acks;
+  int window;
+  int max_payload;
+  int stripes;
 } Params;
 
 // parse the command line arguments
@@ -11,5 +11,8 @@ int init_and_connect_client(const char *addr_str, const char *port_str);
 void server_actions(int fd, FILE *input, FILE *output);
 void client_md5_actions(int fd, const char *gas, size_t gas_size, FILE *output);
 void client_xfer_actions(int fd, FILE *input, FILE *output);
+int server_stripe_actions(int fd, FILE *input, FILE *output, int stripes);
+int client_stripe_actions(const char *addr_str, const char *port_str,
+                          FILE *input, FILE *output, int stripes);
 
 #endif
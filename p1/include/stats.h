@@ -0,0 +1,56 @@
+// file:        stats.h
+// description: definitions for the per session telemetry counters
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// ack latency histogram, bucket i counts latencies below 2^i us
+#define LATENCY_BUCKETS 24
+
+// stats file period in seconds
+#define STATS_PERIOD 1
+
+// session counters, updated by the session threads without locks
+typedef struct {
+  uint64_t start_us;
+  _Atomic uint64_t frames_sent;
+  _Atomic uint64_t frames_received;
+  _Atomic uint64_t data_frames_sent;
+  _Atomic uint64_t data_frames_received;
+  _Atomic uint64_t acks_sent;
+  _Atomic uint64_t acks_received;
+  _Atomic uint64_t acks_piggybacked;
+  _Atomic uint64_t acks_delayed;
+  _Atomic uint64_t retransmissions;
+  _Atomic uint64_t fast_retransmissions;
+  _Atomic uint64_t ack_timeouts;
+  _Atomic uint64_t duplicate_frames;
+  _Atomic uint64_t out_of_order_frames;
+  _Atomic uint64_t checksum_failures;
+  _Atomic uint64_t invalid_frames;
+  _Atomic uint64_t send_failures;
+  _Atomic uint64_t receive_timeouts;
+  _Atomic uint64_t bytes_sent;
+  _Atomic uint64_t bytes_received;
+  _Atomic uint64_t ack_latency[LATENCY_BUCKETS];
+  _Atomic uint64_t ack_latency_sum_us;
+  _Atomic uint64_t ack_latency_max_us;
+} SessionStats;
+
+// counters updates
+#define STAT_ADD(s, counter, n)                                                \
+  atomic_fetch_add_explicit(&(s)->counter, (n), memory_order_relaxed)
+#define STAT_INC(s, counter) STAT_ADD(s, counter, 1)
+
+void init_stats(SessionStats *s);
+uint64_t stats_now_us(void);
+void stats_ack_latency(SessionStats *s, uint64_t latency_us);
+void write_stats_json(SessionStats *s, FILE *out);
+void start_stats_export(SessionStats *s, const char *path);
+SessionStats *alloc_session_stats(int count);
+void stop_stats_export(void);
+
+#endif
@@ -0,0 +1,53 @@
+// file:        stripe.h
+// description: definitions for the striped transfer, the input is split in
+// offset tagged chunks sent over parallel sessions
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// max parallel sessions
+#define MAX_STRIPES 16
+
+// offset before the data of every chunk
+#define STRIPE_HEADER_BYTES 8
+
+// offset tag of the manifest chunk
+#define MANIFEST_OFFSET UINT64_MAX
+
+// md5 hash as hexa string
+#define MD5_STR_BYTES 32
+
+// manifest chunk, the tag, the file size and its md5 hash
+#define MANIFEST_BYTES (STRIPE_HEADER_BYTES + 8 + MD5_STR_BYTES)
+
+// smallest payload that fits the manifest and some data
+#define STRIPE_MIN_PAYLOAD 64
+
+// a striped transfer shared by its sessions
+typedef struct {
+  int in_fd;
+  uint64_t in_size;
+  char in_md5[MD5_STR_BYTES + 1];
+  atomic_int manifest_taken;
+  _Atomic uint64_t next_offset;
+  int out_fd;
+  pthread_mutex_t mutex;
+  int have_manifest;
+  uint64_t out_size;
+  char out_md5[MD5_STR_BYTES + 1];
+  _Atomic uint64_t bytes_written;
+} Stripe;
+
+// stripe functions
+int init_stripe(Stripe *st, FILE *input, FILE *output);
+size_t next_stripe_chunk(Stripe *st, char *buf, size_t buf_size);
+int write_stripe_chunk(Stripe *st, const char *chunk, size_t chunk_size);
+int check_stripe(Stripe *st);
+void clean_stripe(Stripe *st);
+
+#endif
@@ -0,0 +1,73 @@
+// file:        window.h
+// description: definitions for the selective repeat window, the sender
+// keeps several frames in flight and the receiver reorders them
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include "defs.h"
+#include "stats.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// max frames in flight
+#define MAX_WINDOW 64
+
+// sack bitmap bytes, bit i reports the frame cumulative id + 1 + i
+#define SACK_BYTES (MAX_WINDOW / 8)
+
+// later frames acked before a missing one is resent without a timeout
+#define DUP_THRESH 3
+
+// time a frame waits for its ack before it's resent, in ms
+#define RETRANSMIT_MS 1000
+
+// a sent frame waiting for its ack, the frame buffer only has room for
+// the window capacity
+typedef struct {
+  Frame *frame;
+  size_t size;
+  int acked;
+  int attempts;
+  int fast_resent;
+  uint64_t sent_us;
+  uint64_t deadline_us;
+} TxSlot;
+
+// a received frame waiting for the frames before it
+typedef struct {
+  char *data;
+  size_t size;
+  uint8_t flags;
+  int present;
+} RxSlot;
+
+// sender and receiver windows of a session, ids grow by one and wrap
+// the slots are a power of two, so the ids map to the same slot on wrap
+typedef struct {
+  uint16_t size;
+  uint16_t slots;
+  size_t capacity;
+  uint16_t tx_base;
+  uint16_t tx_next;
+  int tx_end_queued;
+  TxSlot tx[MAX_WINDOW];
+  uint16_t rx_next;
+  RxSlot rx[MAX_WINDOW];
+} Window;
+
+// window functions, the caller keeps the window locked
+void init_window(Window *w, uint16_t size, size_t capacity);
+void free_window(Window *w);
+int window_full(const Window *w);
+TxSlot *window_push(Window *w, uint8_t flags, const char *data,
+                    size_t data_size);
+TxSlot *window_tx_slot(Window *w, uint16_t id);
+int window_sack(Window *w, uint16_t cum_id, const uint8_t *bitmap,
+                size_t bitmap_size, SessionStats *stats);
+int window_store(Window *w, uint16_t id, uint8_t flags, const char *data,
+                 size_t data_size);
+RxSlot *window_next_in_order(Window *w);
+void window_release(Window *w);
+size_t make_sack(const Window *w, uint8_t *bitmap);
+
+#endif
@@ -29,7 +29,9 @@ int main(int argc, char **argv) {
   }
 
   // init messages controller
-  init_msg_controller(&msg_controller);
+  init_stats(&session_stats);
+  init_msg_controller(&msg_controller, &session_stats);
+  start_stats_export(&session_stats, p.stats_file);
 
   // check gas
   size_t gas_size = strlen(p.gas);
@@ -42,6 +44,7 @@ int main(int argc, char **argv) {
   client_md5_actions(sock_fd, p.gas, gas_size, output_file);
 
   // finish procedures
+  stop_stats_export();
   clean_msg_controller(&msg_controller);
   close(sock_fd);
   fclose(output_file);
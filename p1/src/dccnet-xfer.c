@@ -4,6 +4,7 @@
 #include "server-client.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 int main(int argc, char **argv) {
@@ -16,7 +17,16 @@ int main(int argc, char **argv) {
   }
 
   // init global controller
-  init_msg_controller(&msg_controller);
+  init_stats(&session_stats);
+  init_msg_controller(&msg_controller, &session_stats);
+  msg_controller.delayed_acks = p.delayed_acks;
+  msg_controller.max_payload = p.max_payload;
+
+  // the window takes the largest frames this side accepts, the agreed
+  // payload is at most that
+  size_t capacity = p.max_payload > 0 ? (size_t)p.max_payload : MAX_DATA_BYTES;
+  init_window(&msg_controller.window, p.window, capacity);
+  start_stats_export(&session_stats, p.stats_file);
   printf("%s\n", p.input_file);
   // input file
   FILE *input_file = fopen(p.input_file, "r");
@@ -24,25 +34,42 @@ int main(int argc, char **argv) {
     log_exit("input file failure");
   }
 
-  // output file
-  FILE *output_file = fopen(p.output_file, "w");
+  // the striped manifest takes the input size from the file
+  struct stat input_stat;
+  if (p.stripes > 0 && (fstat(fileno(input_file), &input_stat) != 0 ||
+                        !S_ISREG(input_stat.st_mode))) {
+    log_exit("-k needs a regular input file, not a pipe or a terminal");
+  }
+
+  // output file, read back for the striped check
+  FILE *output_file = fopen(p.output_file, p.stripes > 0 ? "w+" : "w");
   if (output_file == NULL) {
     log_exit("output file failure");
   }
 
   // program socket
-  int sock_fd;
+  int sock_fd = -1;
+  int ret = 0;
 
   // server program
   if (p.server_side > 0) {
     sock_fd = init_server(p.ip_version, p.port);
-    server_actions(sock_fd, input_file, output_file);
+    if (p.stripes > 0) {
+      ret = server_stripe_actions(sock_fd, input_file, output_file, p.stripes);
+    } else {
+      server_actions(sock_fd, input_file, output_file);
+    }
   }
 
-  // client program
+  // client program, striped sessions connect by themselves
   else if (p.client_side > 0) {
-    sock_fd = init_and_connect_client(p.addr, p.port);
-    client_xfer_actions(sock_fd, input_file, output_file);
+    if (p.stripes > 0) {
+      ret = client_stripe_actions(p.addr, p.port, input_file, output_file,
+                                  p.stripes);
+    } else {
+      sock_fd = init_and_connect_client(p.addr, p.port);
+      client_xfer_actions(sock_fd, input_file, output_file);
+    }
 
     // parameters dinamicaly allocated
     free(p.addr);
@@ -50,9 +77,12 @@ int main(int argc, char **argv) {
   }
 
   // destroy mutex and cond
+  stop_stats_export();
   clean_msg_controller(&msg_controller);
   fclose(input_file);
   fclose(output_file);
-  close(sock_fd);
-  return 0;
+  if (sock_fd >= 0) {
+    close(sock_fd);
+  }
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
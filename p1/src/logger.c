@@ -1,9 +1,6 @@
 #include "logger.h"
 #include <stdlib.h>
 
-static LogLevel current_level = LOG_DISABLED;
-static FILE *log_file = NULL;
-
 // convert a log level to a string
 static const char *get_level_str(LogLevel level) {
   switch (level) {
@@ -20,41 +17,50 @@ static const char *get_level_str(LogLevel level) {
   }
 }
 
-// logger setters
-void set_log_level(LogLevel level) { current_level = level; }
-void set_log_file(FILE *file) { log_file = file; }
+LogLevel current_log_level = LOG_DISABLED;
 
-// print the log if the current level can be shown
+// stop the drain thread and write the pending events
+void log_flush(void) { log_ring_flush(); }
+
+// record the log if the current level can be shown
 void log_message(LogLevel level, const char *fmt, ...) {
   // only log allowed levels
-  if (level < current_level) {
+  if (level < current_log_level) {
     return;
   }
 
-  // default log file
-  if (log_file == NULL) {
-    log_file = stderr;
-  }
-
-  // print formated string
   va_list args;
   va_start(args, fmt);
-  fprintf(log_file, "%s: ", get_level_str(level));
-  vfprintf(log_file, fmt, args);
-  fprintf(log_file, "\n");
+  log_ring_write(get_level_str(level), fmt, &args);
   va_end(args);
 }
 
+// logger setters
+void set_log_level(LogLevel level) { current_log_level = level; }
+void set_log_file(FILE *file) { log_ring_set_file(file); }
+
 // print the correct md5 program usage and finish program
 void usage_md5(const char *program) {
-  printf("usage: %s <IP>:<PORT> <GAS>\n", program);
+  printf("usage: %s <IP>:<PORT> <GAS> [OUTPUT [-d] [-S <STATS>]]\n", program);
   exit(EXIT_FAILURE);
 }
 
 // print the correct xfer program usage and finish program
 void usage_xfer(const char *program) {
-  printf("usage 1: %s -s <PORT> <INPUT> <OUTPUT>\n", program);
-  printf("usage 2: %s -c <IP>:<PORT> <INPUT> <OUTPUT>\n", program);
+  printf("usage 1: %s -s <PORT> <INPUT> <OUTPUT> [v4|v6] [-d] [-S <STATS>] "
+         "[-a | -w <WINDOW>] [-x <PAYLOAD>] [-k <SESSIONS>]\n",
+         program);
+  printf("usage 2: %s -c <IP>:<PORT> <INPUT> <OUTPUT> [-d] [-S <STATS>] "
+         "[-a | -w <WINDOW>] [-x <PAYLOAD>] [-k <SESSIONS>]\n",
+         program);
+  printf("SIGUSR1 prints the session stats, -S writes them to a file\n");
+  printf("-a piggybacks and delays acks, both sides must use it\n");
+  printf("-w keeps up to 64 frames in flight with selective acks, both sides "
+         "must use it\n");
+  printf("-x proposes frames of up to 65535 data bytes, 1000 is kept with a "
+         "peer that doesn't agree\n");
+  printf("-k stripes the files over up to 16 sessions and checks them, both "
+         "sides must use it\n");
   exit(EXIT_FAILURE);
 }
 
@@ -51,7 +51,8 @@ void make_frame(Frame *f, uint16_t id, uint8_t flags, const char *data,
 }
 
 // check if a frame is valid
-static int check_valid_frame(Frame *f) {
+// returns 0 or the FRAME_* error
+int check_valid_frame(Frame *f) {
   // frame variables to little-endian
   uint32_t _sync1 = ntohl(f->SYNC1);
   uint32_t _sync2 = ntohl(f->SYNC2);
@@ -65,41 +66,18 @@ static int check_valid_frame(Frame *f) {
   if (_sync1 != SYNC_BYTES || _sync2 != SYNC_BYTES) {
     LOG_MSG(LOG_ERROR, "check_valid_frame(id = %hd): invalid sync bytes %x %x",
             _id, _sync1, _sync2);
-    return -1;
+    return FRAME_INVALID;
   }
 
-  // check length
-  if (_lenght > MAX_DATA_BYTES) {
-    LOG_MSG(LOG_ERROR, "check_valid_frame(id = %hd): invalid data size", _id);
-    return -1;
-  }
-
-  // make a temp frame to compare checksum
-  Frame temp;
-
-  if (_lenght > 0) {
-    char *data = malloc(_lenght + 1);
-    data = strdup(f->data);
-    data[_lenght] = '\0';
-
-    if (data[_lenght - 1] == '\n') {
-      data[_lenght - 1] = '\0';
-      make_frame(&temp, _id, f->flags, data, _lenght - 1, 1);
-    } else {
-      make_frame(&temp, _id, f->flags, data, _lenght, 0);
-    }
-
-    free(data);
-  } else {
-    make_frame(&temp, _id, f->flags, NULL, 0, 0);
-  }
-
-  uint16_t tmp_checksum = ntohs(temp.checksum);
+  // the checksum is computed in place with its own field zeroed
+  f->checksum = 0;
+  uint16_t tmp_checksum = get_checksum(f, FRAME_HEADER_BYTES + _lenght);
+  f->checksum = htons(_checksum);
   if (_checksum != tmp_checksum) {
     LOG_MSG(LOG_ERROR,
             "check_valid_frame(id = %hd): invalid checksum %hd != %hd", _id,
             _checksum, tmp_checksum);
-    return -1;
+    return FRAME_BAD_CHECKSUM;
   }
 
   // valid frame
@@ -135,7 +113,8 @@ int send_frame(int fd, Frame *f, size_t f_size) {
 
     // socket ready
     if (FD_ISSET(fd, &writefds)) {
-      bytes_count = send(fd, f + bytes_sent, f_size - bytes_sent, 0);
+      bytes_count =
+          send(fd, (char *)f + bytes_sent, f_size - bytes_sent, 0);
       if (bytes_count <= 0) {
         LOG_MSG(LOG_ERROR, "send_frame(id = %hd): no bytes sent", _id);
         return -1;
@@ -151,53 +130,86 @@ int send_frame(int fd, Frame *f, size_t f_size) {
   return 0;
 }
 
-// receive bytes and check if its a frame
-int receive_frame(int fd, Frame *f, size_t f_size) {
-  // frame variables to little endian
-  uint16_t _id = ntohs(f->id);
-
-  LOG_MSG(LOG_INFO, "receive_frame(id = %hd): start", _id);
-  // set bytes
-  memset(f, 0, f_size);
-
-  // set socket and timeout for select
-  fd_set readfds;
-  FD_ZERO(&readfds);
-  FD_SET(fd, &readfds);
-  struct timeval timeout;
-  timeout.tv_sec = RECV_TIMEOUT;
-  timeout.tv_usec = 0;
-
-  int retval = select(fd + 1, &readfds, NULL, NULL, &timeout);
-  // socket not ready
-  if (retval <= 0) {
-    LOG_MSG(LOG_ERROR, "receive_frame(id = %hd): socket not ready to receive",
-            _id);
-    return -1;
-  }
+// read exactly size bytes, waiting up to the timeout for each part
+// returns 0 or FRAME_NOT_RECEIVED
+static int receive_bytes(int fd, char *buf, size_t size) {
+  size_t bytes_received = 0;
+
+  // bytes are possibly received partially
+  while (bytes_received < size) {
+    // set socket and timeout for select
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(fd, &readfds);
+    struct timeval timeout;
+    timeout.tv_sec = RECV_TIMEOUT;
+    timeout.tv_usec = 0;
 
-  // socket ready
-  if (FD_ISSET(fd, &readfds)) {
-    ssize_t bytes_count = recv(fd, f, f_size, 0);
+    // socket not ready
+    if (select(fd + 1, &readfds, NULL, NULL, &timeout) <= 0) {
+      return FRAME_NOT_RECEIVED;
+    }
 
-    // no bytes received
+    // no bytes received, the connection is closed or failed
+    ssize_t bytes_count =
+        recv(fd, buf + bytes_received, size - bytes_received, 0);
     if (bytes_count <= 0) {
-      LOG_MSG(LOG_ERROR, "receive_frame(id = %hd): no bytes received", _id);
-      return -1;
+      return FRAME_NOT_RECEIVED;
     }
+    bytes_received += bytes_count;
+  }
 
-    // invalid frame
-    if (check_valid_frame(f) != 0) {
-      LOG_MSG(LOG_ERROR, "receive_frame(id = %hd): received invalid frame",
-              _id);
-      return -1;
+  return 0;
+}
+
+// receive one frame from the stream and check if its valid
+// the header is read first and the data size is taken from it, so
+// frames sent back to back are not merged in a single receipt
+// returns 0 or the FRAME_* error
+int receive_frame(int fd, Frame *f, size_t f_size) {
+  LOG_MSG(LOG_INFO, "receive_frame(): start");
+
+  // read the header
+  char *buf = (char *)f;
+  if (receive_bytes(fd, buf, FRAME_HEADER_BYTES) != 0) {
+    LOG_MSG(LOG_ERROR, "receive_frame(): no header received");
+    return FRAME_NOT_RECEIVED;
+  }
+
+  // after a corrupted frame, slide byte by byte until the sync bytes
+  if (ntohl(f->SYNC1) != SYNC_BYTES || ntohl(f->SYNC2) != SYNC_BYTES) {
+    LOG_MSG(LOG_WARNING, "receive_frame(): lost sync, searching sync bytes");
+    while (ntohl(f->SYNC1) != SYNC_BYTES || ntohl(f->SYNC2) != SYNC_BYTES) {
+      memmove(buf, buf + 1, FRAME_HEADER_BYTES - 1);
+      if (receive_bytes(fd, buf + FRAME_HEADER_BYTES - 1, 1) != 0) {
+        LOG_MSG(LOG_ERROR, "receive_frame(): sync bytes not found");
+        return FRAME_NOT_RECEIVED;
+      }
     }
+  }
+
+  // the data size must fit the frame
+  size_t data_size = ntohs(f->lenght);
+  if (FRAME_HEADER_BYTES + data_size > f_size) {
+    LOG_MSG(LOG_ERROR, "receive_frame(): invalid data size %ld", data_size);
+    return FRAME_INVALID;
+  }
 
-    // received valid frame
-    LOG_MSG(LOG_INFO, "receive_frame(id = %hd): complete", _id);
-    return 0;
+  // read the data
+  if (receive_bytes(fd, f->data, data_size) != 0) {
+    LOG_MSG(LOG_ERROR, "receive_frame(): incomplete data received");
+    return FRAME_NOT_RECEIVED;
   }
 
-  // receipt failure
-  return -1;
+  // invalid frame
+  uint16_t _id = ntohs(f->id);
+  int invalid = check_valid_frame(f);
+  if (invalid != 0) {
+    LOG_MSG(LOG_ERROR, "receive_frame(id = %hd): received invalid frame", _id);
+    return invalid;
+  }
+
+  // received valid frame
+  LOG_MSG(LOG_INFO, "receive_frame(id = %hd): complete", _id);
+  return 0;
 }
@@ -3,33 +3,60 @@
 #include <string.h>
 
 MsgController msg_controller;
+SessionStats session_stats;
 
-// init all global variables
-void init_msg_controller(MsgController *mc) {
+// init all global variables, the counters can be shared by several
+// controllers
+void init_msg_controller(MsgController *mc, SessionStats *stats) {
   mc->waiting_ack = 0;
   mc->current_id = 0;
   mc->last_sent_id = -1;
   mc->last_received_id = -1;
-  memset(mc->last_received_data, 0, MAX_DATA_BYTES);
+  memset(mc->last_received_data, 0, sizeof(mc->last_received_data));
   mc->received_end = 0;
   mc->sent_end = 0;
   mc->new_data_available = 0;
   mc->last_size_received = 0;
+  mc->max_payload = 0;
+  mc->payload = MAX_DATA_BYTES;
+  mc->delayed_acks = 0;
+  mc->hold_acks = 0;
+  mc->ack_pending = 0;
+  mc->pending_ack_id = 0;
+  mc->session_done = 0;
   pthread_mutex_init(&mc->mc_mutex, NULL);
+  pthread_mutex_init(&mc->tx_mutex, NULL);
   pthread_cond_init(&mc->mc_ack_cond, NULL);
   pthread_cond_init(&mc->mc_data_cond, NULL);
+  pthread_cond_init(&mc->mc_consumed_cond, NULL);
+  pthread_cond_init(&mc->mc_ack_timer_cond, NULL);
+  mc->stats = stats;
+  init_window(&mc->window, 0, 0);
+}
+
+// init the controller of a new session with the options of another
+void init_session_controller(MsgController *mc, const MsgController *options) {
+  init_msg_controller(mc, options->stats);
+  mc->max_payload = options->max_payload;
+  mc->delayed_acks = options->delayed_acks;
+  mc->hold_acks = options->hold_acks;
+  init_window(&mc->window, options->window.size, options->window.capacity);
 }
 
 // copy data to the last received data global variable
 void set_last_received_data(MsgController *mc, const char *data,
                             size_t data_size) {
-  memset(mc->last_received_data, 0, MAX_DATA_BYTES);
   memcpy(mc->last_received_data, data, data_size);
+  mc->last_received_data[data_size] = '\0';
 }
 
 // destroy mutex and conditions
 void clean_msg_controller(MsgController *mc) {
   pthread_mutex_destroy(&mc->mc_mutex);
+  pthread_mutex_destroy(&mc->tx_mutex);
   pthread_cond_destroy(&mc->mc_ack_cond);
   pthread_cond_destroy(&mc->mc_data_cond);
+  pthread_cond_destroy(&mc->mc_consumed_cond);
+  pthread_cond_destroy(&mc->mc_ack_timer_cond);
+  free_window(&mc->window);
 }
@@ -4,6 +4,7 @@
 #include <openssl/evp.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 // init a server address with port
 // protocol can be v6 or v4
@@ -115,6 +116,25 @@ uint16_t get_checksum(void *frame, size_t frame_size) {
   return (~sum) & 0xFFFF;
 }
 
+// convert a digest to its hexa string
+static char *md5_hex(const unsigned char *digest, unsigned int digest_len) {
+  // Each digest byte will become a 2 char hexa
+  // 1 extra byte needed to \0
+  unsigned int hash_len = 2 * digest_len;
+  char *md5_string = malloc(hash_len + 1);
+  if (!md5_string)
+    return NULL;
+
+  // iterate through digest bytes
+  for (unsigned int i = 0; i < digest_len; ++i)
+    // set each 2 str chars as hexa from digest byte
+    sprintf(&md5_string[i * 2], "%02x", digest[i]);
+
+  // last str char
+  md5_string[hash_len] = '\0';
+  return md5_string;
+}
+
 // return the md5 hash from a string
 char *get_md5_str(const char *data) {
   // get md5 digest
@@ -133,20 +153,40 @@ char *get_md5_str(const char *data) {
   }
 
   EVP_MD_CTX_free(ctx);
+  return md5_hex(digest, digest_len);
+}
 
-  // Each digest byte will become a 2 char hexa
-  // 1 extra byte needed to \0
-  unsigned int hash_len = 2 * digest_len;
-  char *md5_string = malloc(hash_len + 1);
-  if (!md5_string)
+// return the md5 hash of a whole file, read from its start
+char *get_file_md5_str(int fd) {
+  EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+  if (!ctx)
     return NULL;
 
-  // iterate through digest bytes
-  for (unsigned int i = 0; i < digest_len; ++i)
-    // set each 2 str chars as hexa from digest byte
-    sprintf(&md5_string[i * 2], "%02x", digest[i]);
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_len;
+  char buf[64 * 1024];
+  off_t offset = 0;
+  ssize_t bytes_read;
 
-  // last str char
-  md5_string[hash_len] = '\0';
-  return md5_string;
+  if (EVP_DigestInit_ex(ctx, EVP_md5(), NULL) != 1) {
+    EVP_MD_CTX_free(ctx);
+    return NULL;
+  }
+
+  // the file offset is left untouched
+  while ((bytes_read = pread(fd, buf, sizeof(buf), offset)) > 0) {
+    if (EVP_DigestUpdate(ctx, buf, bytes_read) != 1) {
+      EVP_MD_CTX_free(ctx);
+      return NULL;
+    }
+    offset += bytes_read;
+  }
+
+  if (bytes_read < 0 || EVP_DigestFinal_ex(ctx, digest, &digest_len) != 1) {
+    EVP_MD_CTX_free(ctx);
+    return NULL;
+  }
+
+  EVP_MD_CTX_free(ctx);
+  return md5_hex(digest, digest_len);
 }
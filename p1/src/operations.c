@@ -13,95 +13,246 @@
 #include <string.h>
 #include <unistd.h>
 
+// count a sent frame or the send failure
+static int count_sent(MsgController *mc, int ret) {
+  if (ret == 0) {
+    STAT_INC(mc->stats, frames_sent);
+  } else {
+    STAT_INC(mc->stats, send_failures);
+  }
+  return ret;
+}
+
+// send a frame, the threads share the socket so writes don't interleave
+static int transmit(MsgController *mc, int fd, Frame *f, size_t f_size) {
+  pthread_mutex_lock(&mc->tx_mutex);
+  int ret = count_sent(mc, send_frame(fd, f, f_size));
+  pthread_mutex_unlock(&mc->tx_mutex);
+  return ret;
+}
+
 // send an ack frame
-static int send_ack(int fd, uint16_t id) {
+static int send_ack(MsgController *mc, int fd, uint16_t id) {
   // ack frame
   Frame ack;
   make_frame(&ack, id, ACKNOWLEDGE_FLAG, NULL, 0, 0);
 
   // try to send the ack
-  return send_frame(fd, &ack, FRAME_HEADER_BYTES);
+  if (transmit(mc, fd, &ack, FRAME_HEADER_BYTES) != 0) {
+    return -1;
+  }
+  STAT_INC(mc->stats, acks_sent);
+  return 0;
 }
 
 // send an end frame
-static int send_end(int fd, uint16_t id) {
+static int send_end(MsgController *mc, int fd, uint16_t id) {
   // end frame
   Frame end;
   make_frame(&end, id, END_FLAG, NULL, 0, 0);
 
   // try to send the end
-  return send_frame(fd, &end, FRAME_HEADER_BYTES);
+  return transmit(mc, fd, &end, FRAME_HEADER_BYTES);
+}
+
+// send a caps proposal or answer with a payload size
+static int send_caps(MsgController *mc, int fd, uint8_t flags, size_t payload) {
+  Frame caps;
+  uint16_t _payload = htons(payload);
+  make_frame(&caps, 0, flags, (char *)&_payload, sizeof(_payload), 0);
+  return transmit(mc, fd, &caps, FRAME_HEADER_BYTES + sizeof(_payload));
+}
+
+// propose the largest payload this side takes and return the agreed one
+// a peer that doesn't answer, e.g. the reference server, keeps
+// MAX_DATA_BYTES, a frame it sent meanwhile is resent on its timeout
+size_t client_caps(MsgController *mc, int fd, size_t max_payload) {
+  LOG_MSG(LOG_INFO, "client_caps(): propose %ld bytes", max_payload);
+  Frame rec;
+
+  for (int attempts = 0; attempts < CAPS_ATTEMPTS; attempts++) {
+    if (send_caps(mc, fd, CAPS_FLAG, max_payload) != 0) {
+      continue;
+    }
+
+    // lost or corrupted answer, propose again
+    if (receive_frame(fd, &rec, sizeof(rec)) != 0) {
+      continue;
+    }
+
+    // any other frame comes from a peer that doesn't negotiate
+    if (rec.flags != (CAPS_FLAG | ACKNOWLEDGE_FLAG) ||
+        ntohs(rec.lenght) != sizeof(uint16_t)) {
+      break;
+    }
+
+    uint16_t _payload;
+    memcpy(&_payload, rec.data, sizeof(_payload));
+    size_t payload = ntohs(_payload);
+    if (payload > 0 && payload <= max_payload) {
+      LOG_MSG(LOG_INFO, "client_caps(): agreed %ld bytes", payload);
+      return payload;
+    }
+    break;
+  }
+
+  LOG_MSG(LOG_WARNING, "client_caps(): no caps answer, keep %d bytes",
+          MAX_DATA_BYTES);
+  return MAX_DATA_BYTES;
+}
+
+// wait for the client proposal and answer with the agreed payload
+// without a proposal MAX_DATA_BYTES is kept
+size_t server_caps(MsgController *mc, int fd, size_t max_payload) {
+  Frame rec;
+  if (receive_frame(fd, &rec, sizeof(rec)) != 0 || rec.flags != CAPS_FLAG ||
+      ntohs(rec.lenght) != sizeof(uint16_t)) {
+    LOG_MSG(LOG_WARNING, "server_caps(): no caps proposal, keep %d bytes",
+            MAX_DATA_BYTES);
+    return MAX_DATA_BYTES;
+  }
+
+  // the smaller of the two sides
+  uint16_t _payload;
+  memcpy(&_payload, rec.data, sizeof(_payload));
+  size_t payload = ntohs(_payload);
+  if (payload == 0 || payload > max_payload) {
+    payload = max_payload;
+  }
+
+  if (send_caps(mc, fd, CAPS_FLAG | ACKNOWLEDGE_FLAG, payload) != 0) {
+    LOG_MSG(LOG_ERROR, "server_caps(): failed to answer");
+  }
+  LOG_MSG(LOG_INFO, "server_caps(): agreed %ld bytes", payload);
+  return payload;
+}
+
+// take the pending ack as the flags of a data frame
+// must be called with mc_mutex locked
+static uint8_t take_pending_ack(MsgController *mc) {
+  if (mc->ack_pending == 0) {
+    return NO_FLAGS;
+  }
+  mc->ack_pending = 0;
+  STAT_INC(mc->stats, acks_piggybacked);
+  return ACKNOWLEDGE_FLAG |
+         (mc->pending_ack_id > 0 ? ACK_ID_FLAG : NO_FLAGS);
+}
+
+// check if the ack of a new data frame can wait for a data frame
+// a side waiting for its own ack acks at once, unless it holds the acks,
+// so the two sides fall into turns and every frame carries an ack
+// must be called with mc_mutex locked
+static int can_delay_ack(MsgController *mc) {
+  if (mc->delayed_acks == 0 || mc->sent_end > 0) {
+    return 0;
+  }
+  return mc->waiting_ack == 0 || mc->hold_acks > 0;
+}
+
+// check if a time is reached
+static int time_reached(const struct timespec *ts) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec > ts->tv_sec ||
+         (now.tv_sec == ts->tv_sec && now.tv_nsec >= ts->tv_nsec);
 }
 
 // send a frame and wait for the ack in a limited timeout
 // if the timeout is reached, the frame is retransmited
-static int send_data_wait_ack(int fd, char *data, size_t data_size,
-                              int end_char) {
+static int send_data_wait_ack(MsgController *mc, int fd, char *data,
+                              size_t data_size, int end_char) {
   // get current id for reference
-  pthread_mutex_lock(&msg_controller.mc_mutex);
-  uint16_t id = msg_controller.current_id;
-  pthread_mutex_unlock(&msg_controller.mc_mutex);
+  pthread_mutex_lock(&mc->mc_mutex);
+  uint16_t id = mc->current_id;
+  pthread_mutex_unlock(&mc->mc_mutex);
 
   LOG_MSG(LOG_INFO, "send_data_wait_ack(id = %hd): start", id);
 
   // Data Frame
   Frame req;
-  make_frame(&req, id, NO_FLAGS, data, data_size, end_char);
   size_t req_size = FRAME_HEADER_BYTES + data_size;
   if (end_char > 0) {
     req_size += END_CHAR_BYTE;
-    req.data[data_size + END_CHAR_BYTE] = '\0';
   }
 
+  SessionStats *stats = mc->stats;
+
   // attempts to send
   int total_attempts = 0;
   while (total_attempts < MAX_ATTEMPTS) {
     total_attempts++;
     LOG_MSG(LOG_INFO, "send_data_wait_ack(id = %hd): attempt %d", id,
             total_attempts);
+    if (total_attempts > 1) {
+      STAT_INC(stats, retransmissions);
+    }
+
+    // a pending ack goes with the first transmission only, a late
+    // retransmission could ack a newer frame with the same id
+    // the ack is expected from now, it may arrive before send returns
+    pthread_mutex_lock(&mc->mc_mutex);
+    uint8_t flags = total_attempts == 1 ? take_pending_ack(mc) : NO_FLAGS;
+    mc->waiting_ack = 1;
+    mc->last_sent_id = id;
+    pthread_mutex_unlock(&mc->mc_mutex);
+
+    make_frame(&req, id, flags, data, data_size, end_char);
+    if (end_char > 0) {
+      req.data[data_size + END_CHAR_BYTE] = '\0';
+    }
 
     // try to send, and retry if failed
-    if (send_frame(fd, &req, req_size) != 0) {
+    uint64_t sent_us = stats_now_us();
+    if (transmit(mc, fd, &req, req_size) != 0) {
       LOG_MSG(LOG_WARNING,
               "send_data_wait_ack(id = %hd): failed to send, retry...", id);
       continue;
     }
+    STAT_INC(stats, data_frames_sent);
+    STAT_ADD(stats, bytes_sent, req_size - FRAME_HEADER_BYTES);
 
     LOG_MSG(LOG_INFO,
             "send_data_wait_ack(id = %hd): data sent, waiting for ack\n%s", id,
             req.data);
 
     // wait for ack, before sending another data or retransmiting
-    pthread_mutex_lock(&msg_controller.mc_mutex);
-    msg_controller.waiting_ack = 1;
-    msg_controller.last_sent_id = id;
+    pthread_mutex_lock(&mc->mc_mutex);
 
     // set wait timeout
     struct timespec ts;
     clock_gettime(CLOCK_REALTIME, &ts);
     ts.tv_sec += 1;
     ts.tv_nsec += 0;
-    int ret = pthread_cond_timedwait(&msg_controller.mc_ack_cond,
-                                     &msg_controller.mc_mutex, &ts);
+    int ret = 0;
+    while (mc->waiting_ack > 0 && ret != ETIMEDOUT) {
+      ret = pthread_cond_timedwait(&mc->mc_ack_cond,
+                                   &mc->mc_mutex, &ts);
+    }
 
     // timeout reached
-    if (ret == ETIMEDOUT) {
+    if (mc->waiting_ack > 0) {
       LOG_MSG(LOG_WARNING,
               "send_data_wait_ack(id = %hd): wait ack timeout, retransmit...",
               id);
-      pthread_mutex_unlock(&msg_controller.mc_mutex);
+      pthread_mutex_unlock(&mc->mc_mutex);
+      STAT_INC(stats, ack_timeouts);
       continue;
     }
 
     // received ack, no need to retransmit
-    if (msg_controller.waiting_ack == 0) {
+    if (mc->waiting_ack == 0) {
+      // the ack of a retransmitted frame can't be matched to one send
+      if (total_attempts == 1) {
+        stats_ack_latency(stats, stats_now_us() - sent_us);
+      }
       LOG_MSG(LOG_INFO,
               "send_data_wait_ack(id = %hd): complete due ack received", id);
-      pthread_mutex_unlock(&msg_controller.mc_mutex);
+      pthread_mutex_unlock(&mc->mc_mutex);
       return 0;
     }
 
-    pthread_mutex_unlock(&msg_controller.mc_mutex);
+    pthread_mutex_unlock(&mc->mc_mutex);
   }
 
   // all attempts failed
@@ -109,16 +260,119 @@ static int send_data_wait_ack(int fd, char *data, size_t data_size,
   return -1;
 }
 
+// handle a received ack, standalone or carried by a data frame
+// must be called with mc_mutex locked
+static void receive_ack(MsgController *mc, uint16_t id) {
+  STAT_INC(mc->stats, acks_received);
+
+  // received expected ack while waiting for ack
+  if (mc->waiting_ack > 0 && id == mc->last_sent_id) {
+    mc->waiting_ack = 0;
+    mc->current_id = 1 - mc->current_id;
+    pthread_cond_signal(&mc->mc_ack_cond);
+  }
+
+  LOG_MSG(LOG_INFO,
+          "receive_thread(): received ack id %hd while current id %hd", id,
+          mc->last_sent_id);
+}
+
+// handle a frame of a windowed session, data is delivered in order and
+// every data or end frame is answered with a selective ack
+static void receive_window_frame(MsgController *mc, int fd, Frame *rec) {
+  SessionStats *stats = mc->stats;
+  Window *w = &mc->window;
+  uint16_t rec_id = ntohs(rec->id);
+  size_t rec_size = ntohs(rec->lenght);
+
+  pthread_mutex_lock(&mc->mc_mutex);
+
+  // received reset flag, abort program
+  if (rec->flags == RESET_FLAG) {
+    close(fd);
+    log_exit("received reset");
+  }
+
+  // received selective ack
+  if (rec->flags == ACKNOWLEDGE_FLAG) {
+    STAT_INC(stats, acks_received);
+    if (window_sack(w, rec_id, (uint8_t *)rec->data, rec_size, stats)) {
+      mc->sent_end = 1;
+    }
+    pthread_cond_signal(&mc->mc_ack_cond);
+    pthread_mutex_unlock(&mc->mc_mutex);
+    return;
+  }
+
+  // unknown flags
+  if (rec->flags != NO_FLAGS && rec->flags != END_FLAG) {
+    pthread_mutex_unlock(&mc->mc_mutex);
+    return;
+  }
+
+  // keep the frame until the frames before it arrive
+  int stored = window_store(w, rec_id, rec->flags, rec->data, rec_size);
+  if (stored > 0 && rec_id != w->rx_next) {
+    STAT_INC(stats, out_of_order_frames);
+    LOG_MSG(LOG_INFO, "receive_window_frame(): frame id %hu out of order",
+            rec_id);
+  } else if (stored == 0) {
+    STAT_INC(stats, duplicate_frames);
+    LOG_MSG(LOG_INFO, "receive_window_frame(): duplicated frame id %hu",
+            rec_id);
+  }
+
+  // deliver the frames now in order
+  RxSlot *slot;
+  while ((slot = window_next_in_order(w)) != NULL) {
+    // the last data must be consumed before it's replaced
+    while (mc->new_data_available > 0) {
+      pthread_cond_wait(&mc->mc_consumed_cond,
+                        &mc->mc_mutex);
+    }
+
+    mc->new_data_available = 1;
+    if (slot->flags == END_FLAG) {
+      LOG_MSG(LOG_INFO, "receive_window_frame(): received end");
+      mc->received_end = 1;
+    } else {
+      mc->last_size_received = slot->size;
+      STAT_INC(stats, data_frames_received);
+      STAT_ADD(stats, bytes_received, slot->size);
+      set_last_received_data(mc, slot->data, slot->size);
+    }
+    window_release(w);
+    pthread_cond_signal(&mc->mc_data_cond);
+  }
+
+  // ack the frames received so far, even for duplicated data
+  Frame ack;
+  uint8_t bitmap[SACK_BYTES];
+  size_t bitmap_size = make_sack(w, bitmap);
+  make_frame(&ack, w->rx_next, ACKNOWLEDGE_FLAG, (char *)bitmap, bitmap_size,
+             0);
+  pthread_mutex_unlock(&mc->mc_mutex);
+
+  if (transmit(mc, fd, &ack, FRAME_HEADER_BYTES + bitmap_size) != 0) {
+    LOG_MSG(LOG_ERROR, "receive_window_frame(): failed to send ack");
+    return;
+  }
+  STAT_INC(stats, acks_sent);
+}
+
 // receive frames from network until end frame received and sent
 void *receive_thread(void *arg) {
   LOG_MSG(LOG_INFO, "receive_thread(): start");
 
   // thread arguments
   ThreadArgs *tr = (ThreadArgs *)arg;
+  MsgController *mc = tr->mc;
 
-  // receipt frame
+  // receipt frame, no bigger than the agreed payload, so a session that
+  // didn't negotiate, e.g. md5, keeps MAX_DATA_BYTES
   Frame rec;
-  size_t rec_size = FRAME_HEADER_BYTES + MAX_DATA_BYTES;
+  size_t rec_size = FRAME_HEADER_BYTES + mc->payload;
+  SessionStats *stats = mc->stats;
 
   // attempts to be performed
   int total_attempts = 0;
@@ -126,137 +380,250 @@ void *receive_thread(void *arg) {
     total_attempts++;
 
     // stop condition, received and and sent end
-    pthread_mutex_lock(&msg_controller.mc_mutex);
-    if (msg_controller.received_end > 0 && msg_controller.sent_end > 0) {
-      pthread_mutex_unlock(&msg_controller.mc_mutex);
+    pthread_mutex_lock(&mc->mc_mutex);
+    if (mc->received_end > 0 && mc->sent_end > 0) {
+      pthread_mutex_unlock(&mc->mc_mutex);
       LOG_MSG(LOG_INFO, "receive_thread(): complete due end flag");
       break;
     }
-    pthread_mutex_unlock(&msg_controller.mc_mutex);
+    pthread_mutex_unlock(&mc->mc_mutex);
 
     LOG_MSG(LOG_INFO, "receive_thread(): attempt %d", total_attempts);
 
     //  try to receive the frame and retry if failed
-    if (receive_frame(tr->fd, &rec, rec_size) != 0) {
+    int ret = receive_frame(tr->fd, &rec, rec_size);
+    if (ret != 0) {
+      if (ret == FRAME_BAD_CHECKSUM) {
+        STAT_INC(stats, checksum_failures);
+      } else if (ret == FRAME_INVALID) {
+        STAT_INC(stats, invalid_frames);
+      } else {
+        STAT_INC(stats, receive_timeouts);
+      }
       LOG_MSG(LOG_WARNING, "receive_thread(): receipt failed, retry..");
       continue;
     }
+    STAT_INC(stats, frames_received);
 
     LOG_MSG(LOG_INFO, "receive_thread(): received flag %x", rec.flags);
     total_attempts = 0;
 
+    // the client lost the caps answer, it is sent again
+    // a late caps answer is dropped, it isn't data
+    if (rec.flags & CAPS_FLAG) {
+      if (rec.flags == CAPS_FLAG) {
+        send_caps(mc, tr->fd, CAPS_FLAG | ACKNOWLEDGE_FLAG, mc->payload);
+      }
+      continue;
+    }
+
+    // windowed session
+    if (mc->window.size > 0) {
+      receive_window_frame(mc, tr->fd, &rec);
+      continue;
+    }
+
     uint16_t rec_id = ntohs(rec.id);
-    pthread_mutex_lock(&msg_controller.mc_mutex);
+    uint8_t flags = rec.flags;
+    int new_frame = 0;
+    int ack_now = 0;
+    pthread_mutex_lock(&mc->mc_mutex);
 
     // received reset flag, abort program
-    if (rec.flags == RESET_FLAG) {
+    if (flags == RESET_FLAG) {
       close(tr->fd);
       log_exit("received reset");
     }
 
-    // received ack frame
-    if (rec.flags == ACKNOWLEDGE_FLAG) {
-      // received expected ack while waiting for ack
-      if (msg_controller.waiting_ack > 0 &&
-          rec_id == msg_controller.last_sent_id) {
-        msg_controller.waiting_ack = 0;
-        msg_controller.current_id = 1 - msg_controller.current_id;
-        pthread_cond_signal(&msg_controller.mc_ack_cond);
-      }
+    // data frame carrying an ack, the ack is handled first so the sender
+    // is released and can carry the ack of this data back
+    if (mc->delayed_acks > 0 && (flags & ACKNOWLEDGE_FLAG) &&
+        (flags & ~(ACKNOWLEDGE_FLAG | ACK_ID_FLAG)) == 0 &&
+        ntohs(rec.lenght) > 0) {
+      receive_ack(mc, (flags & ACK_ID_FLAG) ? 1 : 0);
+      flags = NO_FLAGS;
+    }
 
-      LOG_MSG(LOG_INFO,
-              "receive_thread(): received ack id %hd while current id %hd",
-              rec_id, msg_controller.last_sent_id);
+    // received ack frame
+    if (flags == ACKNOWLEDGE_FLAG) {
+      receive_ack(mc, rec_id);
     }
 
     // received data or end
-    else if (rec.flags == NO_FLAGS || rec.flags == END_FLAG) {
+    else if (flags == NO_FLAGS || flags == END_FLAG) {
       // new frame
-      if (rec_id != msg_controller.last_received_id) {
-        msg_controller.last_received_id = rec_id;
-        msg_controller.new_data_available = 1;
+      if (rec_id != mc->last_received_id) {
+        // the last data must be consumed before it's replaced
+        while (mc->new_data_available > 0) {
+          pthread_cond_wait(&mc->mc_consumed_cond,
+                            &mc->mc_mutex);
+        }
+
+        mc->last_received_id = rec_id;
+        mc->new_data_available = 1;
+        new_frame = 1;
 
         // received end
-        if (rec.flags == END_FLAG) {
+        if (flags == END_FLAG) {
           LOG_MSG(LOG_INFO, "receive_thread(): received new end frame id %hd",
                   rec_id);
-          msg_controller.received_end = 1;
+          mc->received_end = 1;
         } else {
           LOG_MSG(LOG_INFO, "receive_thread(): received new data frame id %hd",
                   rec_id);
-          msg_controller.last_size_received = ntohs(rec.lenght);
-          set_last_received_data(&msg_controller, rec.data,
-                                 msg_controller.last_size_received);
+          mc->last_size_received = ntohs(rec.lenght);
+          STAT_INC(stats, data_frames_received);
+          STAT_ADD(stats, bytes_received, mc->last_size_received);
+          set_last_received_data(mc, rec.data,
+                                 mc->last_size_received);
         }
 
-        pthread_cond_signal(&msg_controller.mc_data_cond);
+        pthread_cond_signal(&mc->mc_data_cond);
       } else {
+        STAT_INC(stats, duplicate_frames);
         LOG_MSG(LOG_INFO, "receive_thread(): received duplicated frame id %hd",
                 rec_id);
       }
 
-      // send ack even for duplicated data
+      // a new data frame may wait for outgoing data to carry its ack,
+      // ends and duplicates, already waited by the peer, are acked at once
+      if (flags == NO_FLAGS && new_frame > 0 && can_delay_ack(mc)) {
+        mc->ack_pending = 1;
+        mc->pending_ack_id = rec_id;
+        clock_gettime(CLOCK_REALTIME, &mc->ack_deadline);
+        mc->ack_deadline.tv_nsec += ACK_DELAY_MS * 1000000L;
+        if (mc->ack_deadline.tv_nsec >= 1000000000L) {
+          mc->ack_deadline.tv_sec++;
+          mc->ack_deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_signal(&mc->mc_ack_timer_cond);
+        LOG_MSG(LOG_INFO, "receive_thread(): ack id %hd delayed", rec_id);
+      } else {
+        mc->ack_pending = 0;
+        ack_now = 1;
+      }
+    }
+
+    pthread_mutex_unlock(&mc->mc_mutex);
+
+    // send ack even for duplicated data
+    if (ack_now > 0) {
       LOG_MSG(LOG_INFO, "receive_thread(): need to send ack id %hd", rec_id);
-      if (send_ack(tr->fd, rec_id) != 0) {
+      if (send_ack(mc, tr->fd, rec_id) != 0) {
         LOG_MSG(LOG_ERROR, "receive_thread(): failed to send ack id %hd",
                 rec_id);
       }
       LOG_MSG(LOG_INFO, "receive_thread(): akc id %hd sent", rec_id);
     }
-
-    pthread_mutex_unlock(&msg_controller.mc_mutex);
   }
 
+  // stop the ack timer
+  pthread_mutex_lock(&mc->mc_mutex);
+  mc->session_done = 1;
+  pthread_cond_signal(&mc->mc_ack_timer_cond);
+  pthread_mutex_unlock(&mc->mc_mutex);
+
   LOG_MSG(LOG_INFO, "receive_thread(): complete");
   return NULL;
 }
 
+// send the delayed acks that no data frame carried in time
+void *ack_timer_thread(void *arg) {
+  LOG_MSG(LOG_INFO, "ack_timer_thread(): start");
+
+  // thread arguments
+  ThreadArgs *tr = (ThreadArgs *)arg;
+  MsgController *mc = tr->mc;
+
+  pthread_mutex_lock(&mc->mc_mutex);
+  while (mc->session_done == 0) {
+    // wait for a delayed ack
+    if (mc->ack_pending == 0) {
+      pthread_cond_wait(&mc->mc_ack_timer_cond,
+                        &mc->mc_mutex);
+      continue;
+    }
+
+    // wait for its deadline, the ack may be carried meanwhile
+    if (!time_reached(&mc->ack_deadline)) {
+      pthread_cond_timedwait(&mc->mc_ack_timer_cond,
+                             &mc->mc_mutex,
+                             &mc->ack_deadline);
+      continue;
+    }
+
+    // no data frame carried it, send it alone
+    uint16_t id = mc->pending_ack_id;
+    mc->ack_pending = 0;
+    pthread_mutex_unlock(&mc->mc_mutex);
+
+    STAT_INC(mc->stats, acks_delayed);
+    if (send_ack(mc, tr->fd, id) != 0) {
+      LOG_MSG(LOG_ERROR, "ack_timer_thread(): failed to send ack id %hd", id);
+    }
+
+    pthread_mutex_lock(&mc->mc_mutex);
+  }
+  pthread_mutex_unlock(&mc->mc_mutex);
+
+  LOG_MSG(LOG_INFO, "ack_timer_thread(): complete");
+  return NULL;
+}
+
 // send thread used in dccnet-md5 program
 void *send_md5_thread(void *arg) {
   LOG_MSG(LOG_INFO, "send_md5_thread(): start");
 
   // thread arguments
   ThreadArgs *tr = (ThreadArgs *)arg;
+  MsgController *mc = tr->mc;
 
   // init authentication
-  if (send_data_wait_ack(tr->fd, tr->gas, tr->gas_size, 1) != 0) {
+  if (send_data_wait_ack(mc, tr->fd, tr->gas, tr->gas_size, 1) != 0) {
     LOG_MSG(LOG_ERROR,
             "send_md5_thread(): complete with no ack after gas sent");
     return NULL;
   }
 
-  // send md5 hash for the received data
-  char full_msg[MAX_DATA_BYTES];
+  // send md5 hash for the received data, a line may span two frames
+  char full_msg[2 * MAX_DATA_BYTES + 1];
   full_msg[0] = '\0';
 
   LOG_MSG(LOG_INFO,
           "send_md5_thread(): prepare to send md5 hash of the received data");
   while (1) {
     // wait for new data or end
-    pthread_mutex_lock(&msg_controller.mc_mutex);
-    if (msg_controller.new_data_available == 0) {
+    pthread_mutex_lock(&mc->mc_mutex);
+    if (mc->new_data_available == 0) {
       LOG_MSG(LOG_INFO, "send_md5_thread(): waiting for new data");
-      pthread_cond_wait(&msg_controller.mc_data_cond, &msg_controller.mc_mutex);
+      pthread_cond_wait(&mc->mc_data_cond, &mc->mc_mutex);
     }
 
     // stop condition, received end
-    if (msg_controller.received_end > 0) {
+    if (mc->received_end > 0) {
       LOG_MSG(LOG_INFO,
               "send_md5_thread(): no need to send md5 hash due end received");
-      pthread_mutex_unlock(&msg_controller.mc_mutex);
+      pthread_mutex_unlock(&mc->mc_mutex);
       break;
     }
 
-    // concatenate received data
-    msg_controller.last_received_data[msg_controller.last_size_received] = '\0';
-    strcat(full_msg, msg_controller.last_received_data);
-    msg_controller.new_data_available = 0;
+    // concatenate received data, a longer line is dropped
+    size_t msg_size = strlen(full_msg);
+    if (msg_size + mc->last_size_received >= sizeof(full_msg)) {
+      LOG_MSG(LOG_ERROR, "send_md5_thread(): line too long, dropped");
+      msg_size = 0;
+    }
+    memcpy(full_msg + msg_size, mc->last_received_data,
+           mc->last_size_received);
+    full_msg[msg_size + mc->last_size_received] = '\0';
+    mc->new_data_available = 0;
+    pthread_cond_signal(&mc->mc_consumed_cond);
     LOG_MSG(LOG_INFO, "send_md5_thread(): new data to hash: %s",
-            msg_controller.last_received_data);
-    pthread_mutex_unlock(&msg_controller.mc_mutex);
+            mc->last_received_data);
+    pthread_mutex_unlock(&mc->mc_mutex);
 
     size_t data_size = strlen(full_msg);
-    if (full_msg[data_size - 1] == '\n') {
+    if (data_size > 0 && full_msg[data_size - 1] == '\n') {
       // split msg in '\n'
       char *sub_msg = strtok(full_msg, "\n");
 
@@ -268,7 +635,7 @@ void *send_md5_thread(void *arg) {
         char *md5_hash = get_md5_str(sub_msg);
         size_t md5_hash_size = strlen(md5_hash);
 
-        if (send_data_wait_ack(tr->fd, md5_hash, md5_hash_size, 1) != 0) {
+        if (send_data_wait_ack(mc, tr->fd, md5_hash, md5_hash_size, 1) != 0) {
           LOG_MSG(LOG_ERROR, "send_md5_thread(): failed to send hash");
           break;
         }
@@ -284,25 +651,124 @@ void *send_md5_thread(void *arg) {
   return NULL;
 }
 
+// read the next data to send, the input in order or the next striped chunk
+// returns the data size or 0 at the end
+static size_t read_input(ThreadArgs *tr, char *buf, size_t buf_size) {
+  if (tr->stripe != NULL) {
+    return next_stripe_chunk(tr->stripe, buf, buf_size);
+  }
+  return fread(buf, 1, buf_size, tr->input);
+}
+
+// send the input keeping up to the window size frames in flight, only the
+// timed out frames and the ones reported missing are resent
+// returns 0 once the end is acked, or -1
+static int send_window(MsgController *mc, ThreadArgs *tr) {
+  LOG_MSG(LOG_INFO, "send_window(): start");
+  Window *w = &mc->window;
+  SessionStats *stats = mc->stats;
+  char data[MAX_PAYLOAD_BYTES];
+
+  pthread_mutex_lock(&mc->mc_mutex);
+  while (!w->tx_end_queued || w->tx_base != w->tx_next) {
+    // queue new frames while there is room, the end goes last
+    while (!w->tx_end_queued && !window_full(w)) {
+      pthread_mutex_unlock(&mc->mc_mutex);
+      size_t bytes_read = read_input(tr, data, mc->payload);
+      pthread_mutex_lock(&mc->mc_mutex);
+      window_push(w, bytes_read > 0 ? NO_FLAGS : END_FLAG, data, bytes_read);
+    }
+
+    // send the due frames, new, timed out or reported missing
+    uint64_t now = stats_now_us();
+    uint64_t next_deadline = now + RETRANSMIT_MS * 1000;
+    for (uint16_t id = w->tx_base; id != w->tx_next; id++) {
+      TxSlot *slot = window_tx_slot(w, id);
+      if (slot->acked) {
+        continue;
+      }
+
+      if (slot->deadline_us <= now) {
+        if (slot->attempts >= MAX_ATTEMPTS) {
+          LOG_MSG(LOG_ERROR, "send_window(): no ack for frame id %hu", id);
+          pthread_mutex_unlock(&mc->mc_mutex);
+          return -1;
+        }
+        if (slot->attempts > 0) {
+          STAT_INC(stats, retransmissions);
+        }
+        slot->attempts++;
+        slot->sent_us = now;
+        slot->deadline_us = now + RETRANSMIT_MS * 1000;
+
+        // only this thread changes the frame, it can be sent unlocked
+        pthread_mutex_unlock(&mc->mc_mutex);
+        if (transmit(mc, tr->fd, slot->frame, slot->size) == 0 &&
+            slot->frame->flags == NO_FLAGS) {
+          STAT_INC(stats, data_frames_sent);
+          STAT_ADD(stats, bytes_sent, slot->size - FRAME_HEADER_BYTES);
+        }
+        pthread_mutex_lock(&mc->mc_mutex);
+      }
+
+      if (slot->deadline_us < next_deadline) {
+        next_deadline = slot->deadline_us;
+      }
+    }
+
+    // wait for acks until the first deadline
+    if (w->tx_end_queued && w->tx_base == w->tx_next) {
+      break;
+    }
+    now = stats_now_us();
+    if (next_deadline > now) {
+      uint64_t wait_us = next_deadline - now;
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += wait_us / 1000000;
+      ts.tv_nsec += (wait_us % 1000000) * 1000;
+      if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+      }
+      pthread_cond_timedwait(&mc->mc_ack_cond,
+                             &mc->mc_mutex, &ts);
+    }
+  }
+
+  mc->sent_end = 1;
+  pthread_mutex_unlock(&mc->mc_mutex);
+  LOG_MSG(LOG_INFO, "send_window(): complete");
+  return 0;
+}
+
 // send thread used by xfer program
 void *send_xfer_thread(void *arg) {
   LOG_MSG(LOG_INFO, "send_xfer_thread(): start");
 
   // thread arguments
   ThreadArgs *tr = (ThreadArgs *)arg;
+  MsgController *mc = tr->mc;
+
+  // windowed session
+  if (mc->window.size > 0) {
+    if (send_window(mc, tr) != 0) {
+      LOG_MSG(LOG_ERROR, "send_xfer_thread(): failed to send the file");
+    }
+    return NULL;
+  }
 
   // buffer to be read
-  char line[MAX_DATA_BYTES];
-  memset(line, 0, MAX_DATA_BYTES);
+  char line[MAX_PAYLOAD_BYTES];
 
   // read bytes until end
   ssize_t bytes_read;
-  while ((bytes_read = fread(line, 1, MAX_DATA_BYTES, tr->input)) > 0) {
+  while ((bytes_read = read_input(tr, line, mc->payload)) > 0) {
     LOG_MSG(LOG_INFO, "send_xfer_thread(): sending data of %ld bytes read",
             bytes_read);
 
     // send bytes and wait for ack
-    if (send_data_wait_ack(tr->fd, line, bytes_read, 0) != 0) {
+    if (send_data_wait_ack(mc, tr->fd, line, bytes_read, 0) != 0) {
       LOG_MSG(LOG_ERROR,
               "send_xfer_thread(): failed to send file linea and get ack");
       return NULL;
@@ -312,15 +778,15 @@ void *send_xfer_thread(void *arg) {
   LOG_MSG(LOG_INFO, "send_xfer_thread(): file transfered, need to send end");
 
   // send end after complete file transfer
-  pthread_mutex_lock(&msg_controller.mc_mutex);
-  if (send_end(tr->fd, msg_controller.current_id) != 0) {
+  pthread_mutex_lock(&mc->mc_mutex);
+  if (send_end(mc, tr->fd, mc->current_id) != 0) {
     LOG_MSG(LOG_ERROR, "send_xfer_thread(): failed to send end frame");
-    pthread_mutex_unlock(&msg_controller.mc_mutex);
+    pthread_mutex_unlock(&mc->mc_mutex);
     return NULL;
   }
 
-  msg_controller.sent_end = 1;
-  pthread_mutex_unlock(&msg_controller.mc_mutex);
+  mc->sent_end = 1;
+  pthread_mutex_unlock(&mc->mc_mutex);
 
   LOG_MSG(LOG_INFO, "send_xfer_thread(): send end");
 
@@ -337,35 +803,40 @@ void *print_thread(void *arg) {
 
   // thread arguments
   ThreadArgs *tr = (ThreadArgs *)arg;
+  MsgController *mc = tr->mc;
 
   while (1) {
     // wait for new data or end
-    pthread_mutex_lock(&msg_controller.mc_mutex);
-    if (msg_controller.new_data_available == 0) {
-      pthread_cond_wait(&msg_controller.mc_data_cond, &msg_controller.mc_mutex);
+    pthread_mutex_lock(&mc->mc_mutex);
+    if (mc->new_data_available == 0) {
+      pthread_cond_wait(&mc->mc_data_cond, &mc->mc_mutex);
     }
 
     // stop condition, received end
-    if (msg_controller.received_end > 0) {
+    if (mc->received_end > 0) {
       LOG_MSG(LOG_INFO, "print_thread(): end received");
-      pthread_mutex_unlock(&msg_controller.mc_mutex);
+      pthread_mutex_unlock(&mc->mc_mutex);
       break;
     }
 
-    // write bytes to file
-    ssize_t bytes_written =
-        fwrite(msg_controller.last_received_data, 1,
-               msg_controller.last_size_received, tr->output);
-    if (bytes_written <= 0) {
+    // write bytes to file, a striped chunk goes to its offset
+    if (tr->stripe != NULL) {
+      if (write_stripe_chunk(tr->stripe, mc->last_received_data,
+                             mc->last_size_received) != 0) {
+        LOG_MSG(LOG_ERROR, "print_thread(): invalid chunk dropped");
+      }
+    } else if (fwrite(mc->last_received_data, 1, mc->last_size_received,
+                      tr->output) <= 0) {
       log_exit("failed to write to output");
     }
-    msg_controller.new_data_available = 0;
+    mc->new_data_available = 0;
+    pthread_cond_signal(&mc->mc_consumed_cond);
 
     // print progress
-    total_bytes += msg_controller.last_size_received;
+    total_bytes += mc->last_size_received;
     printf("%ld bytes received\n", total_bytes);
 
-    pthread_mutex_unlock(&msg_controller.mc_mutex);
+    pthread_mutex_unlock(&mc->mc_mutex);
   }
   LOG_MSG(LOG_INFO, "print_thread(): complete");
   return NULL;
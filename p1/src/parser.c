@@ -1,5 +1,8 @@
 #include "parser.h"
 #include "logger.h"
+#include "stripe.h"
+#include "window.h"
+#include <stdlib.h>
 #include <string.h>
 
 // parse the format <IP>:<PORT> into program params
@@ -22,6 +25,42 @@ static void parse_ip_and_port(Params *p, const char *str, const char *program) {
   p->port = strdup(last_colon + 1);
 }
 
+// parse the trailing options, -d, -S <stats file> and, for xfer, -a,
+// -w <window>, -x <payload> and -k <sessions>
+// returns the index of the first unknown argument
+static int parse_options(Params *p, int argc, char **argv, int start,
+                         int xfer) {
+  int i = start;
+  while (i < argc) {
+    if (strcmp(argv[i], "-d") == 0) {
+      p->debug_mode = 1;
+    } else if (xfer && strcmp(argv[i], "-a") == 0) {
+      p->delayed_acks = 1;
+    } else if (xfer && strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      p->window = atoi(argv[++i]);
+      if (p->window < 1 || p->window > MAX_WINDOW) {
+        break;
+      }
+    } else if (xfer && strcmp(argv[i], "-x") == 0 && i + 1 < argc) {
+      p->max_payload = atoi(argv[++i]);
+      if (p->max_payload < 1 || p->max_payload > MAX_PAYLOAD_BYTES) {
+        break;
+      }
+    } else if (xfer && strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      p->stripes = atoi(argv[++i]);
+      if (p->stripes < 1 || p->stripes > MAX_STRIPES) {
+        break;
+      }
+    } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+      p->stats_file = argv[++i];
+    } else {
+      break;
+    }
+    i++;
+  }
+  return i;
+}
+
 // paser command line arguments for md5 program
 Params parse_args_md5(int argc, char **argv) {
   // check min arguments number
@@ -36,6 +75,11 @@ Params parse_args_md5(int argc, char **argv) {
   p.gas = NULL;
   p.output_file = NULL;
   p.debug_mode = 0;
+  p.stats_file = NULL;
+  p.delayed_acks = 0;
+  p.window = 0;
+  p.max_payload = 0;
+  p.stripes = 0;
 
   // ip and port argument
   parse_ip_and_port(&p, argv[1], argv[0]);
@@ -46,8 +90,8 @@ Params parse_args_md5(int argc, char **argv) {
   // optional extra arguments
   if (argc >= 4) {
     p.output_file = argv[3];
-    if (argc == 5 && strcmp(argv[4], "-d") == 0) {
-      p.debug_mode = 1;
+    if (parse_options(&p, argc, argv, 4, 0) != argc) {
+      usage_md5(argv[0]);
     }
   }
 
@@ -71,6 +115,11 @@ Params parse_args_xfer(int argc, char **argv) {
   p.output_file = NULL;
   p.debug_mode = 0;
   p.ip_version = "v4";
+  p.stats_file = NULL;
+  p.delayed_acks = 0;
+  p.window = 0;
+  p.max_payload = 0;
+  p.stripes = 0;
 
   // server mode
   if (strcmp(argv[1], "-s") == 0) {
@@ -110,12 +159,25 @@ Params parse_args_xfer(int argc, char **argv) {
   p.input_file = argv[3];
   p.output_file = argv[4];
 
-  // optional param
+  // optional params
+  int next = 5;
   if (argc >= 6 && (strcmp(argv[5], "v4") == 0 || strcmp(argv[5], "v6") == 0)) {
     p.ip_version = argv[5];
-    if (argc == 7 && strcmp(argv[6], "-d") == 0) {
-      p.debug_mode = 1;
-    }
+    next++;
+  }
+  if (parse_options(&p, argc, argv, next, 1) != argc) {
+    usage_xfer(argv[0]);
+  }
+
+  // piggybacked acks carry stop and wait ids only
+  if (p.delayed_acks > 0 && p.window > 0) {
+    usage_xfer(argv[0]);
+  }
+
+  // striped chunks need room for the manifest
+  if (p.stripes > 0 && p.max_payload > 0 &&
+      p.max_payload < STRIPE_MIN_PAYLOAD) {
+    usage_xfer(argv[0]);
   }
 
   return p;
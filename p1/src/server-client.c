@@ -66,6 +66,50 @@ int init_server(const char *protocol, const char *port_str) {
   return sock_fd;
 }
 
+// an xfer session and its threads
+typedef struct {
+  ThreadArgs tr;
+  pthread_t send_t, recv_t, print_t, ack_t;
+} XferSession;
+
+// agree on the payload size and start the threads of a connected session
+static void start_xfer_session(XferSession *s, MsgController *mc, int fd,
+                               FILE *input, FILE *output, Stripe *stripe,
+                               int server_side) {
+  // thread arguments
+  memset(&s->tr, 0, sizeof(s->tr));
+  s->tr.fd = fd;
+  s->tr.input = input;
+  s->tr.output = output;
+  s->tr.mc = mc;
+  s->tr.stripe = stripe;
+
+  // agree on the payload size before any data
+  if (mc->max_payload > 0) {
+    mc->payload = server_side > 0 ? server_caps(mc, fd, mc->max_payload)
+                                  : client_caps(mc, fd, mc->max_payload);
+  }
+
+  // create threads
+  pthread_create(&s->send_t, NULL, send_xfer_thread, &s->tr);
+  pthread_create(&s->recv_t, NULL, receive_thread, &s->tr);
+  pthread_create(&s->print_t, NULL, print_thread, &s->tr);
+  if (mc->delayed_acks > 0) {
+    pthread_create(&s->ack_t, NULL, ack_timer_thread, &s->tr);
+  }
+}
+
+// wait for the threads of a session and close it
+static void join_xfer_session(XferSession *s) {
+  pthread_join(s->send_t, NULL);
+  pthread_join(s->recv_t, NULL);
+  pthread_join(s->print_t, NULL);
+  if (s->tr.mc->delayed_acks > 0) {
+    pthread_join(s->ack_t, NULL);
+  }
+  close(s->tr.fd);
+}
+
 // exchange file lines with a client
 void server_actions(int fd, FILE *input, FILE *output) {
   LOG_MSG(LOG_INFO, "server_actions(): start");
@@ -86,27 +130,14 @@ void server_actions(int fd, FILE *input, FILE *output) {
 
     LOG_MSG(LOG_INFO, "client connected");
 
-    // declare threads
-    pthread_t recv_t, send_t, print_t;
-
-    // thread arguments
-    ThreadArgs *tr = (ThreadArgs *)malloc(sizeof(ThreadArgs));
-    tr->fd = client_fd;
-    tr->input = input;
-    tr->output = output;
+    // the server holds its acks for its data, the client doesn't, so
+    // the two sides don't wait for each other's delayed acks
+    msg_controller.hold_acks = 1;
 
-    // create threads
-    pthread_create(&send_t, NULL, send_xfer_thread, tr);
-    pthread_create(&recv_t, NULL, receive_thread, tr);
-    pthread_create(&print_t, NULL, print_thread, tr);
-
-    // wait for thread result
-    pthread_join(send_t, NULL);
-    pthread_join(recv_t, NULL);
-    pthread_join(print_t, NULL);
-
-    free(tr);
-    close(client_fd);
+    XferSession session;
+    start_xfer_session(&session, &msg_controller, client_fd, input, output,
+                       NULL, 1);
+    join_xfer_session(&session);
     break;
   }
 }
@@ -123,8 +154,9 @@ void client_md5_actions(int fd, const char *gas, size_t gas_size,
   pthread_t send_t, recv_t;
 
   // set thread arguments
-  ThreadArgs *tr = (ThreadArgs *)malloc(sizeof(ThreadArgs));
+  ThreadArgs *tr = (ThreadArgs *)calloc(1, sizeof(ThreadArgs));
   tr->fd = fd;
+  tr->mc = &msg_controller;
   tr->gas = strdup(gas);
   tr->gas_size = gas_size;
   tr->output = output;
@@ -144,26 +176,87 @@ void client_md5_actions(int fd, const char *gas, size_t gas_size,
 
 // exchange file lines with a server
 void client_xfer_actions(int fd, FILE *input, FILE *output) {
-  LOG_MSG(LOG_INFO, "client_xfer_actions(): start"); // declare threads
-  pthread_t recv_t, send_t, print_t;
+  LOG_MSG(LOG_INFO, "client_xfer_actions(): start");
 
-  // thread arguments
-  ThreadArgs *tr = (ThreadArgs *)malloc(sizeof(ThreadArgs));
-  tr->fd = fd;
-  tr->input = input;
-  tr->output = output;
+  XferSession session;
+  start_xfer_session(&session, &msg_controller, fd, input, output, NULL, 0);
+  join_xfer_session(&session);
 
-  // create threads
-  pthread_create(&send_t, NULL, send_xfer_thread, tr);
-  pthread_create(&recv_t, NULL, receive_thread, tr);
-  pthread_create(&print_t, NULL, print_thread, tr);
+  LOG_MSG(LOG_INFO, "client_xfer_actions(): complete");
+}
 
-  // wait for thread result
-  pthread_join(send_t, NULL);
-  pthread_join(recv_t, NULL);
-  pthread_join(print_t, NULL);
+// accept a striped session if listening, or connect one
+static int stripe_connection(int listen_fd, const char *addr_str,
+                             const char *port_str) {
+  if (listen_fd < 0) {
+    return init_and_connect_client(addr_str, port_str);
+  }
 
-  free(tr);
-  close(fd);
-  LOG_MSG(LOG_INFO, "client_xfer_actions(): complete");
+  int client_fd;
+  do {
+    struct sockaddr_storage client_storage;
+    socklen_t addr_size = sizeof(client_storage);
+    client_fd =
+        accept(listen_fd, (struct sockaddr *)&client_storage, &addr_size);
+  } while (client_fd < 0);
+  return client_fd;
+}
+
+// exchange files over parallel sessions, each session takes the next
+// chunk of the input and writes the received chunks at their offsets
+// the server accepts the sessions and the client connects them
+// returns 0 if the received file matches the peer manifest
+static int stripe_actions(int listen_fd, const char *addr_str,
+                          const char *port_str, FILE *input, FILE *output,
+                          int stripes) {
+  LOG_MSG(LOG_INFO, "stripe_actions(): start with %d sessions", stripes);
+
+  Stripe stripe;
+  if (init_stripe(&stripe, input, output) != 0) {
+    log_exit("stripe input failure");
+  }
+
+  // each session keeps its own counters, the exported stats are their sum
+  MsgController *mcs = malloc(stripes * sizeof(MsgController));
+  XferSession *sessions = malloc(stripes * sizeof(XferSession));
+  SessionStats *stats = alloc_session_stats(stripes);
+  if (mcs == NULL || sessions == NULL || stats == NULL) {
+    log_exit("sessions allocation failure");
+  }
+
+  // the server holds its acks, see server_actions
+  msg_controller.hold_acks = listen_fd >= 0;
+
+  // sessions start as they are connected
+  for (int i = 0; i < stripes; i++) {
+    int fd = stripe_connection(listen_fd, addr_str, port_str);
+    LOG_MSG(LOG_INFO, "stripe_actions(): session %d connected", i);
+    init_session_controller(&mcs[i], &msg_controller);
+    mcs[i].stats = &stats[i];
+    start_xfer_session(&sessions[i], &mcs[i], fd, input, output, &stripe,
+                       listen_fd >= 0);
+  }
+
+  for (int i = 0; i < stripes; i++) {
+    join_xfer_session(&sessions[i]);
+    clean_msg_controller(&mcs[i]);
+  }
+
+  int ret = check_stripe(&stripe);
+  clean_stripe(&stripe);
+  free(sessions);
+  free(mcs);
+  LOG_MSG(LOG_INFO, "stripe_actions(): complete");
+  return ret;
+}
+
+// striped exchange with the sessions of a client
+int server_stripe_actions(int fd, FILE *input, FILE *output, int stripes) {
+  return stripe_actions(fd, NULL, NULL, input, output, stripes);
+}
+
+// striped exchange over several sessions to a server
+int client_stripe_actions(const char *addr_str, const char *port_str,
+                          FILE *input, FILE *output, int stripes) {
+  return stripe_actions(-1, addr_str, port_str, input, output, stripes);
 }
@@ -0,0 +1,287 @@
+#include "stats.h"
+#include "logger.h"
+#include "replace-file.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// check interval of the export thread in ms
+#define EXPORT_TICK_MS 100
+
+// export thread state
+static SessionStats *export_stats = NULL;
+static const char *export_path = NULL;
+static pthread_t export_thread;
+static atomic_int export_running;
+static volatile sig_atomic_t dump_requested = 0;
+
+// counters of the sessions of a striped transfer
+static SessionStats *export_sessions = NULL;
+static atomic_int export_session_count;
+
+// name and offset of every counter, shared by the json writer and the sums
+static const struct {
+  const char *name;
+  size_t offset;
+} counters[] = {
+    {"frames_sent", offsetof(SessionStats, frames_sent)},
+    {"frames_received", offsetof(SessionStats, frames_received)},
+    {"data_frames_sent", offsetof(SessionStats, data_frames_sent)},
+    {"data_frames_received", offsetof(SessionStats, data_frames_received)},
+    {"acks_sent", offsetof(SessionStats, acks_sent)},
+    {"acks_received", offsetof(SessionStats, acks_received)},
+    {"acks_piggybacked", offsetof(SessionStats, acks_piggybacked)},
+    {"acks_delayed", offsetof(SessionStats, acks_delayed)},
+    {"retransmissions", offsetof(SessionStats, retransmissions)},
+    {"fast_retransmissions", offsetof(SessionStats, fast_retransmissions)},
+    {"ack_timeouts", offsetof(SessionStats, ack_timeouts)},
+    {"duplicate_frames", offsetof(SessionStats, duplicate_frames)},
+    {"out_of_order_frames", offsetof(SessionStats, out_of_order_frames)},
+    {"checksum_failures", offsetof(SessionStats, checksum_failures)},
+    {"invalid_frames", offsetof(SessionStats, invalid_frames)},
+    {"send_failures", offsetof(SessionStats, send_failures)},
+    {"receive_timeouts", offsetof(SessionStats, receive_timeouts)},
+    {"bytes_sent", offsetof(SessionStats, bytes_sent)},
+    {"bytes_received", offsetof(SessionStats, bytes_received)},
+};
+#define COUNTERS (sizeof(counters) / sizeof(counters[0]))
+
+// counter i of the table in the given stats
+static _Atomic uint64_t *counter_at(SessionStats *s, size_t i) {
+  return (_Atomic uint64_t *)((char *)s + counters[i].offset);
+}
+
+// init all counters
+void init_stats(SessionStats *s) {
+  memset(s, 0, sizeof(*s));
+  s->start_us = stats_now_us();
+}
+
+// microseconds elapsed on the monotonic clock
+uint64_t stats_now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// record the time between a data frame and its ack
+void stats_ack_latency(SessionStats *s, uint64_t latency_us) {
+  int bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && (1ULL << bucket) <= latency_us) {
+    bucket++;
+  }
+  STAT_INC(s, ack_latency[bucket]);
+  STAT_ADD(s, ack_latency_sum_us, latency_us);
+
+  uint64_t max = atomic_load_explicit(&s->ack_latency_max_us,
+                                      memory_order_relaxed);
+  while (latency_us > max &&
+         !atomic_compare_exchange_weak(&s->ack_latency_max_us, &max,
+                                       latency_us)) {
+  }
+}
+
+// upper bound of the bucket holding the given percentile
+static uint64_t latency_percentile(const uint64_t *buckets, uint64_t count,
+                                   double p) {
+  uint64_t rank = (uint64_t)(p * count);
+  uint64_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += buckets[i];
+    if (seen > rank) {
+      return 1ULL << i;
+    }
+  }
+  return 1ULL << (LATENCY_BUCKETS - 1);
+}
+
+// write a snapshot of the counters as a json object indented by ind, the
+// counters of the sessions are listed in it
+static void write_stats_object(SessionStats *s, FILE *out, int ind,
+                               SessionStats *sessions, int count) {
+  double elapsed = (stats_now_us() - s->start_us) / 1e6;
+  if (elapsed <= 0) {
+    elapsed = 1e-6;
+  }
+
+  uint64_t buckets[LATENCY_BUCKETS];
+  uint64_t samples = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    buckets[i] = atomic_load(&s->ack_latency[i]);
+    samples += buckets[i];
+  }
+  uint64_t bytes_sent = atomic_load(&s->bytes_sent);
+  uint64_t bytes_received = atomic_load(&s->bytes_received);
+
+  fprintf(out, "{\n");
+  fprintf(out, "%*s\"elapsed_s\": %.3f,\n", ind + 2, "", elapsed);
+
+  for (size_t i = 0; i < COUNTERS; i++) {
+    fprintf(out, "%*s\"%s\": %lu,\n", ind + 2, "", counters[i].name,
+            (unsigned long)atomic_load(counter_at(s, i)));
+  }
+
+  fprintf(out, "%*s\"tx_bytes_per_s\": %.1f,\n", ind + 2, "",
+          bytes_sent / elapsed);
+  fprintf(out, "%*s\"rx_bytes_per_s\": %.1f,\n", ind + 2, "",
+          bytes_received / elapsed);
+
+  // ack latency, percentiles are bucket upper bounds
+  double mean =
+      samples > 0 ? (double)atomic_load(&s->ack_latency_sum_us) / samples : 0;
+  int in = ind + 4;
+  fprintf(out, "%*s\"ack_latency_us\": {\n", ind + 2, "");
+  fprintf(out, "%*s\"count\": %lu,\n", in, "", (unsigned long)samples);
+  fprintf(out, "%*s\"mean\": %.1f,\n", in, "", mean);
+  fprintf(out, "%*s\"max\": %lu,\n", in, "",
+          (unsigned long)atomic_load(&s->ack_latency_max_us));
+  fprintf(out, "%*s\"p50\": %lu,\n", in, "",
+          (unsigned long)latency_percentile(buckets, samples, 0.50));
+  fprintf(out, "%*s\"p90\": %lu,\n", in, "",
+          (unsigned long)latency_percentile(buckets, samples, 0.90));
+  fprintf(out, "%*s\"p99\": %lu,\n", in, "",
+          (unsigned long)latency_percentile(buckets, samples, 0.99));
+  fprintf(out, "%*s\"buckets\": [", in, "");
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    fprintf(out, "%lu%s", (unsigned long)buckets[i],
+            i + 1 < LATENCY_BUCKETS ? ", " : "");
+  }
+  fprintf(out, "]\n%*s}%s\n", ind + 2, "", count > 0 ? "," : "");
+
+  if (count > 0) {
+    fprintf(out, "%*s\"sessions\": [\n", ind + 2, "");
+    for (int i = 0; i < count; i++) {
+      fprintf(out, "%*s", in, "");
+      write_stats_object(&sessions[i], out, in, NULL, 0);
+      fprintf(out, "%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(out, "%*s]\n", ind + 2, "");
+  }
+  fprintf(out, "%*s}", ind, "");
+}
+
+// add the counters of a session to a total
+static void sum_stats(SessionStats *total, SessionStats *s) {
+  for (size_t i = 0; i < COUNTERS; i++) {
+    atomic_fetch_add(counter_at(total, i), atomic_load(counter_at(s, i)));
+  }
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    atomic_fetch_add(&total->ack_latency[i], atomic_load(&s->ack_latency[i]));
+  }
+  atomic_fetch_add(&total->ack_latency_sum_us,
+                   atomic_load(&s->ack_latency_sum_us));
+
+  uint64_t max = atomic_load(&s->ack_latency_max_us);
+  if (max > atomic_load(&total->ack_latency_max_us)) {
+    atomic_store(&total->ack_latency_max_us, max);
+  }
+}
+
+// write a snapshot of the counters as json, a striped transfer has the sum
+// of its sessions and the counters of each one
+void write_stats_json(SessionStats *s, FILE *out) {
+  int count = atomic_load(&export_session_count);
+  if (s != export_stats || count == 0) {
+    write_stats_object(s, out, 0, NULL, 0);
+  } else {
+    SessionStats total;
+    init_stats(&total);
+    total.start_us = s->start_us;
+    for (int i = 0; i < count; i++) {
+      sum_stats(&total, &export_sessions[i]);
+    }
+    write_stats_object(&total, out, 0, export_sessions, count);
+  }
+  fprintf(out, "\n");
+  fflush(out);
+}
+
+static void write_stats_to(FILE *file, void *data) {
+  write_stats_json((SessionStats *)data, file);
+}
+
+// the stats file is replaced, never rewritten in place
+static void write_stats_file(SessionStats *s, const char *path) {
+  if (replace_file(path, write_stats_to, s) != 0) {
+    LOG_MSG(LOG_WARNING, "write_stats_file(): can't write %s", path);
+  }
+}
+
+static void handle_dump(int sig) {
+  (void)sig;
+  dump_requested = 1;
+}
+
+// dump the stats on SIGUSR1 and write the stats file every period
+static void *stats_export_thread(void *arg) {
+  (void)arg;
+  struct timespec tick = {0, EXPORT_TICK_MS * 1000000L};
+  uint64_t next_write = stats_now_us();
+
+  while (atomic_load(&export_running)) {
+    if (dump_requested) {
+      dump_requested = 0;
+      write_stats_json(export_stats, stderr);
+    }
+
+    if (export_path != NULL && stats_now_us() >= next_write) {
+      write_stats_file(export_stats, export_path);
+      next_write += STATS_PERIOD * 1000000ULL;
+    }
+    nanosleep(&tick, NULL);
+  }
+  return NULL;
+}
+
+// start exporting the session stats, path is optional
+void start_stats_export(SessionStats *s, const char *path) {
+  export_stats = s;
+  export_path = path;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_dump;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &sa, NULL);
+
+  atomic_store(&export_running, 1);
+  if (pthread_create(&export_thread, NULL, stats_export_thread, NULL) != 0) {
+    LOG_MSG(LOG_WARNING, "start_stats_export(): thread creation failure");
+    atomic_store(&export_running, 0);
+  }
+}
+
+// counters for each session of a striped transfer, the exported stats
+// become their sum and they are freed by stop_stats_export
+SessionStats *alloc_session_stats(int count) {
+  SessionStats *sessions = malloc(count * sizeof(SessionStats));
+  if (sessions == NULL) {
+    return NULL;
+  }
+  for (int i = 0; i < count; i++) {
+    init_stats(&sessions[i]);
+  }
+
+  export_sessions = sessions;
+  atomic_store(&export_session_count, count);
+  return sessions;
+}
+
+// stop the export thread, the stats file gets the final counters
+void stop_stats_export(void) {
+  if (atomic_exchange(&export_running, 0)) {
+    pthread_join(export_thread, NULL);
+
+    if (export_path != NULL) {
+      write_stats_file(export_stats, export_path);
+    }
+  }
+
+  atomic_store(&export_session_count, 0);
+  free(export_sessions);
+  export_sessions = NULL;
+}
@@ -0,0 +1,158 @@
+#include "stripe.h"
+#include "logger.h"
+#include "network.h"
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// write a 64 bit integer in network order
+static void put_u64(char *buf, uint64_t value) {
+  for (int i = 7; i >= 0; i--) {
+    buf[i] = value & 0xFF;
+    value >>= 8;
+  }
+}
+
+// read a 64 bit integer in network order
+static uint64_t get_u64(const char *buf) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value = (value << 8) | (uint8_t)buf[i];
+  }
+  return value;
+}
+
+// init a striped transfer of the input, the output is written by offset
+// returns -1 if the input can't be read
+int init_stripe(Stripe *st, FILE *input, FILE *output) {
+  memset(st, 0, sizeof(*st));
+  st->in_fd = fileno(input);
+  st->out_fd = fileno(output);
+  pthread_mutex_init(&st->mutex, NULL);
+
+  // the manifest has the input size and hash
+  struct stat in_stat;
+  if (fstat(st->in_fd, &in_stat) != 0) {
+    LOG_MSG(LOG_ERROR, "init_stripe(): input stat failure");
+    return -1;
+  }
+  st->in_size = in_stat.st_size;
+
+  char *md5 = get_file_md5_str(st->in_fd);
+  if (md5 == NULL) {
+    LOG_MSG(LOG_ERROR, "init_stripe(): input hash failure");
+    return -1;
+  }
+  strncpy(st->in_md5, md5, MD5_STR_BYTES);
+  free(md5);
+
+  LOG_MSG(LOG_INFO, "init_stripe(): %lu bytes, md5 %s",
+          (unsigned long)st->in_size, st->in_md5);
+  return 0;
+}
+
+// fill the buffer with the next chunk to send, the manifest goes first
+// the sessions take chunks as they go, so a faster session sends more
+// returns the chunk size or 0 when the input is all taken
+size_t next_stripe_chunk(Stripe *st, char *buf, size_t buf_size) {
+  if (buf_size < STRIPE_MIN_PAYLOAD) {
+    LOG_MSG(LOG_ERROR, "next_stripe_chunk(): payload too small");
+    return 0;
+  }
+
+  // the first session to ask sends the manifest
+  if (atomic_exchange(&st->manifest_taken, 1) == 0) {
+    put_u64(buf, MANIFEST_OFFSET);
+    put_u64(buf + STRIPE_HEADER_BYTES, st->in_size);
+    memcpy(buf + STRIPE_HEADER_BYTES + 8, st->in_md5, MD5_STR_BYTES);
+    return MANIFEST_BYTES;
+  }
+
+  // take the next input range
+  size_t data_size = buf_size - STRIPE_HEADER_BYTES;
+  uint64_t offset = atomic_fetch_add(&st->next_offset, data_size);
+  if (offset >= st->in_size) {
+    return 0;
+  }
+  if (st->in_size - offset < data_size) {
+    data_size = st->in_size - offset;
+  }
+
+  ssize_t bytes_read =
+      pread(st->in_fd, buf + STRIPE_HEADER_BYTES, data_size, offset);
+  if (bytes_read != (ssize_t)data_size) {
+    LOG_MSG(LOG_ERROR, "next_stripe_chunk(): input read failure");
+    return 0;
+  }
+
+  put_u64(buf, offset);
+  return STRIPE_HEADER_BYTES + data_size;
+}
+
+// write a received chunk at its offset or keep the manifest
+// returns -1 for a malformed chunk
+int write_stripe_chunk(Stripe *st, const char *chunk, size_t chunk_size) {
+  if (chunk_size < STRIPE_HEADER_BYTES) {
+    LOG_MSG(LOG_ERROR, "write_stripe_chunk(): chunk without offset");
+    return -1;
+  }
+
+  uint64_t offset = get_u64(chunk);
+  const char *data = chunk + STRIPE_HEADER_BYTES;
+  size_t data_size = chunk_size - STRIPE_HEADER_BYTES;
+
+  // manifest of the peer input
+  if (offset == MANIFEST_OFFSET) {
+    if (chunk_size != MANIFEST_BYTES) {
+      LOG_MSG(LOG_ERROR, "write_stripe_chunk(): malformed manifest");
+      return -1;
+    }
+    pthread_mutex_lock(&st->mutex);
+    st->out_size = get_u64(data);
+    memcpy(st->out_md5, data + 8, MD5_STR_BYTES);
+    st->out_md5[MD5_STR_BYTES] = '\0';
+    st->have_manifest = 1;
+    pthread_mutex_unlock(&st->mutex);
+    LOG_MSG(LOG_INFO, "write_stripe_chunk(): manifest of %lu bytes",
+            (unsigned long)st->out_size);
+    return 0;
+  }
+
+  // positional writes don't need a lock
+  if (pwrite(st->out_fd, data, data_size, offset) != (ssize_t)data_size) {
+    log_exit("failed to write to output");
+  }
+  atomic_fetch_add(&st->bytes_written, data_size);
+  return 0;
+}
+
+// check the received output against the peer manifest
+// returns 0 if the size and the md5 hash match
+int check_stripe(Stripe *st) {
+  if (!st->have_manifest) {
+    fprintf(stderr, "stripe check failed: no manifest received\n");
+    return -1;
+  }
+
+  uint64_t written = atomic_load(&st->bytes_written);
+  if (written != st->out_size) {
+    fprintf(stderr, "stripe check failed: %lu of %lu bytes received\n",
+            (unsigned long)written, (unsigned long)st->out_size);
+    return -1;
+  }
+
+  char *md5 = get_file_md5_str(st->out_fd);
+  if (md5 == NULL || strcmp(md5, st->out_md5) != 0) {
+    fprintf(stderr, "stripe check failed: md5 %s != %s\n",
+            md5 != NULL ? md5 : "?", st->out_md5);
+    free(md5);
+    return -1;
+  }
+
+  printf("stripe check ok: %lu bytes, md5 %s\n", (unsigned long)written, md5);
+  free(md5);
+  return 0;
+}
+
+// destroy the stripe mutex
+void clean_stripe(Stripe *st) { pthread_mutex_destroy(&st->mutex); }
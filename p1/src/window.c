@@ -0,0 +1,182 @@
+#include "window.h"
+#include "logger.h"
+#include "messages.h"
+#include <string.h>
+
+// init an empty window of the given size, its frames take up to capacity
+// data bytes
+void init_window(Window *w, uint16_t size, size_t capacity) {
+  memset(w, 0, sizeof(*w));
+  w->size = size > MAX_WINDOW ? MAX_WINDOW : size;
+  w->capacity = capacity;
+  w->slots = 1;
+  while (w->slots < w->size) {
+    w->slots *= 2;
+  }
+
+  // buffers of the slots in use
+  for (uint16_t i = 0; i < w->slots && w->size > 0; i++) {
+    w->tx[i].frame = malloc(FRAME_HEADER_BYTES + capacity);
+    w->rx[i].data = malloc(capacity);
+    if (w->tx[i].frame == NULL || w->rx[i].data == NULL) {
+      log_exit("window allocation failure");
+    }
+  }
+}
+
+// free the slot buffers
+void free_window(Window *w) {
+  for (uint16_t i = 0; i < w->slots && w->size > 0; i++) {
+    free(w->tx[i].frame);
+    free(w->rx[i].data);
+  }
+  w->size = 0;
+}
+
+// check if the sender can't queue more frames
+int window_full(const Window *w) {
+  return (uint16_t)(w->tx_next - w->tx_base) >= w->size;
+}
+
+// sent frame slot of an id
+TxSlot *window_tx_slot(Window *w, uint16_t id) {
+  return &w->tx[id % w->slots];
+}
+
+// queue a data or end frame with the next id, it is due at once
+TxSlot *window_push(Window *w, uint8_t flags, const char *data,
+                    size_t data_size) {
+  uint16_t id = w->tx_next++;
+  TxSlot *slot = window_tx_slot(w, id);
+  slot->acked = 0;
+  slot->attempts = 0;
+  slot->fast_resent = 0;
+  slot->deadline_us = 0;
+  make_frame(slot->frame, id, flags, data, data_size, 0);
+  slot->size = FRAME_HEADER_BYTES + data_size;
+
+  if (flags == END_FLAG) {
+    w->tx_end_queued = 1;
+  }
+  return slot;
+}
+
+// mark a sent frame as acked
+static void ack_slot(TxSlot *slot, uint64_t now, SessionStats *stats) {
+  if (slot->acked) {
+    return;
+  }
+  slot->acked = 1;
+
+  // the ack of a resent frame can't be matched to one send
+  if (slot->attempts == 1) {
+    stats_ack_latency(stats, now - slot->sent_us);
+  }
+}
+
+// apply a selective ack, every id before cum_id is received and the bitmap
+// reports the received ids after it
+// frames missing behind DUP_THRESH acked frames are made due at once
+// returns 1 if the end and all the frames before it are acked
+int window_sack(Window *w, uint16_t cum_id, const uint8_t *bitmap,
+                size_t bitmap_size, SessionStats *stats) {
+  uint64_t now = stats_now_us();
+  uint16_t in_flight = w->tx_next - w->tx_base;
+
+  // ignore acks outside of the frames in flight
+  if ((uint16_t)(cum_id - w->tx_base) > in_flight) {
+    LOG_MSG(LOG_INFO, "window_sack(): old ack id %hu", cum_id);
+    return 0;
+  }
+
+  // cumulative part
+  while (w->tx_base != cum_id) {
+    ack_slot(window_tx_slot(w, w->tx_base), now, stats);
+    w->tx_base++;
+  }
+
+  // selective part, remember the last acked id
+  uint16_t last_acked = cum_id;
+  int any_acked = 0;
+  for (size_t i = 0; i < bitmap_size * 8; i++) {
+    uint16_t id = cum_id + 1 + i;
+    if ((uint16_t)(id - w->tx_base) >= (uint16_t)(w->tx_next - w->tx_base)) {
+      break;
+    }
+    if (bitmap[i / 8] & (1 << (i % 8))) {
+      ack_slot(window_tx_slot(w, id), now, stats);
+      last_acked = id;
+      any_acked = 1;
+    }
+  }
+
+  // frames left behind by later ones are lost, resend them now
+  if (any_acked) {
+    for (uint16_t id = w->tx_base; id != last_acked; id++) {
+      TxSlot *slot = window_tx_slot(w, id);
+      if (!slot->acked && !slot->fast_resent &&
+          (uint16_t)(last_acked - id) >= DUP_THRESH) {
+        slot->fast_resent = 1;
+        slot->deadline_us = 0;
+        STAT_INC(stats, fast_retransmissions);
+      }
+    }
+  }
+
+  return w->tx_end_queued && w->tx_base == w->tx_next;
+}
+
+// keep a received frame until the frames before it arrive
+// returns 1 for a new frame, 0 for a duplicate and -1 beyond the window
+int window_store(Window *w, uint16_t id, uint8_t flags, const char *data,
+                 size_t data_size) {
+  uint16_t offset = id - w->rx_next;
+
+  // already delivered
+  if (offset >= 0x8000) {
+    return 0;
+  }
+
+  // no room for it yet
+  if (offset >= w->size || data_size > w->capacity) {
+    return -1;
+  }
+
+  RxSlot *slot = &w->rx[id % w->slots];
+  if (slot->present) {
+    return 0;
+  }
+
+  memcpy(slot->data, data, data_size);
+  slot->size = data_size;
+  slot->flags = flags;
+  slot->present = 1;
+  return 1;
+}
+
+// next frame to be delivered in order, or NULL if it's missing
+RxSlot *window_next_in_order(Window *w) {
+  RxSlot *slot = &w->rx[w->rx_next % w->slots];
+  return slot->present ? slot : NULL;
+}
+
+// free the delivered frame and move to the next one
+void window_release(Window *w) {
+  w->rx[w->rx_next % w->slots].present = 0;
+  w->rx_next++;
+}
+
+// build the sack bitmap of the frames received after the missing one
+// returns the bitmap size
+size_t make_sack(const Window *w, uint8_t *bitmap) {
+  size_t bitmap_size = (w->size + 7) / 8;
+  memset(bitmap, 0, bitmap_size);
+
+  for (uint16_t i = 0; i + 1 < w->size; i++) {
+    uint16_t id = w->rx_next + 1 + i;
+    if (w->rx[id % w->slots].present) {
+      bitmap[i / 8] |= 1 << (i % 8);
+    }
+  }
+  return bitmap_size;
+}
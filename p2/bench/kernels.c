@@ -0,0 +1,171 @@
+// file:        kernels.c
+// description: microbenchmarks of the update parsing and route lookups
+#include "bench.h"
+#include "cJSON.h"
+#include "router.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// distances of the update msgs, the largest one fills a fragment
+static const int update_sizes[] = {16, 128, 200};
+
+// route table sizes
+static const int table_sizes[] = {1000, 10000, 100000};
+
+// neighbors the routes are learned from
+#define BENCH_NEIGHBORS 8
+
+// distances of the update merged into the table
+#define MERGED_DISTANCES 64
+
+// destinations looked up in a round
+#define LOOKUPS 1024
+
+typedef struct {
+  char *json;
+  cJSON *msg;
+  size_t size;
+  char dests[LOOKUPS][MAX_IP];
+} KernelCtx;
+
+static void dest_ip(char *ip, int i) {
+  snprintf(ip, MAX_IP, "10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff,
+           i & 0xff);
+}
+
+static void neighbor_ip(char *ip, int i) {
+  snprintf(ip, MAX_IP, "192.168.0.%d", i + 1);
+}
+
+// update msg from the first neighbor, with every step-th destination
+// a first fragment that isn't the last one, so routes are merged but the
+// obsolete ones are kept and the table size doesn't change
+static cJSON *make_update(int distances, int step) {
+  char ip[MAX_IP];
+  neighbor_ip(ip, 0);
+
+  cJSON *msg = cJSON_CreateObject();
+  cJSON_AddStringToObject(msg, "type", "update");
+  cJSON_AddStringToObject(msg, "source", ip);
+  cJSON_AddStringToObject(msg, "destination", "127.0.0.1");
+  cJSON_AddNumberToObject(msg, "update_id", 1);
+  cJSON_AddNumberToObject(msg, "seq", 0);
+  cJSON_AddBoolToObject(msg, "last", 0);
+
+  cJSON *dist = cJSON_CreateObject();
+  cJSON_AddNumberToObject(dist, ip, 1);
+  for (int i = 0; i < distances; i++) {
+    dest_ip(ip, i * step);
+    cJSON_AddNumberToObject(dist, ip, 1 + i % 16);
+  }
+  cJSON_AddItemToObject(msg, "distances", dist);
+  return msg;
+}
+
+// table of n routes spread over the neighbors
+static void fill_table(Router *rt, int n) {
+  for (int i = 0; i < BENCH_NEIGHBORS; i++) {
+    char ip[MAX_IP];
+    neighbor_ip(ip, i);
+    add_neighbor(rt, ip, 1);
+  }
+
+  for (int i = 0; rt->routes_count < n; i++) {
+    Route *route = &rt->routes[rt->routes_count++];
+    dest_ip(route->dest_ip, i);
+    neighbor_ip(route->via_ip, i % BENCH_NEIGHBORS);
+    route->cost = 2 + i % 16;
+    route->timestamp = 0;
+  }
+}
+
+static void bench_parse(void *arg, uint64_t iters) {
+  KernelCtx *ctx = (KernelCtx *)arg;
+  for (uint64_t i = 0; i < iters; i++) {
+    cJSON *msg = cJSON_Parse(ctx->json);
+    bench_sink((uintptr_t)msg);
+    cJSON_Delete(msg);
+  }
+}
+
+static void bench_print(void *arg, uint64_t iters) {
+  KernelCtx *ctx = (KernelCtx *)arg;
+  for (uint64_t i = 0; i < iters; i++) {
+    char *json = cJSON_PrintUnformatted(ctx->msg);
+    bench_sink(json[0]);
+    free(json);
+  }
+}
+
+static void bench_next_hop(void *arg, uint64_t iters) {
+  KernelCtx *ctx = (KernelCtx *)arg;
+  char via[MAX_IP];
+  uint64_t found = 0;
+  for (uint64_t i = 0; i < iters; i++) {
+    found += get_next_hop(&router, router.ip, ctx->dests[i % LOOKUPS], via) ==
+             0;
+  }
+  bench_sink(found);
+}
+
+static void bench_process_update(void *arg, uint64_t iters) {
+  KernelCtx *ctx = (KernelCtx *)arg;
+  for (uint64_t i = 0; i < iters; i++) {
+    process_update(&router, ctx->msg, ctx->size);
+  }
+  bench_sink(router.routes_count);
+}
+
+int main(int argc, char **argv) {
+  bench_init("p2", argc, argv);
+
+  static KernelCtx ctx;
+  for (size_t i = 0; i < sizeof(update_sizes) / sizeof(update_sizes[0]); i++) {
+    ctx.msg = make_update(update_sizes[i], 1);
+    ctx.json = cJSON_PrintUnformatted(ctx.msg);
+    ctx.size = strlen(ctx.json);
+
+    run_bench("cJSON_Parse", update_sizes[i], ctx.size, bench_parse, &ctx);
+    run_bench("cJSON_PrintUnformatted", update_sizes[i], ctx.size, bench_print,
+              &ctx);
+
+    free(ctx.json);
+    cJSON_Delete(ctx.msg);
+  }
+
+  for (size_t i = 0; i < sizeof(table_sizes) / sizeof(table_sizes[0]); i++) {
+    int n = table_sizes[i];
+    if (n > MAX_ROUTES - 1) {
+      fprintf(stderr, "bench: %d routes need MAX_ROUTES > %d\n", n, n);
+      continue;
+    }
+
+    init_router(&router, -1, "127.0.0.1", 1000);
+    fill_table(&router, n);
+
+    // lookups spread over the whole table
+    for (int j = 0; j < LOOKUPS; j++) {
+      dest_ip(ctx.dests[j], (int)((uint64_t)j * 7919 % (n - BENCH_NEIGHBORS)));
+    }
+    run_bench("get_next_hop", n, 0, bench_next_hop, &ctx);
+
+    // the merged destinations are spread over the table, all of them are
+    // learned from the first neighbor
+    int step = (n / MERGED_DISTANCES) / BENCH_NEIGHBORS * BENCH_NEIGHBORS;
+    ctx.msg = make_update(MERGED_DISTANCES, step);
+    ctx.json = cJSON_PrintUnformatted(ctx.msg);
+    ctx.size = strlen(ctx.json);
+    run_bench("process_update", n, ctx.size, bench_process_update, &ctx);
+    free(ctx.json);
+    cJSON_Delete(ctx.msg);
+
+    close(router.pipe_fd[0]);
+    close(router.pipe_fd[1]);
+    pthread_mutex_destroy(&router.router_mutex);
+    pthread_cond_destroy(&router.router_update_cond);
+  }
+
+  return 0;
+}
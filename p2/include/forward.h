@@ -0,0 +1,18 @@
+// file:        forward.h
+// description: definitions of the trace and data forwarding fast path,
+// messages are patched in their raw buffer instead of parsed and printed
+#ifndef FORWARD_H
+#define FORWARD_H
+
+#include "router.h"
+#include <stdlib.h>
+
+// extra buffer bytes needed to append this router to a trace msg
+#define FORWARD_HEADROOM (MAX_IP + 4)
+
+int get_msg_string(const char *buf, size_t len, const char *key, char *out,
+                   size_t out_size);
+int forward_trace(Router *rt, char *buf, size_t len, size_t buf_size);
+int forward_data(Router *rt, const char *buf, size_t len);
+
+#endif
@@ -3,6 +3,7 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include "log-ring.h"
 #include <stdarg.h>
 #include <stdio.h>
 
@@ -14,7 +15,34 @@ typedef enum {
   LOG_DISABLED,
 } LogLevel;
 
-#define LOG_MSG(level, fmt, ...) log_message(level, fmt, ##__VA_ARGS__)
+// levels below the threshold are compiled out, e.g. make LOG_MIN_LEVEL=LOG_ERROR
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_INFO
+#endif
+
+extern LogLevel current_log_level;
+
+// check if a level is logged, so costly log arguments are only built then
+#define LOG_ENABLED(level)                                                     \
+  ((level) >= LOG_MIN_LEVEL && (level) >= current_log_level)
+
+// the format must be a string literal, it is read after the call returns
+#define LOG_MSG(level, fmt, ...)                                               \
+  do {                                                                         \
+    if (LOG_ENABLED(level)) {                                                  \
+      log_message(level, fmt, ##__VA_ARGS__);                                  \
+    }                                                                          \
+  } while (0)
+
+// log a msg followed by a json item, it is only printed if the level is on
+#define LOG_JSON(level, msg, item)                                             \
+  do {                                                                         \
+    if (LOG_ENABLED(level)) {                                                  \
+      log_json(level, msg, item);                                              \
+    }                                                                          \
+  } while (0)
+
+struct cJSON;
 
 void log_exit(const char *msg);
 void usage(const char *program);
@@ -22,5 +50,7 @@ void set_log_level(LogLevel level);
 void set_log_file(FILE *file);
 char *get_log_file_name(const char *ip);
 void log_message(LogLevel level, const char *fmt, ...);
+void log_flush(void);
+void log_json(LogLevel level, const char *msg, const struct cJSON *item);
 
 #endif
@@ -0,0 +1,45 @@
+// file:        metrics.h
+// description: definitions of the router control plane metrics
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "cJSON.h"
+#include <stdint.h>
+
+// update inter-arrival histogram, bucket i counts gaps below 2^i ms
+#define INTERARRIVAL_BUCKETS 18
+
+// a convergence episode ends after this many update periods without changes
+#define CONVERGENCE_QUIET_PERIODS 3
+
+// control plane counters, protected by the router mutex
+typedef struct {
+  uint64_t start_ms;
+  uint64_t updates_sent;
+  uint64_t update_bytes_sent;
+  uint64_t update_send_failures;
+  uint64_t updates_received;
+  uint64_t update_bytes_received;
+  uint64_t hellos_sent;
+  uint64_t hellos_received;
+  uint64_t parse_failures;
+  uint64_t route_changes;
+  uint64_t last_change_ms;
+  uint64_t episode_start_ms;
+  uint64_t last_convergence_ms;
+} RouterMetrics;
+
+// updates received from a neighbor
+typedef struct {
+  uint64_t updates;
+  uint64_t last_arrival_ms;
+  uint32_t interarrival[INTERARRIVAL_BUCKETS];
+} ArrivalStats;
+
+void init_metrics(RouterMetrics *m, uint64_t now);
+void record_route_change(RouterMetrics *m, uint64_t now, int period_ms);
+void record_arrival(ArrivalStats *a, uint64_t now);
+cJSON *metrics_to_json(const RouterMetrics *m, uint64_t now);
+cJSON *arrival_to_json(const ArrivalStats *a);
+
+#endif
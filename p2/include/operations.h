@@ -7,6 +7,6 @@
 #include <stdio.h>
 
 void startup_router(Router *rt, FILE *startup_file);
-void execute_operations(int period);
+void execute_operations(int period_ms);
 
 #endif
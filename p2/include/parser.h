@@ -3,12 +3,18 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#define DEFAULT_DETECT_MULT 3
+
 // command line arguments
 typedef struct {
   char *addr_str;
   char *startup_file_name;
-  int period;
+  int period_ms;
   int debug_mode;
+  int hello_ms;
+  int detect_mult;
+  int recv_buf_size;
+  char *stats_file;
 } Params;
 
 // parse the command line arguments
@@ -5,50 +5,84 @@
 #define ROUTER_H
 
 #include "cJSON.h"
+#include "metrics.h"
 #include <pthread.h>
+#include <stdint.h>
 
 #define MAX_IP 64
 #define MAX_NEIGHBORS 1000
+// larger tables, e.g. for benchmarks, are set at build time
+#ifndef MAX_ROUTES
 #define MAX_ROUTES 5000
+#endif
+#define HELLO_MSG_SIZE (2 * MAX_IP + 96)
+
+// updates bigger than a fragment are split, fragments fit a 4096 bytes
+// buffer of routers that don't know about fragments
+#define UPDATE_FRAGMENT_BYTES 4000
+#define UPDATE_HEADER_BYTES 256
+#define DEFAULT_RECV_BUF_SIZE 65536
 
 typedef struct {
   char ip[MAX_IP];
   int weight;
-  time_t last_update;
+  uint64_t last_update;
+  uint64_t last_hello;
+  int hello_capable;
+  int hello_ms;
+  int update_id;
+  int next_seq;
+  uint64_t update_start;
+  ArrivalStats arrivals;
 } Neighbor;
 
 typedef struct {
   char dest_ip[MAX_IP];
   char via_ip[MAX_IP];
   int cost;
-  time_t timestamp;
+  uint64_t timestamp;
 } Route;
 
 typedef struct {
   int sock_fd;
   int pipe_fd[2];
   char ip[MAX_IP];
-  int period;
+  int period_ms;
+  int hello_ms;
+  int detect_mult;
+  int update_id;
+  int recv_buf_size;
+  const char *stats_file;
   int operating;
   int neighbors_count;
   int routes_count;
   Neighbor neighbors[MAX_NEIGHBORS];
   Route routes[MAX_ROUTES];
+  RouterMetrics metrics;
   pthread_mutex_t router_mutex;
   pthread_cond_t router_update_cond;
 } Router;
 
 extern Router router;
 
-void init_router(Router *rt, int sock_fd, const char *ip, int period);
+void init_router(Router *rt, int sock_fd, const char *ip, int period_ms);
+void set_hello(Router *rt, int hello_ms, int detect_mult);
 void add_neighbor(Router *rt, const char *ip, int weight);
 void del_neighbor(Router *rt, const char *ip);
+int get_next_hop(Router *rt, const char *source, const char *dest_ip,
+                 char *via_ip);
 void send_trace(Router *rt, const char *dest_ip);
 void process_trace(Router *rt, cJSON *msg);
 void process_data(Router *rt, cJSON *msg);
 void send_update(Router *rt);
-void process_update(Router *rt, cJSON *msg);
+void process_update(Router *rt, cJSON *msg, size_t msg_size);
+void send_hello(Router *rt);
+void process_hello(Router *rt, cJSON *msg);
 void check_timeouts(Router *rt);
 void print_info(Router *rt);
+void count_parse_failure(Router *rt);
+cJSON *get_stats(Router *rt);
+void print_stats(Router *rt);
+void write_stats_file(Router *rt, const char *path);
 
 #endif
@@ -0,0 +1,12 @@
+// file:        timer.h
+// description: definitions of monotonic millisecond timer helpers
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <time.h>
+
+uint64_t now_ms(void);
+void ms_to_timespec(uint64_t abs_ms, struct timespec *ts);
+
+#endif
@@ -0,0 +1,288 @@
+// file:        forward.c
+// description: implementation of the trace and data forwarding fast path
+#include "forward.h"
+#include "logger.h"
+#include "network.h"
+#include <string.h>
+
+// raw json span [start, end)
+typedef struct {
+  const char *start;
+  const char *end;
+} Span;
+
+// skip blank chars
+static const char *skip_ws(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+    p++;
+  }
+  return p;
+}
+
+// skip a string starting at the opening quote, returns NULL if not closed
+static const char *skip_string(const char *p, const char *end) {
+  for (p++; p < end; p++) {
+    if (*p == '\\') {
+      p++;
+    } else if (*p == '"') {
+      return p + 1;
+    }
+  }
+  return NULL;
+}
+
+// skip any json value, returns NULL if it is malformed
+static const char *skip_value(const char *p, const char *end) {
+  if (p >= end) {
+    return NULL;
+  }
+
+  // string
+  if (*p == '"') {
+    return skip_string(p, end);
+  }
+
+  // object or array, only the nesting matters here
+  if (*p == '{' || *p == '[') {
+    int depth = 0;
+    while (p < end) {
+      if (*p == '"') {
+        p = skip_string(p, end);
+        if (p == NULL) {
+          return NULL;
+        }
+        continue;
+      }
+      if (*p == '{' || *p == '[') {
+        depth++;
+      } else if (*p == '}' || *p == ']') {
+        if (--depth == 0) {
+          return p + 1;
+        }
+      }
+      p++;
+    }
+    return NULL;
+  }
+
+  // number, true, false or null
+  while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' &&
+         *p != '\t' && *p != '\n' && *p != '\r') {
+    p++;
+  }
+  return p;
+}
+
+// find a member of the object spanned by obj, nested members are skipped
+static int find_member(Span obj, const char *key, Span *value) {
+  size_t key_len = strlen(key);
+  const char *p = skip_ws(obj.start, obj.end);
+  if (p >= obj.end || *p != '{') {
+    return -1;
+  }
+  p++;
+
+  while (1) {
+    p = skip_ws(p, obj.end);
+    if (p >= obj.end || *p != '"') {
+      return -1;
+    }
+
+    // member name
+    const char *name = p + 1;
+    p = skip_string(p, obj.end);
+    if (p == NULL) {
+      return -1;
+    }
+    size_t name_len = p - 1 - name;
+
+    p = skip_ws(p, obj.end);
+    if (p >= obj.end || *p != ':') {
+      return -1;
+    }
+    p = skip_ws(p + 1, obj.end);
+
+    // member value
+    const char *val_end = skip_value(p, obj.end);
+    if (val_end == NULL) {
+      return -1;
+    }
+
+    if (name_len == key_len && memcmp(name, key, key_len) == 0) {
+      value->start = p;
+      value->end = val_end;
+      return 0;
+    }
+
+    p = skip_ws(val_end, obj.end);
+    if (p >= obj.end || *p != ',') {
+      return -1;
+    }
+    p++;
+  }
+}
+
+// copy a string value without its quotes, escaped strings are not handled
+static int copy_string(Span value, char *out, size_t out_size) {
+  if (value.end - value.start < 2 || *value.start != '"') {
+    return -1;
+  }
+
+  size_t len = value.end - value.start - 2;
+  if (len >= out_size || memchr(value.start + 1, '\\', len) != NULL) {
+    return -1;
+  }
+
+  memcpy(out, value.start + 1, len);
+  out[len] = '\0';
+  return 0;
+}
+
+// check if a string value is equal to str
+static int string_equals(Span value, const char *str) {
+  size_t len = strlen(str);
+  return (size_t)(value.end - value.start) == len + 2 &&
+         memcmp(value.start + 1, str, len) == 0;
+}
+
+// get a top level string member of a raw json msg
+int get_msg_string(const char *buf, size_t len, const char *key, char *out,
+                   size_t out_size) {
+  Span msg = {buf, buf + len};
+  Span value;
+
+  if (find_member(msg, key, &value) != 0) {
+    return -1;
+  }
+  return copy_string(value, out, out_size);
+}
+
+// append this router to the trace routers list and send it to the next hop
+int forward_trace(Router *rt, char *buf, size_t len, size_t buf_size) {
+  Span msg = {buf, buf + len};
+  Span value;
+
+  // the final destination builds a reply, that needs the full message
+  char dest[MAX_IP];
+  if (find_member(msg, "destination", &value) != 0 ||
+      copy_string(value, dest, sizeof(dest)) != 0 ||
+      strcmp(dest, rt->ip) == 0) {
+    return -1;
+  }
+
+  // the source and destination identify the flow
+  char source[MAX_IP];
+  if (find_member(msg, "source", &value) != 0 ||
+      copy_string(value, source, sizeof(source)) != 0) {
+    return -1;
+  }
+
+  // locate the end of the routers list
+  if (find_member(msg, "routers", &value) != 0 || *value.start != '[') {
+    return -1;
+  }
+  char *close = (char *)value.end - 1;
+  const char *last = value.end - 2;
+  while (last > value.start &&
+         (*last == ' ' || *last == '\t' || *last == '\n' || *last == '\r')) {
+    last--;
+  }
+  int empty = last == value.start;
+
+  // patch this router in place before the closing bracket
+  char entry[MAX_IP + 4];
+  int entry_len = snprintf(entry, sizeof(entry), "%s\"%s\"", empty ? "" : ",",
+                           rt->ip);
+  if (len + entry_len + 1 > buf_size) {
+    return -1;
+  }
+  memmove(close + entry_len, close, buf + len - close);
+  memcpy(close, entry, entry_len);
+  len += entry_len;
+  buf[len] = '\0';
+
+  // foward the patched msg, equal cost paths are picked per flow
+  char via_ip[MAX_IP];
+  if (get_next_hop(rt, source, dest, via_ip) != 0) {
+    LOG_MSG(LOG_INFO, "forward_trace(): msg not fowarded, no route to %s",
+            dest);
+    return 0;
+  }
+
+  if (send_packet(rt->sock_fd, via_ip, buf, len) == -1) {
+    LOG_MSG(LOG_INFO, "forward_trace(): msg not fowarded\n%s", buf);
+  } else {
+    LOG_MSG(LOG_INFO, "forward_trace(): msg fowarded\n%s", buf);
+  }
+  return 0;
+}
+
+// send a data msg back to the router before this one in the trace list
+int forward_data(Router *rt, const char *buf, size_t len) {
+  Span msg = {buf, buf + len};
+  Span value;
+
+  // the final destination prints the payload, that needs the full message
+  char dest[MAX_IP];
+  if (find_member(msg, "destination", &value) != 0 ||
+      copy_string(value, dest, sizeof(dest)) != 0 ||
+      strcmp(dest, rt->ip) == 0) {
+    return -1;
+  }
+
+  // routers list of the trace in the payload
+  Span routers;
+  if (find_member(msg, "payload", &value) != 0 ||
+      find_member(value, "routers", &routers) != 0 ||
+      *routers.start != '[') {
+    return -1;
+  }
+
+  // find the router before the last occurrence of this one
+  Span prev = {NULL, NULL};
+  Span back = {NULL, NULL};
+  int found = 0;
+  const char *p = routers.start + 1;
+  while (1) {
+    p = skip_ws(p, routers.end);
+    if (p >= routers.end || *p == ']') {
+      break;
+    }
+
+    Span curr = {p, skip_value(p, routers.end)};
+    if (curr.end == NULL) {
+      return -1;
+    }
+
+    if (string_equals(curr, rt->ip)) {
+      found = 1;
+      back = prev;
+    }
+    prev = curr;
+
+    p = skip_ws(curr.end, routers.end);
+    if (p < routers.end && *p == ',') {
+      p++;
+    }
+  }
+
+  if (!found || back.start == NULL) {
+    LOG_MSG(LOG_ERROR, "forward_data(): no router to foward back");
+    return 0;
+  }
+
+  char prev_ip[MAX_IP];
+  if (copy_string(back, prev_ip, sizeof(prev_ip)) != 0) {
+    return -1;
+  }
+
+  // the msg is fowarded back untouched
+  if (send_packet(rt->sock_fd, prev_ip, buf, len) == -1) {
+    LOG_MSG(LOG_INFO, "forward_data(): data not fowarded back\n%.*s", (int)len,
+            buf);
+  } else {
+    LOG_MSG(LOG_INFO, "forward_data(): data fowarded back\n%.*s", (int)len,
+            buf);
+  }
+  return 0;
+}
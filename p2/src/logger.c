@@ -1,16 +1,15 @@
 // file:        logger.c
 // fescription: definitions for useful loggers
 #include "logger.h"
+#include "cJSON.h"
 #include <stdlib.h>
 #include <string.h>
 
-// logger variables
-static LogLevel current_level = LOG_DISABLED;
-static FILE *log_file = NULL;
-
 // correct program usage
 void usage(const char *program) {
-  printf("Usage: %s <address> <period> [startup]\n", program);
+  printf("Usage: %s <address> <period> [startup] [-d] [--hello <interval>] "
+         "[--detect <multiplier>] [--bufsize <bytes>] [--stats <file>]\n",
+         program);
   exit(EXIT_FAILURE);
 }
 
@@ -34,9 +33,37 @@ static const char *get_level_str(LogLevel level) {
   }
 }
 
+LogLevel current_log_level = LOG_DISABLED;
+
+// stop the drain thread and write the pending events
+void log_flush(void) { log_ring_flush(); }
+
+// record the log if the current level can be shown
+void log_message(LogLevel level, const char *fmt, ...) {
+  // only log allowed levels
+  if (level < current_log_level) {
+    return;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  log_ring_write(get_level_str(level), fmt, &args);
+  va_end(args);
+}
+
+// log a msg followed by a pretty printed json item
+void log_json(LogLevel level, const char *msg, const struct cJSON *item) {
+  char *json = cJSON_Print(item);
+  if (json == NULL) {
+    return;
+  }
+  log_message(level, "%s\n%s", msg, json);
+  free(json);
+}
+
 // logger setters
-void set_log_level(LogLevel level) { current_level = level; }
-void set_log_file(FILE *file) { log_file = file; }
+void set_log_level(LogLevel level) { current_log_level = level; }
+void set_log_file(FILE *file) { log_ring_set_file(file); }
 
 char *get_log_file_name(const char *ip) {
   char *folder = "logs/";
@@ -51,23 +78,3 @@ char *get_log_file_name(const char *ip) {
   return file_name;
 }
 
-// print the log if the current level can be shown
-void log_message(LogLevel level, const char *fmt, ...) {
-  // only log allowed levels
-  if (level < current_level) {
-    return;
-  }
-
-  // default log file
-  if (log_file == NULL) {
-    log_file = stderr;
-  }
-
-  // print formated string
-  va_list args;
-  va_start(args, fmt);
-  fprintf(log_file, "%s: ", get_level_str(level));
-  vfprintf(log_file, fmt, args);
-  fprintf(log_file, "\n");
-  va_end(args);
-}
@@ -31,7 +31,10 @@ int main(int argc, char **argv) {
           p.addr_str);
 
   // initialize router
-  init_router(&router, sock_fd, p.addr_str, p.period);
+  init_router(&router, sock_fd, p.addr_str, p.period_ms);
+  set_hello(&router, p.hello_ms, p.detect_mult);
+  router.recv_buf_size = p.recv_buf_size;
+  router.stats_file = p.stats_file;
   LOG_MSG(LOG_INFO, "main(): router initialized");
 
   // read from startup file
@@ -48,11 +51,13 @@ int main(int argc, char **argv) {
   }
 
   // program operations executed until quit command
-  execute_operations(p.period);
+  execute_operations(p.period_ms);
   LOG_MSG(LOG_INFO, "main(): operations finished");
 
-  // clean before exit
+  // clean before exit, pending logs are written before the file is closed
   if (log_file != NULL) {
+    log_flush();
+    set_log_file(NULL);
     fclose(log_file);
   }
 
@@ -0,0 +1,76 @@
+// file:        metrics.c
+// description: implementation of the router control plane metrics
+#include "metrics.h"
+#include <string.h>
+
+// reset all the counters
+void init_metrics(RouterMetrics *m, uint64_t now) {
+  memset(m, 0, sizeof(*m));
+  m->start_ms = now;
+}
+
+// count a route added, removed or with a new cost
+// changes close in time are one convergence episode, measured from the
+// first change to the last
+void record_route_change(RouterMetrics *m, uint64_t now, int period_ms) {
+  uint64_t quiet = (uint64_t)CONVERGENCE_QUIET_PERIODS * period_ms;
+  if (m->route_changes == 0 || now - m->last_change_ms > quiet) {
+    m->episode_start_ms = now;
+  }
+
+  m->route_changes++;
+  m->last_change_ms = now;
+  m->last_convergence_ms = now - m->episode_start_ms;
+}
+
+// count an update and the gap since the previous one
+void record_arrival(ArrivalStats *a, uint64_t now) {
+  if (a->updates > 0) {
+    uint64_t gap = now - a->last_arrival_ms;
+    int bucket = 0;
+    while (bucket < INTERARRIVAL_BUCKETS - 1 && (1ULL << bucket) <= gap) {
+      bucket++;
+    }
+    a->interarrival[bucket]++;
+  }
+
+  a->updates++;
+  a->last_arrival_ms = now;
+}
+
+// counters and convergence times as a json object
+cJSON *metrics_to_json(const RouterMetrics *m, uint64_t now) {
+  cJSON *obj = cJSON_CreateObject();
+  cJSON_AddNumberToObject(obj, "uptime_ms", now - m->start_ms);
+  cJSON_AddNumberToObject(obj, "updates_sent", m->updates_sent);
+  cJSON_AddNumberToObject(obj, "update_bytes_sent", m->update_bytes_sent);
+  cJSON_AddNumberToObject(obj, "update_send_failures",
+                          m->update_send_failures);
+  cJSON_AddNumberToObject(obj, "updates_received", m->updates_received);
+  cJSON_AddNumberToObject(obj, "update_bytes_received",
+                          m->update_bytes_received);
+  cJSON_AddNumberToObject(obj, "hellos_sent", m->hellos_sent);
+  cJSON_AddNumberToObject(obj, "hellos_received", m->hellos_received);
+  cJSON_AddNumberToObject(obj, "parse_failures", m->parse_failures);
+  cJSON_AddNumberToObject(obj, "route_changes", m->route_changes);
+
+  // no change yet, the table is as converged as it was at start
+  uint64_t last_change = m->route_changes > 0 ? m->last_change_ms : m->start_ms;
+  cJSON_AddNumberToObject(obj, "ms_since_last_change", now - last_change);
+  cJSON_AddNumberToObject(obj, "last_convergence_ms", m->last_convergence_ms);
+  return obj;
+}
+
+// update arrivals of a neighbor as a json object
+cJSON *arrival_to_json(const ArrivalStats *a) {
+  cJSON *obj = cJSON_CreateObject();
+  cJSON_AddNumberToObject(obj, "updates", a->updates);
+
+  // bucket i counts gaps below 2^i ms
+  cJSON *buckets = cJSON_CreateArray();
+  for (int i = 0; i < INTERARRIVAL_BUCKETS; i++) {
+    cJSON_AddItemToArray(buckets, cJSON_CreateNumber(a->interarrival[i]));
+  }
+  cJSON_AddItemToObject(obj, "interarrival_ms_log2", buckets);
+  return obj;
+}
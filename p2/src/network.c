@@ -105,10 +105,8 @@ int send_packet(int fd, const char *dest_ip, const char *msg, size_t msg_size) {
 }
 
 // try to receive a packet
-int receive_packet(int fd, int pipe_fd[2], char *msg, size_t msg_size) {
-  // init buffer
-  memset(msg, 0, msg_size);
-
+int receive_packet(int fd, int pipe_fd[2], char *msg, size_t msg_size,
+                   int timeout_ms) {
   // sender addr
   struct sockaddr_storage storage;
   struct sockaddr *addr = (struct sockaddr *)&storage;
@@ -123,8 +121,8 @@ int receive_packet(int fd, int pipe_fd[2], char *msg, size_t msg_size) {
   int maxfd = (fd > pipe_fd[0]) ? fd : pipe_fd[0];
 
   struct timeval timeout;
-  timeout.tv_sec = TIMEOUT;
-  timeout.tv_usec = 0;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_usec = (timeout_ms % 1000) * 1000;
 
   int retval = select(maxfd + 1, &readfds, NULL, NULL, &timeout);
   // socket not ready
@@ -141,12 +139,21 @@ int receive_packet(int fd, int pipe_fd[2], char *msg, size_t msg_size) {
 
   // data available from network
   if (FD_ISSET(fd, &readfds)) {
-    ssize_t bytes_count = recvfrom(fd, msg, msg_size, 0, addr, &len);
+    // MSG_TRUNC returns the real datagram size, even if it didn't fit
+    ssize_t bytes_count = recvfrom(fd, msg, msg_size, MSG_TRUNC, addr, &len);
 
     if (bytes_count <= 0) {
       return -1;
     }
 
+    // a truncated msg can't be parsed
+    if ((size_t)bytes_count >= msg_size) {
+      LOG_MSG(LOG_WARNING, "receive_packet(): %ld bytes msg truncated",
+              bytes_count);
+      return -1;
+    }
+
+    msg[bytes_count] = '\0';
     return bytes_count;
   }
 
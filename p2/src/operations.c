@@ -2,16 +2,20 @@
 // description: implementation of program main operations
 #include "operations.h"
 #include "cJSON.h"
+#include "forward.h"
 #include "logger.h"
 #include "network.h"
 #include "router.h"
+#include "timer.h"
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #define MAX_INPUT 256
-#define MAX_MSG 4096
+#define MAX_RECV_WAIT_MS 1000
+#define MAX_TYPE 16
 
 void startup_router(Router *rt, FILE *startup_file) {
   char line[MAX_INPUT];
@@ -61,8 +65,8 @@ static void *read_input_thread() {
         // wake up select function in receiver thread
         write(router.pipe_fd[1], "x", 1);
 
-        // wake up update thread
-        pthread_cond_signal(&router.router_update_cond);
+        // wake up update and hello threads
+        pthread_cond_broadcast(&router.router_update_cond);
         pthread_mutex_unlock(&router.router_mutex);
       }
 
@@ -94,6 +98,12 @@ static void *read_input_thread() {
         LOG_MSG(LOG_INFO, "read_input_thread(): print cmd");
         print_info(&router);
       }
+
+      // control plane metrics
+      else if (strncmp(cmd, "stats", 5) == 0) {
+        LOG_MSG(LOG_INFO, "read_input_thread(): stats cmd");
+        print_stats(&router);
+      }
     }
   }
 
@@ -104,27 +114,35 @@ static void *read_input_thread() {
 // thread to periodicaly send updated routes to neighbors
 static void *send_update_thread(void *arg) {
   LOG_MSG(LOG_INFO, "send_update_thread(): start");
-  int *period = (int *)arg;
+  int *period_ms = (int *)arg;
+
+  // updates are scheduled on fixed deadlines so send time doesn't drift
+  uint64_t deadline = now_ms();
 
   while (1) {
-    time_t before = time(NULL);
     pthread_mutex_lock(&router.router_mutex);
     if (router.operating == 0) {
       pthread_mutex_unlock(&router.router_mutex);
       break;
     }
     pthread_mutex_unlock(&router.router_mutex);
-    time_t after = time(NULL);
 
     send_update(&router);
+    if (router.stats_file != NULL) {
+      write_stats_file(&router, router.stats_file);
+    }
+
+    // next deadline, skip the missed ones if the router fell behind
+    deadline += *period_ms;
+    uint64_t now = now_ms();
+    if (deadline < now) {
+      deadline = now;
+    }
 
     pthread_mutex_lock(&router.router_mutex);
-    int diff = (int)difftime(after, before);
-    if (*period > diff) {
+    if (router.operating > 0 && deadline > now) {
       struct timespec ts;
-      clock_gettime(CLOCK_REALTIME, &ts);
-      ts.tv_sec += (*period - diff);
-
+      ms_to_timespec(deadline, &ts);
       pthread_cond_timedwait(&router.router_update_cond, &router.router_mutex,
                              &ts);
     }
@@ -135,10 +153,61 @@ static void *send_update_thread(void *arg) {
   return NULL;
 }
 
+// thread to periodicaly send hellos to neighbors, faster than updates
+static void *send_hello_thread() {
+  LOG_MSG(LOG_INFO, "send_hello_thread(): start");
+
+  uint64_t deadline = now_ms();
+
+  while (1) {
+    pthread_mutex_lock(&router.router_mutex);
+    if (router.operating == 0) {
+      pthread_mutex_unlock(&router.router_mutex);
+      break;
+    }
+    pthread_mutex_unlock(&router.router_mutex);
+
+    send_hello(&router);
+
+    // next deadline, skip the missed ones if the router fell behind
+    deadline += router.hello_ms;
+    uint64_t now = now_ms();
+    if (deadline < now) {
+      deadline = now;
+    }
+
+    pthread_mutex_lock(&router.router_mutex);
+    if (router.operating > 0 && deadline > now) {
+      struct timespec ts;
+      ms_to_timespec(deadline, &ts);
+      pthread_cond_timedwait(&router.router_update_cond, &router.router_mutex,
+                             &ts);
+    }
+    pthread_mutex_unlock(&router.router_mutex);
+  }
+
+  LOG_MSG(LOG_INFO, "send_hello_thread(): stop");
+  return NULL;
+}
+
 // thread to receive and process json messages
 static void *receive_msg_thread() {
   LOG_MSG(LOG_INFO, "receive_msg_thread(): start");
 
+  // wake up at least once per period to check the neighbors timeouts
+  int timeout_ms = router.period_ms < MAX_RECV_WAIT_MS ? router.period_ms
+                                                       : MAX_RECV_WAIT_MS;
+  if (router.hello_ms > 0 && router.hello_ms < timeout_ms) {
+    timeout_ms = router.hello_ms;
+  }
+
+  // extra room to patch a fowarded trace in place
+  size_t buf_size = router.recv_buf_size + FORWARD_HEADROOM;
+  char *buf = malloc(buf_size);
+  if (buf == NULL) {
+    log_exit("receive buffer failure");
+  }
+
   while (1) {
     check_timeouts(&router);
 
@@ -149,55 +218,95 @@ static void *receive_msg_thread() {
     }
     pthread_mutex_unlock(&router.router_mutex);
 
-    char buf[MAX_MSG];
-    int bytes_received =
-        receive_packet(router.sock_fd, router.pipe_fd, buf, MAX_MSG);
+    int bytes_received = receive_packet(router.sock_fd, router.pipe_fd, buf,
+                                        router.recv_buf_size, timeout_ms);
 
     if (bytes_received < 0) {
       LOG_MSG(LOG_WARNING, "receive_thread(): no bytes received");
       continue;
-    } else {
-      cJSON *msg = cJSON_Parse(buf);
-      if (!msg) {
-        LOG_MSG(LOG_WARNING, "receive_thread(): json parse failed");
+    }
+
+    // fowarded msgs only need a few fields, so they skip the full parsing
+    char type[MAX_TYPE];
+    if (get_msg_string(buf, bytes_received, "type", type, sizeof(type)) == 0) {
+      if (strcmp(type, "trace") == 0 &&
+          forward_trace(&router, buf, bytes_received, buf_size) == 0) {
+        LOG_MSG(LOG_INFO, "receive_thread(): trace fowarded");
         continue;
       }
 
-      const char *type = cJSON_GetObjectItem(msg, "type")->valuestring;
-
-      // update msg
-      if (strcmp(type, "update") == 0) {
-        LOG_MSG(LOG_INFO, "receive_thread(): received update");
-        process_update(&router, msg);
+      if (strcmp(type, "data") == 0 &&
+          forward_data(&router, buf, bytes_received) == 0) {
+        LOG_MSG(LOG_INFO, "receive_thread(): data fowarded");
+        continue;
       }
+    }
 
-      else if (strcmp(type, "trace") == 0) {
-        LOG_MSG(LOG_INFO, "receive_thread(): received trace");
-        process_trace(&router, msg);
-      }
+    cJSON *msg = cJSON_ParseWithLength(buf, bytes_received);
+    if (!msg) {
+      count_parse_failure(&router);
+      LOG_MSG(LOG_WARNING, "receive_thread(): json parse failed");
+      continue;
+    }
 
-      else if (strcmp(type, "data") == 0) {
-        LOG_MSG(LOG_INFO, "receive_thread(): received data");
-        process_data(&router, msg);
-      }
+    cJSON *type_item = cJSON_GetObjectItem(msg, "type");
+    if (!cJSON_IsString(type_item)) {
+      count_parse_failure(&router);
+      LOG_MSG(LOG_WARNING, "receive_thread(): msg without type");
+      cJSON_Delete(msg);
+      continue;
+    }
+    const char *msg_type = type_item->valuestring;
+
+    // hello msg
+    if (strcmp(msg_type, "hello") == 0) {
+      process_hello(&router, msg);
+    }
+
+    // update msg
+    else if (strcmp(msg_type, "update") == 0) {
+      LOG_MSG(LOG_INFO, "receive_thread(): received update");
+      process_update(&router, msg, bytes_received);
+    }
+
+    else if (strcmp(msg_type, "trace") == 0) {
+      LOG_MSG(LOG_INFO, "receive_thread(): received trace");
+      process_trace(&router, msg);
+    }
+
+    else if (strcmp(msg_type, "data") == 0) {
+      LOG_MSG(LOG_INFO, "receive_thread(): received data");
+      process_data(&router, msg);
     }
+
+    cJSON_Delete(msg);
   }
 
+  free(buf);
   LOG_MSG(LOG_INFO, "receive_msg_thread(): stop");
   return NULL;
 }
 
-void execute_operations(int period) {
+void execute_operations(int period_ms) {
   // declare threads
-  pthread_t input_t, update_t, receive_t;
+  pthread_t input_t, update_t, receive_t, hello_t;
 
   // init threads
   pthread_create(&input_t, NULL, read_input_thread, NULL);
-  pthread_create(&update_t, NULL, send_update_thread, &period);
+  pthread_create(&update_t, NULL, send_update_thread, &period_ms);
   pthread_create(&receive_t, NULL, receive_msg_thread, NULL);
 
+  // hello protocol is optional
+  int hello_enabled = router.hello_ms > 0;
+  if (hello_enabled) {
+    pthread_create(&hello_t, NULL, send_hello_thread, NULL);
+  }
+
   // wait for threads result
   pthread_join(input_t, NULL);
   pthread_join(update_t, NULL);
   pthread_join(receive_t, NULL);
+  if (hello_enabled) {
+    pthread_join(hello_t, NULL);
+  }
 }
@@ -2,30 +2,105 @@
 // description: implementation of command line arguments parser
 #include "parser.h"
 #include "logger.h"
+#include "router.h"
+#include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
+// convert a time in seconds, fractions allowed (e.g. 0.1), to milliseconds
+// returns -1 if it isn't a number or it's out of range
+static int parse_seconds_ms(const char *str) {
+  char *end;
+  errno = 0;
+  double seconds = strtod(str, &end);
+  if (errno != 0 || end == str || *end != '\0' || !(seconds > 0) ||
+      seconds * 1000 > INT_MAX) {
+    return -1;
+  }
+  return (int)(seconds * 1000);
+}
+
+// convert a positive integer
+// returns -1 if it isn't a number or it's out of range
+static int parse_positive_int(const char *str) {
+  char *end;
+  errno = 0;
+  long value = strtol(str, &end, 10);
+  if (errno != 0 || end == str || *end != '\0' || value <= 0 ||
+      value > INT_MAX) {
+    return -1;
+  }
+  return (int)value;
+}
+
 // parse command line arguments and return them
 Params parse_args(int argc, char **argv) {
   // min arguments expected
-  if (argc < 3 || argc >= 6) {
+  if (argc < 3) {
     usage(argv[0]);
   }
 
   // params initialization
   Params p;
   p.addr_str = argv[1];
-  p.period = atoi(argv[2]);
+  p.period_ms = parse_seconds_ms(argv[2]);
   p.startup_file_name = NULL;
   p.debug_mode = 0;
+  p.hello_ms = 0;
+  p.detect_mult = DEFAULT_DETECT_MULT;
+  p.recv_buf_size = DEFAULT_RECV_BUF_SIZE;
+  p.stats_file = NULL;
 
-  // optional params
-  if (argc >= 4) {
-    p.startup_file_name = argv[3];
+  if (p.period_ms <= 0) {
+    usage(argv[0]);
+  }
 
-    if (argc == 5 && (strcmp(argv[4], "-d") == 0)) {
+  // optional params
+  for (int i = 3; i < argc; i++) {
+    // debug mode
+    if (strcmp(argv[i], "-d") == 0) {
       p.debug_mode = 1;
     }
+
+    // hello interval in seconds
+    else if (strcmp(argv[i], "--hello") == 0 && i + 1 < argc) {
+      p.hello_ms = parse_seconds_ms(argv[++i]);
+      if (p.hello_ms <= 0) {
+        usage(argv[0]);
+      }
+    }
+
+    // missed hellos before a neighbor is declared down
+    else if (strcmp(argv[i], "--detect") == 0 && i + 1 < argc) {
+      p.detect_mult = parse_positive_int(argv[++i]);
+      if (p.detect_mult <= 0) {
+        usage(argv[0]);
+      }
+    }
+
+    // receive buffer size in bytes
+    else if (strcmp(argv[i], "--bufsize") == 0 && i + 1 < argc) {
+      p.recv_buf_size = parse_positive_int(argv[++i]);
+      if (p.recv_buf_size <= 0) {
+        usage(argv[0]);
+      }
+    }
+
+    // stats file, rewritten every update period
+    else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      p.stats_file = argv[++i];
+    }
+
+    // startup file
+    else if (p.startup_file_name == NULL && argv[i][0] != '-') {
+      p.startup_file_name = argv[i];
+    }
+
+    // invalid param
+    else {
+      usage(argv[0]);
+    }
   }
 
   return p;
@@ -4,26 +4,49 @@
 #include "cJSON.h"
 #include "logger.h"
 #include "network.h"
+#include "replace-file.h"
+#include "timer.h"
 #include <limits.h>
 #include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <time.h>
 #include <unistd.h>
 
 // global variable
 Router router;
 
 // router params initializer
-void init_router(Router *rt, int sock_fd, const char *ip, int period) {
+void init_router(Router *rt, int sock_fd, const char *ip, int period_ms) {
   rt->sock_fd = sock_fd;
   pipe(rt->pipe_fd);
   strcpy(rt->ip, ip);
-  rt->period = period;
+  rt->period_ms = period_ms;
+  rt->hello_ms = 0;
+  rt->detect_mult = 0;
   rt->operating = 1;
   rt->neighbors_count = 0;
   rt->routes_count = 0;
+  rt->update_id = 0;
+  rt->recv_buf_size = DEFAULT_RECV_BUF_SIZE;
+  rt->stats_file = NULL;
+  init_metrics(&rt->metrics, now_ms());
   pthread_mutex_init(&rt->router_mutex, NULL);
-  pthread_cond_init(&rt->router_update_cond, NULL);
+
+  // timed waits on the update cond use the monotonic clock
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&rt->router_update_cond, &attr);
+  pthread_condattr_destroy(&attr);
+}
+
+// enable the hello protocol, a zero interval disables it
+void set_hello(Router *rt, int hello_ms, int detect_mult) {
+  pthread_mutex_lock(&rt->router_mutex);
+  rt->hello_ms = hello_ms;
+  rt->detect_mult = detect_mult;
+  pthread_mutex_unlock(&rt->router_mutex);
 }
 
 // returns the neighbor index if it exists
@@ -36,16 +59,54 @@ static int find_neighbor(Router *rt, const char *ip) {
   return -1;
 }
 
+// fnv-1a hash of a string, continuing from a previous hash
+static uint64_t hash_str(uint64_t hash, const char *str) {
+  for (; *str != '\0'; str++) {
+    hash ^= (uint8_t)*str;
+    hash *= 0x100000001b3ULL;
+  }
+
+  // separator, so ("ab", "c") and ("a", "bc") differ
+  hash ^= 0xff;
+  hash *= 0x100000001b3ULL;
+  return hash;
+}
+
+// weight of a next hop for a flow, final mix spreads close hashes apart
+static uint64_t flow_weight(const char *source, const char *dest_ip,
+                            const char *via_ip) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  hash = hash_str(hash, source);
+  hash = hash_str(hash, dest_ip);
+  hash = hash_str(hash, via_ip);
+
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
 // return the best route if it exists
-static int find_best_route(Router *rt, const char *dest_ip) {
+// among equal cost routes, the one for the (source, dest) flow is returned
+// each next hop is weighted by a hash of the flow and the highest wins,
+// so a flow keeps its path and only moves if its next hop goes away
+static int find_best_route(Router *rt, const char *source,
+                           const char *dest_ip) {
   int best_cost = INT_MAX;
   int best_id = -1;
+  uint64_t best_weight = 0;
 
   for (int i = 0; i < rt->routes_count; i++) {
-    if (strcmp(rt->routes[i].dest_ip, dest_ip) == 0 &&
-        rt->routes[i].cost < best_cost) {
-      best_cost = rt->routes[i].cost;
+    Route *route = &rt->routes[i];
+    if (strcmp(route->dest_ip, dest_ip) != 0 || route->cost > best_cost) {
+      continue;
+    }
+
+    uint64_t weight = flow_weight(source, dest_ip, route->via_ip);
+    if (route->cost < best_cost || weight > best_weight) {
+      best_cost = route->cost;
       best_id = i;
+      best_weight = weight;
     }
   }
 
@@ -63,6 +124,20 @@ static int find_single_route(Router *rt, const char *via_ip,
   return -1;
 }
 
+// copy the next hop of a flow, if there is a route to its destination
+int get_next_hop(Router *rt, const char *source, const char *dest_ip,
+                 char *via_ip) {
+  pthread_mutex_lock(&rt->router_mutex);
+
+  int idx = find_best_route(rt, source, dest_ip);
+  if (idx != -1) {
+    strcpy(via_ip, rt->routes[idx].via_ip);
+  }
+
+  pthread_mutex_unlock(&rt->router_mutex);
+  return idx != -1 ? 0 : -1;
+}
+
 // add a neighbor and a route to it
 void add_neighbor(Router *rt, const char *ip, int weight) {
   pthread_mutex_lock(&rt->router_mutex);
@@ -72,13 +147,22 @@ void add_neighbor(Router *rt, const char *ip, int weight) {
       strcmp(rt->ip, ip) != 0) {
     strcpy(rt->neighbors[rt->neighbors_count].ip, ip);
     rt->neighbors[rt->neighbors_count].weight = weight;
-    rt->neighbors[rt->neighbors_count].last_update = time(NULL);
+    rt->neighbors[rt->neighbors_count].last_update = now_ms();
+    rt->neighbors[rt->neighbors_count].last_hello = 0;
+    rt->neighbors[rt->neighbors_count].hello_capable = 0;
+    rt->neighbors[rt->neighbors_count].hello_ms = 0;
+    rt->neighbors[rt->neighbors_count].update_id = 0;
+    rt->neighbors[rt->neighbors_count].next_seq = -1;
+    rt->neighbors[rt->neighbors_count].update_start = 0;
+    memset(&rt->neighbors[rt->neighbors_count].arrivals, 0,
+           sizeof(ArrivalStats));
     rt->neighbors_count++;
 
     strcpy(rt->routes[rt->routes_count].dest_ip, ip);
     strcpy(rt->routes[rt->routes_count].via_ip, ip);
     rt->routes[rt->routes_count].cost = weight;
-    rt->routes[rt->routes_count].timestamp = time(NULL);
+    rt->routes[rt->routes_count].timestamp = now_ms();
+    record_route_change(&rt->metrics, now_ms(), rt->period_ms);
 
     if (rt->routes_count < MAX_ROUTES - 1) {
       rt->routes_count++;
@@ -115,6 +199,7 @@ void del_neighbor(Router *rt, const char *ip) {
           rt->routes[j] = rt->routes[j + 1];
         }
         rt->routes_count--;
+        record_route_change(&rt->metrics, now_ms(), rt->period_ms);
       } else {
         i++;
       }
@@ -142,7 +227,7 @@ static void send_data(Router *rt, cJSON *msg) {
   cJSON_AddStringToObject(reply, "type", "data");
   cJSON_AddStringToObject(reply, "source", rt->ip);
   cJSON_AddStringToObject(reply, "destination", source);
-  cJSON_AddItemToObject(reply, "payload", msg);
+  cJSON_AddItemReferenceToObject(reply, "payload", msg);
   char *resp = cJSON_PrintUnformatted(reply);
 
   // send data back
@@ -166,9 +251,10 @@ void process_data(Router *rt, cJSON *msg) {
 
   // this router is the data destination
   if (strcmp(rt->ip, dest) == 0) {
-    const char *payload_str = cJSON_Print(payload);
+    char *payload_str = cJSON_Print(payload);
     printf("%s\n", payload_str);
     LOG_MSG(LOG_INFO, "process_data(): data printed");
+    free(payload_str);
   }
 
   // need to foward data back in the routers list
@@ -187,16 +273,16 @@ void process_data(Router *rt, cJSON *msg) {
           char *prev_ip = prev->valuestring;
 
           char *fwd = cJSON_PrintUnformatted(msg);
-          char *ffwd = cJSON_Print(msg);
 
           int bytes_sent = send_packet(rt->sock_fd, prev_ip, fwd, strlen(fwd));
 
           if (bytes_sent == -1) {
             LOG_MSG(LOG_INFO, "process_data(): data not fowarded back\n%s",
-                    ffwd);
+                    fwd);
           } else {
-            LOG_MSG(LOG_INFO, "process_trace(): data fowarded back\n%s", ffwd);
+            LOG_MSG(LOG_INFO, "process_data(): data fowarded back\n%s", fwd);
           }
+          free(fwd);
         }
         break;
       }
@@ -209,7 +295,7 @@ void process_data(Router *rt, cJSON *msg) {
 void send_trace(Router *rt, const char *dest_ip) {
   pthread_mutex_lock(&rt->router_mutex);
 
-  int route_id = find_best_route(rt, dest_ip);
+  int route_id = find_best_route(rt, rt->ip, dest_ip);
   if (route_id != -1) {
     // create trace msg
     cJSON *trace_msg = cJSON_CreateObject();
@@ -222,11 +308,9 @@ void send_trace(Router *rt, const char *dest_ip) {
     cJSON_AddItemToArray(router_array, cJSON_CreateString(rt->ip));
     cJSON_AddItemToObject(trace_msg, "routers", router_array);
 
-    // json to string
+    // json to string, the formatted one only for the log
     char *json = cJSON_PrintUnformatted(trace_msg);
-    char *formatted_json = cJSON_Print(trace_msg);
-
-    LOG_MSG(LOG_INFO, "send_trace(): trace msg sent\n%s", formatted_json);
+    LOG_JSON(LOG_INFO, "send_trace(): trace msg sent", trace_msg);
 
     int bytes_sent = send_packet(rt->sock_fd, rt->routes[route_id].via_ip, json,
                                  strlen(json));
@@ -238,7 +322,6 @@ void send_trace(Router *rt, const char *dest_ip) {
 
     cJSON_Delete(trace_msg);
     free(json);
-    free(formatted_json);
   } else {
     LOG_MSG(LOG_WARNING, "send_trace(): no route found");
   }
@@ -263,21 +346,20 @@ void process_trace(Router *rt, cJSON *msg) {
 
   // foward the trace msg
   else {
-    int idx = find_best_route(&router, dest);
+    const char *source = cJSON_GetObjectItem(msg, "source")->valuestring;
+    int idx = find_best_route(rt, source, dest);
     if (idx != -1) {
       char *fwd = cJSON_PrintUnformatted(msg);
-      char *ffwd = cJSON_PrintUnformatted(msg);
 
       int bytes_sent =
           send_packet(rt->sock_fd, rt->routes[idx].via_ip, fwd, strlen(fwd));
 
       if (bytes_sent == -1) {
-        LOG_MSG(LOG_INFO, "process_trace(): msg not fowarded\n%s", ffwd);
+        LOG_MSG(LOG_INFO, "process_trace(): msg not fowarded\n%s", fwd);
       } else {
-        LOG_MSG(LOG_INFO, "process_trace(): msg fowarded\n%s", ffwd);
+        LOG_MSG(LOG_INFO, "process_trace(): msg fowarded\n%s", fwd);
       }
       free(fwd);
-      free(ffwd);
     } else {
       LOG_MSG(LOG_INFO, "process_trace(): msg not fowarded");
     }
@@ -285,59 +367,167 @@ void process_trace(Router *rt, cJSON *msg) {
   pthread_mutex_unlock(&rt->router_mutex);
 }
 
+// create an update msg header for a neighbor
+static cJSON *create_update_msg(Router *rt, const char *dest_ip) {
+  cJSON *update_msg = cJSON_CreateObject();
+  cJSON_AddStringToObject(update_msg, "type", "update");
+  cJSON_AddStringToObject(update_msg, "source", rt->ip);
+  cJSON_AddStringToObject(update_msg, "destination", dest_ip);
+  return update_msg;
+}
+
+// send a serialized update msg to a neighbor and free it
+static void send_update_json(Router *rt, const char *dest_ip, char *json) {
+  int bytes_sent = send_packet(rt->sock_fd, dest_ip, json, strlen(json));
+  if (bytes_sent == -1) {
+    rt->metrics.update_send_failures++;
+    LOG_MSG(LOG_ERROR, "send_update(): failed to send update to ip = %s",
+            dest_ip);
+  } else {
+    rt->metrics.updates_sent++;
+    rt->metrics.update_bytes_sent += bytes_sent;
+    LOG_MSG(LOG_INFO, "send_update(): %d bytes sent to ip = %s\n%s",
+            bytes_sent, dest_ip, json);
+  }
+
+  free(json);
+}
+
+// send an update msg to a neighbor and free it
+static void send_update_msg(Router *rt, const char *dest_ip, cJSON *msg) {
+  char *json = cJSON_PrintUnformatted(msg);
+  cJSON_Delete(msg);
+  send_update_json(rt, dest_ip, json);
+}
+
+// send the distances in as many update msgs as needed to fit a datagram
+// each fragment carries the update id, its sequence number and a last flag
+static void send_update_fragments(Router *rt, const char *dest_ip,
+                                  cJSON *distances) {
+  size_t budget = UPDATE_FRAGMENT_BYTES - UPDATE_HEADER_BYTES;
+  int seq = 0;
+
+  while (distances->child != NULL) {
+    cJSON *fragment = cJSON_CreateObject();
+    size_t size = 0;
+
+    // move distances to the fragment until it is full
+    while (distances->child != NULL) {
+      cJSON *dest = distances->child;
+
+      // "ip":cost, the cost never needs more than 11 chars
+      size_t entry_size = strlen(dest->string) + 15;
+      if (size > 0 && size + entry_size > budget) {
+        break;
+      }
+
+      cJSON_DetachItemViaPointer(distances, dest);
+      cJSON_AddItemToObject(fragment, dest->string, dest);
+      size += entry_size;
+    }
+
+    cJSON *msg = create_update_msg(rt, dest_ip);
+    cJSON_AddNumberToObject(msg, "update_id", rt->update_id);
+    cJSON_AddNumberToObject(msg, "seq", seq++);
+    cJSON_AddBoolToObject(msg, "last", distances->child == NULL);
+    cJSON_AddItemToObject(msg, "distances", fragment);
+    send_update_msg(rt, dest_ip, msg);
+  }
+
+  cJSON_Delete(distances);
+}
+
 // send udated routes to all the neighbors
 void send_update(Router *rt) {
   pthread_mutex_lock(&rt->router_mutex);
-  for (int i = 0; i < rt->neighbors_count; i++) {
-    cJSON *update_msg = cJSON_CreateObject();
-    cJSON_AddStringToObject(update_msg, "type", "update");
-    cJSON_AddStringToObject(update_msg, "source", rt->ip);
-    cJSON_AddStringToObject(update_msg, "destination", rt->neighbors[i].ip);
+  rt->update_id++;
 
-    // add all known routes to the message
+  for (int i = 0; i < rt->neighbors_count; i++) {
+    // the neighbor learns its weight from the first distance
     cJSON *distances = cJSON_CreateObject();
+    cJSON_AddNumberToObject(distances, rt->ip, rt->neighbors[i].weight);
+
+    // add the best known routes to the message
     for (int j = 0; j < rt->routes_count; j++) {
       // only add if the destination is not accessed via the neighbor
       if (strcmp(rt->routes[j].via_ip, rt->neighbors[i].ip) != 0 &&
           strcmp(rt->routes[j].dest_ip, rt->neighbors[i].ip) != 0) {
         // check if the key is already added
         cJSON *dest = cJSON_GetObjectItem(distances, rt->routes[j].dest_ip);
-        if (dest && rt->routes[i].cost < dest->valueint) {
-          dest->valueint = rt->routes[i].cost;
-        } else {
+        if (dest == NULL) {
           cJSON_AddNumberToObject(distances, rt->routes[j].dest_ip,
                                   rt->routes[j].cost);
+        } else if (rt->routes[j].cost < dest->valueint) {
+          cJSON_SetNumberValue(dest, rt->routes[j].cost);
         }
       }
     }
-    cJSON_AddNumberToObject(distances, rt->ip, rt->neighbors[i].weight);
+
+    // small tables go in a single msg, as the original protocol expects
+    cJSON *update_msg = create_update_msg(rt, rt->neighbors[i].ip);
     cJSON_AddItemToObject(update_msg, "distances", distances);
 
-    // send the created message
+    // the serialized msg is sent as is when it fits
     char *json = cJSON_PrintUnformatted(update_msg);
-    char *formatted_json = cJSON_Print(update_msg);
-
-    int bytes_sent =
-        send_packet(rt->sock_fd, rt->neighbors[i].ip, json, strlen(json));
-    if (bytes_sent == -1) {
-      LOG_MSG(LOG_ERROR, "send_update(): failed to send update to ip = %s",
-              rt->neighbors[i].ip);
+    if (strlen(json) <= UPDATE_FRAGMENT_BYTES) {
+      cJSON_Delete(update_msg);
+      send_update_json(rt, rt->neighbors[i].ip, json);
     } else {
-      LOG_MSG(LOG_INFO, "send_update(): %d bytes sent to ip = %s\n%s",
-              bytes_sent, rt->neighbors[i].ip, formatted_json);
+      free(json);
+      cJSON_DetachItemViaPointer(update_msg, distances);
+      cJSON_Delete(update_msg);
+      send_update_fragments(rt, rt->neighbors[i].ip, distances);
     }
-
-    // clean memory
-    cJSON_Delete(update_msg);
-    free(json);
-    free(formatted_json);
   }
   pthread_mutex_unlock(&rt->router_mutex);
 }
 
+// track the update fragments of a neighbor, an update arrives with its
+// first fragment
+// returns 1 when the full update was received, so obsolete routes can go
+static int track_update_fragment(Neighbor *nb, cJSON *msg, uint64_t now) {
+  cJSON *update_id = cJSON_GetObjectItem(msg, "update_id");
+  cJSON *seq = cJSON_GetObjectItem(msg, "seq");
+  cJSON *last = cJSON_GetObjectItem(msg, "last");
+
+  // update in a single msg
+  if (!cJSON_IsNumber(seq)) {
+    nb->update_start = now;
+    record_arrival(&nb->arrivals, now);
+    return 1;
+  }
+
+  // first fragment starts a new update
+  if (seq->valueint == 0) {
+    nb->update_id = cJSON_IsNumber(update_id) ? update_id->valueint : 0;
+    nb->next_seq = 1;
+    nb->update_start = now;
+    record_arrival(&nb->arrivals, now);
+  }
+
+  // next fragment of the current update
+  else if (nb->next_seq == seq->valueint && cJSON_IsNumber(update_id) &&
+           nb->update_id == update_id->valueint) {
+    nb->next_seq++;
+  }
+
+  // lost or reordered fragment, wait for the next full update
+  else {
+    nb->next_seq = -1;
+  }
+
+  return nb->next_seq > 0 && cJSON_IsTrue(last);
+}
+
 // process update json mesage
-void process_update(Router *rt, cJSON *msg) {
+void process_update(Router *rt, cJSON *msg, size_t msg_size) {
   pthread_mutex_lock(&rt->router_mutex);
+  // an update is counted once, with its first fragment
+  cJSON *seq = cJSON_GetObjectItem(msg, "seq");
+  if (!cJSON_IsNumber(seq) || seq->valueint == 0) {
+    rt->metrics.updates_received++;
+  }
+  rt->metrics.update_bytes_received += msg_size;
 
   // get the distances object
   cJSON *distances = cJSON_GetObjectItem(msg, "distances");
@@ -345,7 +535,7 @@ void process_update(Router *rt, cJSON *msg) {
 
   // check if the sender is already a neighbor and add it case not
   char *sender = cJSON_GetObjectItem(msg, "source")->valuestring;
-  int sender_weight;
+  int sender_weight = -1;
   int sender_idx = find_neighbor(rt, sender);
   if (sender_idx < 0) {
     cJSON_ArrayForEach(dest, distances) {
@@ -354,16 +544,26 @@ void process_update(Router *rt, cJSON *msg) {
         add_neighbor(rt, dest->string, dest->valueint);
         pthread_mutex_lock(&rt->router_mutex);
         sender_weight = dest->valueint;
+        sender_idx = find_neighbor(rt, sender);
         break;
       }
     }
   } else {
     sender_weight = rt->neighbors[sender_idx].weight;
-    rt->neighbors[sender_idx].last_update = time(NULL);
+    rt->neighbors[sender_idx].last_update = now_ms();
+  }
+
+  // unknown sender without its weight, e.g. a later fragment
+  if (sender_idx < 0 || sender_weight < 0) {
+    LOG_MSG(LOG_WARNING, "process_update(): unknown sender %s", sender);
+    pthread_mutex_unlock(&rt->router_mutex);
+    return;
   }
 
   // update or add other routes
-  time_t timestamp_now = time(NULL);
+  uint64_t timestamp_now = now_ms();
+  int complete =
+      track_update_fragment(&rt->neighbors[sender_idx], msg, timestamp_now);
   cJSON_ArrayForEach(dest, distances) {
     if (strcmp(dest->string, sender) != 0) {
       int route_idx = find_single_route(rt, sender, dest->string);
@@ -373,6 +573,7 @@ void process_update(Router *rt, cJSON *msg) {
         strcpy(rt->routes[rt->routes_count].dest_ip, dest->string);
         rt->routes[rt->routes_count].cost = sender_weight + dest->valueint;
         rt->routes[rt->routes_count].timestamp = timestamp_now;
+        record_route_change(&rt->metrics, timestamp_now, rt->period_ms);
 
         if (rt->routes_count < MAX_ROUTES - 1) {
           rt->routes_count++;
@@ -380,22 +581,28 @@ void process_update(Router *rt, cJSON *msg) {
       }
       // update route
       else {
-        rt->routes[route_idx].cost = sender_weight + dest->valueint;
+        int cost = sender_weight + dest->valueint;
+        if (rt->routes[route_idx].cost != cost) {
+          record_route_change(&rt->metrics, timestamp_now, rt->period_ms);
+        }
+        rt->routes[route_idx].cost = cost;
         rt->routes[route_idx].timestamp = timestamp_now;
       }
     }
   }
 
-  // delete obsolete routes
-  for (int i = 0; i < rt->routes_count;) {
+  // delete obsolete routes, once all the update fragments arrived
+  uint64_t update_start = rt->neighbors[sender_idx].update_start;
+  for (int i = 0; complete && i < rt->routes_count;) {
     if (strcmp(rt->routes[i].via_ip, sender) == 0 &&
         strcmp(rt->routes[i].dest_ip, sender) != 0 &&
-        rt->routes[i].timestamp < timestamp_now) {
+        rt->routes[i].timestamp < update_start) {
 
       for (int j = i; j < rt->routes_count - 1; j++) {
         rt->routes[j] = rt->routes[j + 1];
       }
       rt->routes_count--;
+      record_route_change(&rt->metrics, timestamp_now, rt->period_ms);
     } else {
       i++;
     }
@@ -405,15 +612,81 @@ void process_update(Router *rt, cJSON *msg) {
   pthread_mutex_unlock(&rt->router_mutex);
 }
 
-// check if the neighbors haven't send updates for a long period
+// send a small keepalive msg to all the neighbors, with the interval the
+// neighbors should expect it
+void send_hello(Router *rt) {
+  pthread_mutex_lock(&rt->router_mutex);
+  for (int i = 0; i < rt->neighbors_count; i++) {
+    // the hello msg is fixed, so there is no need to build a json tree
+    char hello[HELLO_MSG_SIZE];
+    int size = snprintf(hello, sizeof(hello),
+                        "{\"type\":\"hello\",\"source\":\"%s\","
+                        "\"destination\":\"%s\",\"interval\":%d}",
+                        rt->ip, rt->neighbors[i].ip, rt->hello_ms);
+
+    if (send_packet(rt->sock_fd, rt->neighbors[i].ip, hello, size) == -1) {
+      LOG_MSG(LOG_ERROR, "send_hello(): failed to send hello to ip = %s",
+              rt->neighbors[i].ip);
+    } else {
+      rt->metrics.hellos_sent++;
+    }
+  }
+  pthread_mutex_unlock(&rt->router_mutex);
+}
+
+// refresh the liveness of the neighbor that sent the hello
+void process_hello(Router *rt, cJSON *msg) {
+  pthread_mutex_lock(&rt->router_mutex);
+
+  rt->metrics.hellos_received++;
+  cJSON *source = cJSON_GetObjectItem(msg, "source");
+  if (!cJSON_IsString(source)) {
+    LOG_MSG(LOG_WARNING, "process_hello(): hello without source");
+    pthread_mutex_unlock(&rt->router_mutex);
+    return;
+  }
+
+  const char *sender = source->valuestring;
+  int idx = find_neighbor(rt, sender);
+  if (idx >= 0) {
+    rt->neighbors[idx].last_hello = now_ms();
+    rt->neighbors[idx].hello_capable = 1;
+
+    // the interval of the sender, hellos without it use ours
+    cJSON *interval = cJSON_GetObjectItem(msg, "interval");
+    rt->neighbors[idx].hello_ms =
+        cJSON_IsNumber(interval) && interval->valueint > 0 ? interval->valueint
+                                                           : 0;
+  } else {
+    LOG_MSG(LOG_WARNING, "process_hello(): %s is not a neighbor", sender);
+  }
+
+  pthread_mutex_unlock(&rt->router_mutex);
+}
+
+// check if a neighbor is considered down at the given time
+static int neighbor_expired(Router *rt, Neighbor *nb, uint64_t now) {
+  // neighbors speaking hello are down after detect_mult missed hellos,
+  // at the slower of the two intervals
+  uint64_t hello_ms = rt->hello_ms > nb->hello_ms ? rt->hello_ms : nb->hello_ms;
+  if (rt->hello_ms > 0 && nb->hello_capable > 0 && now > nb->last_hello &&
+      now - nb->last_hello > (uint64_t)rt->detect_mult * hello_ms) {
+    return 1;
+  }
+
+  // no update since (4 * period) milliseconds ago
+  return now > nb->last_update &&
+         now - nb->last_update > 4 * (uint64_t)rt->period_ms;
+}
+
+// check if the neighbors haven't send updates or hellos for a long period
 void check_timeouts(Router *rt) {
-  time_t now = time(NULL);
+  uint64_t now = now_ms();
 
   pthread_mutex_lock(&rt->router_mutex);
   // for each neighbor
   for (int i = 0; i < rt->neighbors_count;) {
-    // no update since (4 * period) seconds ago
-    if ((int)difftime(now, rt->neighbors[i].last_update) > (4 * rt->period)) {
+    if (neighbor_expired(rt, &rt->neighbors[i], now)) {
       LOG_MSG(LOG_INFO, "check_timeouts(): removed ip = %s",
               rt->neighbors[i].ip);
       pthread_mutex_unlock(&rt->router_mutex);
@@ -444,3 +717,55 @@ void print_info(Router *rt) {
   printf(" ]\n");
   pthread_mutex_unlock(&rt->router_mutex);
 }
+
+// count a received msg that isn't valid json or has no type
+void count_parse_failure(Router *rt) {
+  pthread_mutex_lock(&rt->router_mutex);
+  rt->metrics.parse_failures++;
+  pthread_mutex_unlock(&rt->router_mutex);
+}
+
+// control plane counters, table sizes and per neighbor update arrivals
+cJSON *get_stats(Router *rt) {
+  pthread_mutex_lock(&rt->router_mutex);
+  uint64_t now = now_ms();
+
+  cJSON *stats = metrics_to_json(&rt->metrics, now);
+  cJSON_AddStringToObject(stats, "ip", rt->ip);
+  cJSON_AddNumberToObject(stats, "neighbors_count", rt->neighbors_count);
+  cJSON_AddNumberToObject(stats, "routes_count", rt->routes_count);
+
+  cJSON *neighbors = cJSON_CreateObject();
+  for (int i = 0; i < rt->neighbors_count; i++) {
+    cJSON_AddItemToObject(neighbors, rt->neighbors[i].ip,
+                          arrival_to_json(&rt->neighbors[i].arrivals));
+  }
+  cJSON_AddItemToObject(stats, "neighbors", neighbors);
+
+  pthread_mutex_unlock(&rt->router_mutex);
+  return stats;
+}
+
+// print the router stats as json
+void print_stats(Router *rt) {
+  cJSON *stats = get_stats(rt);
+  char *json = cJSON_Print(stats);
+  printf("%s\n", json);
+  free(json);
+  cJSON_Delete(stats);
+}
+
+static void write_stats_json(FILE *file, void *data) {
+  cJSON *stats = get_stats((Router *)data);
+  char *json = cJSON_PrintUnformatted(stats);
+  fprintf(file, "%s\n", json);
+  free(json);
+  cJSON_Delete(stats);
+}
+
+// write the router stats as one json line to a file
+void write_stats_file(Router *rt, const char *path) {
+  if (replace_file(path, write_stats_json, rt) != 0) {
+    LOG_MSG(LOG_ERROR, "write_stats_file(): can't write %s", path);
+  }
+}
@@ -0,0 +1,16 @@
+// file:        timer.c
+// description: implementation of monotonic millisecond timer helpers
+#include "timer.h"
+
+// milliseconds elapsed on the monotonic clock, immune to wall-clock steps
+uint64_t now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// convert an absolute monotonic time in ms to a timespec for timed waits
+void ms_to_timespec(uint64_t abs_ms, struct timespec *ts) {
+  ts->tv_sec = (time_t)(abs_ms / 1000);
+  ts->tv_nsec = (long)(abs_ms % 1000) * 1000000;
+}
@@ -0,0 +1,83 @@
+// file:        impair.h
+// description: definitions of the impaired links between the proxy sockets
+#ifndef IMPAIR_H
+#define IMPAIR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// max bytes of a datagram or a stream read
+#define MAX_PACKET 65536
+
+// default bytes queued in a link before udp packets are dropped and tcp
+// reads are paused
+#define DEFAULT_QUEUE_LIMIT (4 * 1024 * 1024)
+
+// default extra delay of a reordered packet
+#define DEFAULT_REORDER_GAP_MS 20
+
+// impairments of a link, probabilities are in [0, 1]
+typedef struct {
+  double loss;
+  double dup;
+  double reorder;
+  double corrupt;
+  uint64_t delay_us;
+  uint64_t jitter_us;
+  uint64_t reorder_gap_us;
+  uint64_t rate;
+  size_t queue_limit;
+  uint64_t seed;
+} ImpairConfig;
+
+// counters of a link
+typedef struct {
+  uint64_t packets_in;
+  uint64_t bytes_in;
+  uint64_t packets_out;
+  uint64_t bytes_out;
+  uint64_t lost;
+  uint64_t queue_drops;
+  uint64_t duplicated;
+  uint64_t corrupted;
+  uint64_t reordered;
+} LinkStats;
+
+// a packet waiting for its release time
+typedef struct {
+  uint64_t release_us;
+  uint64_t seq;
+  int flow;
+  uint64_t flow_gen;
+  size_t len;
+  char *data;
+} Packet;
+
+// one direction of the proxy, packets leave in release time order
+// stream links pause their source instead of dropping on a full queue
+typedef struct {
+  const char *name;
+  const ImpairConfig *cfg;
+  int stream;
+  LinkStats stats;
+  Packet *heap;
+  size_t count;
+  size_t capacity;
+  size_t queued_bytes;
+  uint64_t next_seq;
+  uint64_t last_release_us;
+  uint64_t free_us;
+  uint64_t rng;
+} Link;
+
+uint64_t now_us(void);
+void init_link(Link *link, const char *name, const ImpairConfig *cfg,
+               uint64_t seed);
+void free_link(Link *link);
+void submit_packet(Link *link, const char *data, size_t len, int flow,
+                   uint64_t flow_gen, int droppable, uint64_t now);
+int next_release(const Link *link, uint64_t now);
+int pop_packet(Link *link, uint64_t now, Packet *out);
+void print_link_stats(const Link *link);
+
+#endif
@@ -0,0 +1,41 @@
+// file:        logger.h
+// description: definitions for useful loggers
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// simple logger
+typedef enum {
+  LOG_INFO,
+  LOG_WARNING,
+  LOG_ERROR,
+  LOG_DISABLED,
+} LogLevel;
+
+// levels below the threshold are compiled out, e.g. make LOG_MIN_LEVEL=LOG_ERROR
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_INFO
+#endif
+
+extern LogLevel current_log_level;
+
+// check if a level is logged
+#define LOG_ENABLED(level)                                                     \
+  ((level) >= LOG_MIN_LEVEL && (level) >= current_log_level)
+
+// the proxy runs in a single thread, msgs are written right away
+#define LOG_MSG(level, fmt, ...)                                               \
+  do {                                                                         \
+    if (LOG_ENABLED(level)) {                                                  \
+      log_message(level, fmt, ##__VA_ARGS__);                                  \
+    }                                                                          \
+  } while (0)
+
+void log_exit(const char *msg);
+void usage(const char *program);
+void set_log_level(LogLevel level);
+void log_message(LogLevel level, const char *fmt, ...);
+
+#endif
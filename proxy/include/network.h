@@ -0,0 +1,13 @@
+// file:        network.h
+// description: definitions of network useful functions
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <sys/socket.h>
+
+int parse_endpoint(const char *str, struct sockaddr_storage *addr,
+                   socklen_t *addr_len);
+int create_bound_socket(int type, const struct sockaddr_storage *addr,
+                        socklen_t addr_len);
+
+#endif
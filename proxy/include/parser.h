@@ -0,0 +1,20 @@
+// file:        parser.h
+// description: definitions for the command line arguments parser
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "impair.h"
+
+// command line arguments
+typedef struct {
+  int tcp;
+  char *listen_str;
+  char *target_str;
+  int debug_mode;
+  ImpairConfig cfg;
+} Params;
+
+// parse the command line arguments
+Params parse_args(int argc, char **argv);
+
+#endif
@@ -0,0 +1,36 @@
+// file:        proxy.h
+// description: definitions of the udp and tcp impairment proxies
+#ifndef PROXY_H
+#define PROXY_H
+
+#include "impair.h"
+#include <signal.h>
+#include <sys/socket.h>
+
+// clients proxied at the same time
+#define MAX_FLOWS 256
+
+// max wait of the proxy loop, so signals are handled in time
+#define PROXY_TICK_MS 100
+
+// both directions of a proxy, client to target and back
+#define LINK_UP 0
+#define LINK_DOWN 1
+
+// proxy address and the address of the proxied server
+typedef struct {
+  struct sockaddr_storage listen_addr;
+  socklen_t listen_len;
+  struct sockaddr_storage target_addr;
+  socklen_t target_len;
+} ProxyAddrs;
+
+extern volatile sig_atomic_t proxy_running;
+
+void init_signals(void);
+int poll_timeout(const Link *links, uint64_t now);
+void report_stats(const Link *links, int force);
+int run_udp_proxy(const ProxyAddrs *addrs, const ImpairConfig *cfg);
+int run_tcp_proxy(const ProxyAddrs *addrs, const ImpairConfig *cfg);
+
+#endif
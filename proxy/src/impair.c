@@ -0,0 +1,206 @@
+// file:        impair.c
+// description: implementation of the impaired links between the proxy sockets
+#include "impair.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// microseconds elapsed on the monotonic clock
+uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// xorshift64*, the same seed repeats the same impairments
+static uint64_t next_random(Link *link) {
+  link->rng ^= link->rng >> 12;
+  link->rng ^= link->rng << 25;
+  link->rng ^= link->rng >> 27;
+  return link->rng * 0x2545f4914f6cdd1dULL;
+}
+
+// true with probability p
+static int chance(Link *link, double p) {
+  return p > 0 && (next_random(link) >> 11) * (1.0 / (1ULL << 53)) < p;
+}
+
+void init_link(Link *link, const char *name, const ImpairConfig *cfg,
+               uint64_t seed) {
+  memset(link, 0, sizeof(*link));
+  link->name = name;
+  link->cfg = cfg;
+  link->rng = seed != 0 ? seed : 1;
+}
+
+void free_link(Link *link) {
+  for (size_t i = 0; i < link->count; i++) {
+    free(link->heap[i].data);
+  }
+  free(link->heap);
+}
+
+// heap order, ties keep the arrival order
+static int before(const Packet *a, const Packet *b) {
+  return a->release_us < b->release_us ||
+         (a->release_us == b->release_us && a->seq < b->seq);
+}
+
+static void swap_packets(Packet *a, Packet *b) {
+  Packet tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+static void push_packet(Link *link, Packet *p) {
+  if (link->count == link->capacity) {
+    size_t capacity = link->capacity > 0 ? 2 * link->capacity : 64;
+    Packet *heap = realloc(link->heap, capacity * sizeof(Packet));
+    if (heap == NULL) {
+      log_exit("packet queue failure");
+    }
+    link->heap = heap;
+    link->capacity = capacity;
+  }
+
+  size_t i = link->count++;
+  link->heap[i] = *p;
+  while (i > 0 && before(&link->heap[i], &link->heap[(i - 1) / 2])) {
+    swap_packets(&link->heap[i], &link->heap[(i - 1) / 2]);
+    i = (i - 1) / 2;
+  }
+  link->queued_bytes += p->len;
+}
+
+// queue a packet with the link impairments applied
+// the bottleneck serializes packets at the rate, then they are delayed
+// jitter doesn't reorder, only the reorder chance holds a packet back
+// droppable packets are lost or corrupted, stream ends are not
+void submit_packet(Link *link, const char *data, size_t len, int flow,
+                   uint64_t flow_gen, int droppable, uint64_t now) {
+  const ImpairConfig *cfg = link->cfg;
+  if (droppable) {
+    link->stats.packets_in++;
+    link->stats.bytes_in += len;
+  }
+
+  if (droppable && chance(link, cfg->loss)) {
+    link->stats.lost++;
+    LOG_MSG(LOG_INFO, "submit_packet(%s): %ld bytes lost", link->name, len);
+    return;
+  }
+
+  int copies = 1;
+  if (droppable && chance(link, cfg->dup)) {
+    copies = 2;
+    link->stats.duplicated++;
+  }
+
+  for (int c = 0; c < copies; c++) {
+    // udp overflows the queue, tcp stops reading before that
+    if (!link->stream && link->queued_bytes + len > cfg->queue_limit) {
+      link->stats.queue_drops++;
+      LOG_MSG(LOG_INFO, "submit_packet(%s): queue full", link->name);
+      continue;
+    }
+
+    Packet p = {0, link->next_seq++, flow, flow_gen, len, NULL};
+    if (len > 0) {
+      p.data = malloc(len);
+      if (p.data == NULL) {
+        log_exit("packet allocation failure");
+      }
+      memcpy(p.data, data, len);
+    }
+
+    if (droppable && len > 0 && chance(link, cfg->corrupt)) {
+      uint64_t bit = next_random(link) % (len * 8);
+      p.data[bit / 8] ^= 1 << (bit % 8);
+      link->stats.corrupted++;
+    }
+
+    // serialization at the bottleneck rate
+    uint64_t sent = now;
+    if (cfg->rate > 0) {
+      sent = link->free_us > now ? link->free_us : now;
+      sent += len * 1000000 / cfg->rate;
+      link->free_us = sent;
+    }
+
+    // propagation delay and jitter
+    p.release_us = sent + cfg->delay_us;
+    if (cfg->jitter_us > 0) {
+      p.release_us += next_random(link) % (cfg->jitter_us + 1);
+    }
+
+    if (droppable && chance(link, cfg->reorder)) {
+      p.release_us += cfg->reorder_gap_us;
+      link->stats.reordered++;
+    } else {
+      if (p.release_us < link->last_release_us) {
+        p.release_us = link->last_release_us;
+      }
+      link->last_release_us = p.release_us;
+    }
+
+    push_packet(link, &p);
+  }
+}
+
+// ms until the next packet is due, -1 if the link is empty
+int next_release(const Link *link, uint64_t now) {
+  if (link->count == 0) {
+    return -1;
+  }
+  uint64_t release = link->heap[0].release_us;
+  if (release <= now) {
+    return 0;
+  }
+  // rounded up, so poll doesn't wake up just before the release
+  return (int)((release - now + 999) / 1000);
+}
+
+// take the next due packet, the caller frees its data
+// returns 0 if there is none
+int pop_packet(Link *link, uint64_t now, Packet *out) {
+  if (link->count == 0 || link->heap[0].release_us > now) {
+    return 0;
+  }
+
+  *out = link->heap[0];
+  link->heap[0] = link->heap[--link->count];
+  size_t i = 0;
+  while (1) {
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    size_t first = i;
+    if (left < link->count && before(&link->heap[left], &link->heap[first])) {
+      first = left;
+    }
+    if (right < link->count && before(&link->heap[right], &link->heap[first])) {
+      first = right;
+    }
+    if (first == i) {
+      break;
+    }
+    swap_packets(&link->heap[i], &link->heap[first]);
+    i = first;
+  }
+
+  link->queued_bytes -= out->len;
+  return 1;
+}
+
+// link counters as a json line on stderr
+void print_link_stats(const Link *link) {
+  const LinkStats *s = &link->stats;
+  fprintf(stderr,
+          "{\"link\":\"%s\",\"packets_in\":%lu,\"bytes_in\":%lu,"
+          "\"packets_out\":%lu,\"bytes_out\":%lu,\"lost\":%lu,"
+          "\"queue_drops\":%lu,\"duplicated\":%lu,\"corrupted\":%lu,"
+          "\"reordered\":%lu,\"queued\":%lu}\n",
+          link->name, s->packets_in, s->bytes_in, s->packets_out,
+          s->bytes_out, s->lost, s->queue_drops, s->duplicated, s->corrupted,
+          s->reordered, link->count);
+}
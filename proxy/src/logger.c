@@ -0,0 +1,58 @@
+// file:        logger.c
+// description: implementation of useful loggers
+#include "logger.h"
+#include <stdlib.h>
+#include <time.h>
+
+LogLevel current_log_level = LOG_DISABLED;
+
+// correct program usage
+void usage(const char *program) {
+  printf("Usage: %s <udp|tcp> <listen IP:PORT> <target IP:PORT> [-d] "
+         "[--loss <%%>] [--delay <ms>] [--jitter <ms>] [--reorder <%%>] "
+         "[--reorder-gap <ms>] [--dup <%%>] [--corrupt <%%>] "
+         "[--rate <bytes/s>] [--queue <bytes>] [--seed <n>]\n",
+         program);
+  exit(EXIT_FAILURE);
+}
+
+// finish program due failure
+void log_exit(const char *msg) {
+  fprintf(stderr, "%s\n", msg);
+  exit(EXIT_FAILURE);
+}
+
+// convert a log level to a string
+static const char *get_level_str(LogLevel level) {
+  switch (level) {
+  case LOG_INFO:
+    return "INFO";
+  case LOG_WARNING:
+    return "WARNING";
+  case LOG_ERROR:
+    return "ERROR";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+void set_log_level(LogLevel level) { current_log_level = level; }
+
+// write a msg with its time and level to stderr
+void log_message(LogLevel level, const char *fmt, ...) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  struct tm tm;
+  localtime_r(&ts.tv_sec, &tm);
+
+  char time_str[32];
+  strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm);
+  fprintf(stderr, "[%s.%03ld] [%s] ", time_str, ts.tv_nsec / 1000000,
+          get_level_str(level));
+
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fprintf(stderr, "\n");
+}
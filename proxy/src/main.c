@@ -0,0 +1,36 @@
+#include "logger.h"
+#include "network.h"
+#include "parser.h"
+#include "proxy.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+  // parse command line arguments
+  Params p = parse_args(argc, argv);
+
+  // set debug mode
+  if (p.debug_mode > 0) {
+    set_log_level(LOG_INFO);
+  }
+
+  ProxyAddrs addrs;
+  addrs.listen_len = sizeof(addrs.listen_addr);
+  addrs.target_len = sizeof(addrs.target_addr);
+  if (parse_endpoint(p.listen_str, &addrs.listen_addr, &addrs.listen_len) !=
+          0 ||
+      parse_endpoint(p.target_str, &addrs.target_addr, &addrs.target_len) !=
+          0) {
+    usage(argv[0]);
+  }
+
+  init_signals();
+
+  // proxy operations executed until SIGINT or SIGTERM
+  int ret =
+      p.tcp ? run_tcp_proxy(&addrs, &p.cfg) : run_udp_proxy(&addrs, &p.cfg);
+  if (ret != 0) {
+    log_exit("proxy failure");
+  }
+  return 0;
+}
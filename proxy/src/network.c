@@ -0,0 +1,62 @@
+// file:        network.c
+// description: implementation of network useful functions
+#include "network.h"
+#include "logger.h"
+#include <netdb.h>
+#include <string.h>
+#include <unistd.h>
+
+// parse <IP>:<PORT>, ipv6 addresses may be written as [IP]:PORT
+int parse_endpoint(const char *str, struct sockaddr_storage *addr,
+                   socklen_t *addr_len) {
+  char host[128];
+  strncpy(host, str, sizeof(host));
+  host[sizeof(host) - 1] = '\0';
+
+  char *last_colon = strrchr(host, ':');
+  if (last_colon == NULL) {
+    return -1;
+  }
+  *last_colon = '\0';
+  const char *port = last_colon + 1;
+
+  char *node = host;
+  size_t len = strlen(node);
+  if (len >= 2 && node[0] == '[' && node[len - 1] == ']') {
+    node[len - 1] = '\0';
+    node++;
+  }
+
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+  if (getaddrinfo(node, port, &hints, &res) != 0) {
+    LOG_MSG(LOG_ERROR, "parse_endpoint(): invalid address %s", str);
+    return -1;
+  }
+
+  memcpy(addr, res->ai_addr, res->ai_addrlen);
+  *addr_len = res->ai_addrlen;
+  freeaddrinfo(res);
+  return 0;
+}
+
+// socket of the given type bound to addr, tcp sockets also listen
+int create_bound_socket(int type, const struct sockaddr_storage *addr,
+                        socklen_t addr_len) {
+  int fd = socket(addr->ss_family, type, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  int reuse = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  if (bind(fd, (const struct sockaddr *)addr, addr_len) != 0 ||
+      (type == SOCK_STREAM && listen(fd, SOMAXCONN) != 0)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
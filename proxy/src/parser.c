@@ -0,0 +1,117 @@
+// file:        parser.c
+// description: implementation of command line arguments parser
+#include "parser.h"
+#include "logger.h"
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// parse a non negative finite number, trailing text is an error
+static double parse_number(const char *str, const char *program) {
+  char *end;
+  errno = 0;
+  double value = strtod(str, &end);
+  if (errno != 0 || end == str || *end != '\0' || !isfinite(value) ||
+      value < 0) {
+    usage(program);
+  }
+  return value;
+}
+
+// parse a percentage into a probability
+static double parse_percent(const char *str, const char *program) {
+  double value = parse_number(str, program);
+  if (value > 100) {
+    usage(program);
+  }
+  return value / 100;
+}
+
+// parse a time in milliseconds, fractions allowed (e.g. 0.5), to microseconds
+static uint64_t parse_ms_us(const char *str, const char *program) {
+  double value = parse_number(str, program);
+  if (value * 1000 >= (double)UINT64_MAX) {
+    usage(program);
+  }
+  return (uint64_t)(value * 1000);
+}
+
+// parse an unsigned decimal integer, trailing text is an error
+static uint64_t parse_count(const char *str, const char *program) {
+  char *end;
+  errno = 0;
+  unsigned long long value = strtoull(str, &end, 10);
+  if (errno != 0 || end == str || *end != '\0' || str[0] == '-') {
+    usage(program);
+  }
+  return value;
+}
+
+// parse command line arguments and return them
+Params parse_args(int argc, char **argv) {
+  // min arguments expected
+  if (argc < 4) {
+    usage(argv[0]);
+  }
+
+  // params initialization
+  Params p;
+  memset(&p, 0, sizeof(p));
+  p.cfg.reorder_gap_us = DEFAULT_REORDER_GAP_MS * 1000;
+  p.cfg.queue_limit = DEFAULT_QUEUE_LIMIT;
+  p.cfg.seed = 1;
+
+  if (strcmp(argv[1], "tcp") == 0) {
+    p.tcp = 1;
+  } else if (strcmp(argv[1], "udp") != 0) {
+    usage(argv[0]);
+  }
+  p.listen_str = argv[2];
+  p.target_str = argv[3];
+
+  // optional params
+  for (int i = 4; i < argc; i++) {
+    // debug mode
+    if (strcmp(argv[i], "-d") == 0) {
+      p.debug_mode = 1;
+    }
+
+    // params with a value
+    else if (i + 1 < argc) {
+      const char *opt = argv[i];
+      const char *value = argv[++i];
+
+      if (strcmp(opt, "--loss") == 0) {
+        p.cfg.loss = parse_percent(value, argv[0]);
+      } else if (strcmp(opt, "--dup") == 0) {
+        p.cfg.dup = parse_percent(value, argv[0]);
+      } else if (strcmp(opt, "--reorder") == 0) {
+        p.cfg.reorder = parse_percent(value, argv[0]);
+      } else if (strcmp(opt, "--corrupt") == 0) {
+        p.cfg.corrupt = parse_percent(value, argv[0]);
+      } else if (strcmp(opt, "--delay") == 0) {
+        p.cfg.delay_us = parse_ms_us(value, argv[0]);
+      } else if (strcmp(opt, "--jitter") == 0) {
+        p.cfg.jitter_us = parse_ms_us(value, argv[0]);
+      } else if (strcmp(opt, "--reorder-gap") == 0) {
+        p.cfg.reorder_gap_us = parse_ms_us(value, argv[0]);
+      } else if (strcmp(opt, "--rate") == 0) {
+        p.cfg.rate = parse_count(value, argv[0]);
+      } else if (strcmp(opt, "--queue") == 0) {
+        p.cfg.queue_limit = parse_count(value, argv[0]);
+      } else if (strcmp(opt, "--seed") == 0) {
+        p.cfg.seed = parse_count(value, argv[0]);
+      } else {
+        usage(argv[0]);
+      }
+    }
+
+    // invalid param
+    else {
+      usage(argv[0]);
+    }
+  }
+
+  return p;
+}
@@ -0,0 +1,55 @@
+// file:        proxy.c
+// description: implementation of the loop helpers shared by the proxies
+#include "proxy.h"
+#include <string.h>
+
+volatile sig_atomic_t proxy_running = 1;
+static volatile sig_atomic_t stats_requested = 0;
+
+static void handle_stop(int sig) {
+  (void)sig;
+  proxy_running = 0;
+}
+
+static void handle_stats(int sig) {
+  (void)sig;
+  stats_requested = 1;
+}
+
+// SIGINT and SIGTERM stop the proxy, SIGUSR1 prints the link stats
+void init_signals(void) {
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sigemptyset(&sa.sa_mask);
+
+  sa.sa_handler = handle_stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  sa.sa_handler = handle_stats;
+  sigaction(SIGUSR1, &sa, NULL);
+
+  // a closed tcp peer is handled as a send failure
+  signal(SIGPIPE, SIG_IGN);
+}
+
+// ms the loop can wait before the next packet of any link is due
+int poll_timeout(const Link *links, uint64_t now) {
+  int timeout = PROXY_TICK_MS;
+  for (int i = LINK_UP; i <= LINK_DOWN; i++) {
+    int release = next_release(&links[i], now);
+    if (release >= 0 && release < timeout) {
+      timeout = release;
+    }
+  }
+  return timeout;
+}
+
+// print the stats of both links if they were requested
+void report_stats(const Link *links, int force) {
+  if (force || stats_requested) {
+    stats_requested = 0;
+    print_link_stats(&links[LINK_UP]);
+    print_link_stats(&links[LINK_DOWN]);
+  }
+}
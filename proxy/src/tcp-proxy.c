@@ -0,0 +1,332 @@
+// file:        tcp-proxy.c
+// description: implementation of the tcp impairment proxy
+#include "logger.h"
+#include "network.h"
+#include "proxy.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// sides of a connection, the client and the target
+#define SIDE_CLIENT 0
+#define SIDE_TARGET 1
+
+// bytes waiting for a side to be writable
+typedef struct {
+  char *data;
+  size_t start;
+  size_t len;
+  size_t cap;
+} OutBuffer;
+
+// a client connection and its connection to the target
+// bytes read from a side go through the link of that side to the other one
+// write_closed is set once the end of the stream is queued, the side is
+// shut down when its buffer is empty
+typedef struct {
+  int open;
+  int connecting;
+  int fds[2];
+  int read_closed[2];
+  int write_closed[2];
+  int shut_down[2];
+  OutBuffer out[2];
+  uint64_t gen;
+} TcpFlow;
+
+static void close_flow(TcpFlow *flow, int idx) {
+  close(flow->fds[SIDE_CLIENT]);
+  close(flow->fds[SIDE_TARGET]);
+  free(flow->out[SIDE_CLIENT].data);
+  free(flow->out[SIDE_TARGET].data);
+  flow->open = 0;
+  LOG_MSG(LOG_INFO, "close_flow(): flow %d closed", idx);
+}
+
+static int set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// accept a client and start connecting it to the target
+static void accept_flow(TcpFlow *flows, int listen_fd,
+                        const ProxyAddrs *addrs) {
+  int client_fd = accept(listen_fd, NULL, NULL);
+  if (client_fd < 0) {
+    return;
+  }
+
+  int slot = -1;
+  for (int i = 0; i < MAX_FLOWS && slot < 0; i++) {
+    if (!flows[i].open) {
+      slot = i;
+    }
+  }
+
+  // the connection completes later, the loop never waits for it
+  int target_fd = socket(addrs->target_addr.ss_family, SOCK_STREAM, 0);
+  int state = -1;
+  if (slot >= 0 && target_fd >= 0 && set_nonblocking(target_fd) == 0 &&
+      set_nonblocking(client_fd) == 0) {
+    if (connect(target_fd, (const struct sockaddr *)&addrs->target_addr,
+                addrs->target_len) == 0) {
+      state = 0;
+    } else if (errno == EINPROGRESS) {
+      state = 1;
+    }
+  }
+  if (state < 0) {
+    LOG_MSG(LOG_ERROR, "accept_flow(): client refused");
+    if (target_fd >= 0) {
+      close(target_fd);
+    }
+    close(client_fd);
+    return;
+  }
+
+  TcpFlow *flow = &flows[slot];
+  uint64_t gen = flow->gen + 1;
+  memset(flow, 0, sizeof(*flow));
+  flow->open = 1;
+  flow->connecting = state;
+  flow->gen = gen;
+  flow->fds[SIDE_CLIENT] = client_fd;
+  flow->fds[SIDE_TARGET] = target_fd;
+  LOG_MSG(LOG_INFO, "accept_flow(): new flow %d", slot);
+}
+
+// check if the connection to the target completed
+// returns -1 if it failed
+static int finish_connect(TcpFlow *flow) {
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (getsockopt(flow->fds[SIDE_TARGET], SOL_SOCKET, SO_ERROR, &err, &len) !=
+          0 ||
+      err != 0) {
+    return -1;
+  }
+  flow->connecting = 0;
+  return 0;
+}
+
+// queue bytes for a side, returns -1 if there is no memory
+static int append_out(OutBuffer *out, const char *data, size_t len) {
+  if (out->start + out->len + len > out->cap) {
+    // move the pending bytes to the front before growing
+    memmove(out->data, out->data + out->start, out->len);
+    out->start = 0;
+
+    if (out->len + len > out->cap) {
+      size_t cap = out->cap > 0 ? out->cap : MAX_PACKET;
+      while (cap < out->len + len) {
+        cap *= 2;
+      }
+      char *data_new = realloc(out->data, cap);
+      if (data_new == NULL) {
+        return -1;
+      }
+      out->data = data_new;
+      out->cap = cap;
+    }
+  }
+  memcpy(out->data + out->start + out->len, data, len);
+  out->len += len;
+  return 0;
+}
+
+// write what a side takes without blocking, then the end of the stream
+// once nothing is left, returns -1 if the peer is gone
+static int flush_side(TcpFlow *flow, int side) {
+  OutBuffer *out = &flow->out[side];
+  if (flow->connecting) {
+    return 0;
+  }
+
+  while (out->len > 0) {
+    ssize_t count = send(flow->fds[side], out->data + out->start, out->len,
+                         MSG_NOSIGNAL);
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return 0;
+    }
+    if (count <= 0) {
+      return -1;
+    }
+    out->start += count;
+    out->len -= count;
+  }
+  out->start = 0;
+
+  if (flow->write_closed[side] && !flow->shut_down[side]) {
+    shutdown(flow->fds[side], SHUT_WR);
+    flow->shut_down[side] = 1;
+  }
+  return 0;
+}
+
+// write the due chunks of both links, an empty chunk ends the stream
+static void deliver(Link *links, TcpFlow *flows, uint64_t now) {
+  for (int side = SIDE_CLIENT; side <= SIDE_TARGET; side++) {
+    Link *link = &links[side == SIDE_CLIENT ? LINK_UP : LINK_DOWN];
+    int other = 1 - side;
+
+    Packet p;
+    while (pop_packet(link, now, &p)) {
+      TcpFlow *flow = &flows[p.flow];
+      if (!flow->open || flow->gen != p.flow_gen ||
+          flow->write_closed[other]) {
+        free(p.data);
+        continue;
+      }
+
+      int result = 0;
+      if (p.len == 0) {
+        flow->write_closed[other] = 1;
+      } else if ((result = append_out(&flow->out[other], p.data, p.len)) ==
+                 0) {
+        link->stats.packets_out++;
+        link->stats.bytes_out += p.len;
+      }
+      free(p.data);
+
+      if (result != 0 || flush_side(flow, other) != 0) {
+        close_flow(flow, p.flow);
+      } else if (flow->shut_down[SIDE_CLIENT] && flow->shut_down[SIDE_TARGET]) {
+        close_flow(flow, p.flow);
+      }
+    }
+  }
+}
+
+// relay streams between the clients and the target until stopped
+// each read is a chunk that is impaired as a packet
+int run_tcp_proxy(const ProxyAddrs *addrs, const ImpairConfig *cfg) {
+  int listen_fd =
+      create_bound_socket(SOCK_STREAM, &addrs->listen_addr, addrs->listen_len);
+  if (listen_fd < 0) {
+    LOG_MSG(LOG_ERROR, "run_tcp_proxy(): bind failure");
+    return -1;
+  }
+
+  Link links[2];
+  init_link(&links[LINK_UP], "up", cfg, cfg->seed);
+  init_link(&links[LINK_DOWN], "down", cfg, cfg->seed * 2 + 1);
+  links[LINK_UP].stream = 1;
+  links[LINK_DOWN].stream = 1;
+
+  TcpFlow *flows = calloc(MAX_FLOWS, sizeof(TcpFlow));
+  if (flows == NULL) {
+    log_exit("flows allocation failure");
+  }
+
+  char *buf = malloc(MAX_PACKET);
+  struct pollfd pfds[2 * MAX_FLOWS + 1];
+  int pfd_flow[2 * MAX_FLOWS + 1];
+  int pfd_side[2 * MAX_FLOWS + 1];
+
+  while (proxy_running) {
+    report_stats(links, 0);
+
+    // sides are read while their link and the buffer of the other side
+    // have room, and written while they have bytes waiting
+    int n = 0;
+    pfds[n].fd = listen_fd;
+    pfds[n++].events = POLLIN;
+    for (int i = 0; i < MAX_FLOWS; i++) {
+      for (int side = SIDE_CLIENT; flows[i].open && side <= SIDE_TARGET;
+           side++) {
+        TcpFlow *flow = &flows[i];
+        Link *link = &links[side == SIDE_CLIENT ? LINK_UP : LINK_DOWN];
+        short events = 0;
+        if (!flow->read_closed[side] && !flow->connecting &&
+            link->queued_bytes < cfg->queue_limit &&
+            flow->out[1 - side].len < cfg->queue_limit) {
+          events |= POLLIN;
+        }
+        if (flow->out[side].len > 0 ||
+            (side == SIDE_TARGET && flow->connecting)) {
+          events |= POLLOUT;
+        }
+        if (events != 0) {
+          pfds[n].fd = flow->fds[side];
+          pfds[n].events = events;
+          pfd_flow[n] = i;
+          pfd_side[n++] = side;
+        }
+      }
+    }
+
+    if (poll(pfds, n, poll_timeout(links, now_us())) < 0 && errno != EINTR) {
+      LOG_MSG(LOG_ERROR, "run_tcp_proxy(): poll failure");
+      break;
+    }
+    uint64_t now = now_us();
+
+    if (pfds[0].revents & POLLIN) {
+      accept_flow(flows, listen_fd, addrs);
+    }
+
+    for (int i = 1; i < n; i++) {
+      if (!(pfds[i].revents & (POLLIN | POLLOUT | POLLHUP | POLLERR))) {
+        continue;
+      }
+
+      TcpFlow *flow = &flows[pfd_flow[i]];
+      int side = pfd_side[i];
+      Link *link = &links[side == SIDE_CLIENT ? LINK_UP : LINK_DOWN];
+      if (!flow->open) {
+        continue;
+      }
+
+      // writable or failed, an error is reported by the connect or the send
+      if (pfds[i].events & POLLOUT) {
+        if (flow->connecting && finish_connect(flow) != 0) {
+          LOG_MSG(LOG_ERROR, "run_tcp_proxy(): flow %d target refused",
+                  pfd_flow[i]);
+          close_flow(flow, pfd_flow[i]);
+          continue;
+        }
+        if (flush_side(flow, side) != 0 ||
+            (flow->shut_down[SIDE_CLIENT] && flow->shut_down[SIDE_TARGET])) {
+          close_flow(flow, pfd_flow[i]);
+          continue;
+        }
+      }
+      if (!(pfds[i].events & POLLIN)) {
+        continue;
+      }
+
+      // the end of the stream follows the data, it is never impaired
+      ssize_t len = recv(flow->fds[side], buf, MAX_PACKET, 0);
+      if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        continue;
+      }
+      if (len > 0) {
+        submit_packet(link, buf, len, pfd_flow[i], flow->gen, 1, now);
+      } else {
+        flow->read_closed[side] = 1;
+        submit_packet(link, NULL, 0, pfd_flow[i], flow->gen, 0, now);
+      }
+    }
+
+    deliver(links, flows, now_us());
+  }
+
+  report_stats(links, 1);
+  for (int i = 0; i < MAX_FLOWS; i++) {
+    if (flows[i].open) {
+      close_flow(&flows[i], i);
+    }
+  }
+  free(buf);
+  free(flows);
+  free_link(&links[LINK_UP]);
+  free_link(&links[LINK_DOWN]);
+  close(listen_fd);
+  return 0;
+}
@@ -0,0 +1,206 @@
+// file:        udp-proxy.c
+// description: implementation of the udp impairment proxy
+#include "logger.h"
+#include "network.h"
+#include "proxy.h"
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// a client and the socket that talks to the target for it
+typedef struct {
+  struct sockaddr_storage client;
+  socklen_t client_len;
+  int fd;
+  uint64_t gen;
+  uint64_t last_seen_us;
+} UdpFlow;
+
+// check if two addresses are the same ip and port
+static int same_addr(const struct sockaddr_storage *a,
+                     const struct sockaddr_storage *b) {
+  if (a->ss_family != b->ss_family) {
+    return 0;
+  }
+  if (a->ss_family == AF_INET) {
+    const struct sockaddr_in *x = (const struct sockaddr_in *)a;
+    const struct sockaddr_in *y = (const struct sockaddr_in *)b;
+    return x->sin_port == y->sin_port &&
+           x->sin_addr.s_addr == y->sin_addr.s_addr;
+  }
+  const struct sockaddr_in6 *x = (const struct sockaddr_in6 *)a;
+  const struct sockaddr_in6 *y = (const struct sockaddr_in6 *)b;
+  return x->sin6_port == y->sin6_port &&
+         memcmp(&x->sin6_addr, &y->sin6_addr, sizeof(x->sin6_addr)) == 0;
+}
+
+// flow of a client, a new one replaces the least recently used if full
+// returns -1 if the target socket can't be created
+static int get_flow(UdpFlow *flows, const ProxyAddrs *addrs,
+                    const struct sockaddr_storage *client,
+                    socklen_t client_len, uint64_t now) {
+  int slot = -1;
+  for (int i = 0; i < MAX_FLOWS; i++) {
+    if (flows[i].fd >= 0 && same_addr(&flows[i].client, client)) {
+      flows[i].last_seen_us = now;
+      return i;
+    }
+    // a free slot is kept, otherwise the least recently used one
+    if (slot < 0 ||
+        (flows[slot].fd >= 0 &&
+         (flows[i].fd < 0 ||
+          flows[i].last_seen_us < flows[slot].last_seen_us))) {
+      slot = i;
+    }
+  }
+
+  UdpFlow *flow = &flows[slot];
+  if (flow->fd >= 0) {
+    LOG_MSG(LOG_WARNING, "get_flow(): flow %d replaced", slot);
+    close(flow->fd);
+    flow->fd = -1;
+  }
+
+  int fd = socket(addrs->target_addr.ss_family, SOCK_DGRAM, 0);
+  if (fd < 0 || connect(fd, (const struct sockaddr *)&addrs->target_addr,
+                        addrs->target_len) != 0) {
+    LOG_MSG(LOG_ERROR, "get_flow(): target socket failure");
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+
+  memcpy(&flow->client, client, client_len);
+  flow->client_len = client_len;
+  flow->fd = fd;
+  flow->gen++;
+  flow->last_seen_us = now;
+  LOG_MSG(LOG_INFO, "get_flow(): new flow %d", slot);
+  return slot;
+}
+
+// send the due packets of both links
+static void deliver(Link *links, UdpFlow *flows, int listen_fd, uint64_t now) {
+  Packet p;
+  while (pop_packet(&links[LINK_UP], now, &p)) {
+    UdpFlow *flow = &flows[p.flow];
+    if (flow->fd >= 0 && flow->gen == p.flow_gen &&
+        send(flow->fd, p.data, p.len, 0) >= 0) {
+      links[LINK_UP].stats.packets_out++;
+      links[LINK_UP].stats.bytes_out += p.len;
+    }
+    free(p.data);
+  }
+
+  while (pop_packet(&links[LINK_DOWN], now, &p)) {
+    UdpFlow *flow = &flows[p.flow];
+    if (flow->gen == p.flow_gen &&
+        sendto(listen_fd, p.data, p.len, 0,
+               (const struct sockaddr *)&flow->client,
+               flow->client_len) >= 0) {
+      links[LINK_DOWN].stats.packets_out++;
+      links[LINK_DOWN].stats.bytes_out += p.len;
+    }
+    free(p.data);
+  }
+}
+
+// relay datagrams between the clients and the target until stopped
+int run_udp_proxy(const ProxyAddrs *addrs, const ImpairConfig *cfg) {
+  int listen_fd =
+      create_bound_socket(SOCK_DGRAM, &addrs->listen_addr, addrs->listen_len);
+  if (listen_fd < 0) {
+    LOG_MSG(LOG_ERROR, "run_udp_proxy(): bind failure");
+    return -1;
+  }
+
+  Link links[2];
+  init_link(&links[LINK_UP], "up", cfg, cfg->seed);
+  init_link(&links[LINK_DOWN], "down", cfg, cfg->seed * 2 + 1);
+
+  UdpFlow *flows = calloc(MAX_FLOWS, sizeof(UdpFlow));
+  if (flows == NULL) {
+    log_exit("flows allocation failure");
+  }
+  for (int i = 0; i < MAX_FLOWS; i++) {
+    flows[i].fd = -1;
+  }
+
+  char *buf = malloc(MAX_PACKET);
+  struct pollfd pfds[MAX_FLOWS + 1];
+  int pfd_flow[MAX_FLOWS + 1];
+
+  while (proxy_running) {
+    report_stats(links, 0);
+
+    // the listen socket and the target socket of every flow
+    int n = 0;
+    pfds[n].fd = listen_fd;
+    pfds[n++].events = POLLIN;
+    for (int i = 0; i < MAX_FLOWS; i++) {
+      if (flows[i].fd >= 0) {
+        pfds[n].fd = flows[i].fd;
+        pfds[n].events = POLLIN;
+        pfd_flow[n++] = i;
+      }
+    }
+
+    if (poll(pfds, n, poll_timeout(links, now_us())) < 0 && errno != EINTR) {
+      LOG_MSG(LOG_ERROR, "run_udp_proxy(): poll failure");
+      break;
+    }
+    uint64_t now = now_us();
+
+    // client datagrams go up to the target
+    if (pfds[0].revents & POLLIN) {
+      struct sockaddr_storage client;
+      socklen_t client_len = sizeof(client);
+      ssize_t len;
+      while ((len = recvfrom(listen_fd, buf, MAX_PACKET, MSG_DONTWAIT,
+                             (struct sockaddr *)&client, &client_len)) >= 0) {
+        int flow = get_flow(flows, addrs, &client, client_len, now);
+        if (flow >= 0) {
+          submit_packet(&links[LINK_UP], buf, len, flow, flows[flow].gen, 1,
+                        now);
+        }
+        client_len = sizeof(client);
+      }
+    }
+
+    // target datagrams go down to their client
+    // an icmp error is reported once by recv, reading it clears it
+    for (int i = 1; i < n; i++) {
+      if (pfds[i].revents & (POLLIN | POLLERR | POLLHUP)) {
+        UdpFlow *flow = &flows[pfd_flow[i]];
+        ssize_t len;
+        while ((len = recv(flow->fd, buf, MAX_PACKET, MSG_DONTWAIT)) >= 0) {
+          submit_packet(&links[LINK_DOWN], buf, len, pfd_flow[i], flow->gen, 1,
+                        now);
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          LOG_MSG(LOG_WARNING, "run_udp_proxy(): flow %d target error: %s",
+                  pfd_flow[i], strerror(errno));
+        }
+      }
+    }
+
+    deliver(links, flows, listen_fd, now_us());
+  }
+
+  report_stats(links, 1);
+  for (int i = 0; i < MAX_FLOWS; i++) {
+    if (flows[i].fd >= 0) {
+      close(flows[i].fd);
+    }
+  }
+  free(buf);
+  free(flows);
+  free_link(&links[LINK_UP]);
+  free_link(&links[LINK_DOWN]);
+  close(listen_fd);
+  return 0;
+}